@@ -0,0 +1,118 @@
+#pragma once
+
+#include "replay.hpp"
+#include "types.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace cpposu {
+
+// Cursor against aim targets: for each target, the replay frame nearest to it in time and how far the cursor was.
+struct CursorOffsets
+{
+    // index into the frames
+    std::vector<uint32_t> frame;
+    // ms from the target's time to the frame's, in the rate's time
+    std::vector<float> time_offset;
+    // osu!pixels from the target's position to the cursor
+    std::vector<float> distance;
+    // 1 if distance is at most the radius
+    std::vector<uint8_t> in_radius;
+
+    size_t size() const { return distance.size(); }
+};
+
+// Circles, slider heads, ticks and repeats (everything aimed at that has a position in time), ordered by time.
+inline std::vector<HitObject> aim_targets(std::span<const HitObject> hitObjects)
+{
+    std::vector<HitObject> targets;
+    for (const auto& h : hitObjects)
+        if (h.type == circle || h.type == slider_head || h.type == slider_tick || h.type == slider_repeat)
+            targets.push_back(h);
+    // ticks of overlapping sliders interleave
+    std::stable_sort(targets.begin(), targets.end(), [](const HitObject& a, const HitObject& b) { return a.time < b.time; });
+    return targets;
+}
+
+namespace detail {
+
+// For each of the ascending times, the frame nearest to it, walking the ascending frame times along with them
+// instead of searching per time. Ties go to the earlier frame.
+inline void nearest_frames(std::span<const int32_t> frameTimes, std::span<const double> times, std::span<uint32_t> out)
+{
+    size_t f = 0;
+    for (size_t i = 0; i < times.size(); ++i)
+    {
+        while (f + 1 < frameTimes.size() && frameTimes[f + 1] <= times[i])
+            ++f;
+        // frame f is the last at or before the time (or the first frame if there is none), frame f + 1 the first after it
+        bool next = f + 1 < frameTimes.size() && frameTimes[f] <= times[i] && frameTimes[f + 1] - times[i] < times[i] - frameTimes[f];
+        out[i] = (uint32_t) (f + next);
+    }
+}
+
+// Distances from the points to the cursor positions gathered for them. The loops run over plain arrays without
+// branches so that compilers vectorize them.
+inline void cursor_distances(std::span<const float> cursorX, std::span<const float> cursorY, std::span<const float> x,
+    std::span<const float> y, float radius, std::span<float> distance, std::span<uint8_t> inRadius)
+{
+    const size_t n = distance.size();
+    const float* __restrict cx = cursorX.data();
+    const float* __restrict cy = cursorY.data();
+    const float* __restrict px = x.data();
+    const float* __restrict py = y.data();
+    float* __restrict d = distance.data();
+    uint8_t* __restrict in = inRadius.data();
+
+    const float radiusSquared = radius * radius;
+    for (size_t i = 0; i < n; ++i)
+    {
+        float dx = cx[i] - px[i];
+        float dy = cy[i] - py[i];
+        d[i] = dx * dx + dy * dy;
+    }
+    for (size_t i = 0; i < n; ++i)
+        in[i] = d[i] <= radiusSquared;
+    for (size_t i = 0; i < n; ++i)
+        d[i] = std::sqrt(d[i]);
+}
+
+}
+
+// Offsets of the cursor from targets ordered by time (see aim_targets()) with mods applied, where radius is the
+// circle radius. Frames are in the map's time like the judge's (see ReplayJudge), and are taken to be ordered by
+// time. With no frames, distances are infinite and time offsets NaN.
+inline CursorOffsets cursor_offsets(const ReplayFrames& frames, std::span<const HitObject> targets, float radius, double rate = 1)
+{
+    const size_t n = targets.size();
+    CursorOffsets result;
+    result.frame.assign(n, 0);
+    result.time_offset.assign(n, NAN);
+    result.distance.assign(n, INFINITY);
+    result.in_radius.assign(n, 0);
+    if (frames.size() == 0 || n == 0)
+        return result;
+
+    // the arrays the kernels run over, with the targets' times in the map's time like the frames'
+    auto columns = to_columns(targets);
+    for (double& t : columns.time)
+        t *= rate;
+
+    detail::nearest_frames(frames.time, columns.time, result.frame);
+    std::vector<float> cursorX(n), cursorY(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        uint32_t f = result.frame[i];
+        cursorX[i] = frames.x[f];
+        cursorY[i] = frames.y[f];
+        result.time_offset[i] = (float) ((frames.time[f] - columns.time[i]) / rate);
+    }
+    detail::cursor_distances(cursorX, cursorY, columns.x, columns.y, radius, result.distance, result.in_radius);
+    return result;
+}
+
+}
@@ -0,0 +1,324 @@
+#pragma once
+
+#include "beatmap_parser.hpp"
+#include "judgement.hpp"
+#include "replay.hpp"
+#include "thread_pool.hpp"
+
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace cpposu {
+
+// Counts of values in bins of equal width from min, with those outside counted separately. Histograms with the same
+// bins can be merged.
+struct Histogram
+{
+    Histogram(double min = 0, double binWidth = 1, size_t bins = 0):
+        min(min),
+        bin_width(binWidth),
+        counts(bins)
+    {}
+
+    double min;
+    double bin_width;
+    std::vector<uint64_t> counts;
+    uint64_t underflow = 0;
+    uint64_t overflow = 0;
+
+    double max() const { return min + bin_width * counts.size(); }
+    uint64_t total() const
+    {
+        uint64_t total = underflow + overflow;
+        for (auto c : counts)
+            total += c;
+        return total;
+    }
+
+    void add(double value)
+    {
+        double bin = std::floor((value - min) / bin_width);
+        if (bin < 0)
+            ++underflow;
+        else if (bin >= counts.size())
+            ++overflow;
+        else
+            ++counts[(size_t) bin];
+    }
+
+    void merge(const Histogram& other)
+    {
+        if (other.min != min || other.bin_width != bin_width || other.counts.size() != counts.size())
+            throw std::invalid_argument("Merging histograms with different bins");
+        for (size_t i = 0; i < counts.size(); ++i)
+            counts[i] += other.counts[i];
+        underflow += other.underflow;
+        overflow += other.overflow;
+    }
+};
+
+// Running mean and variance of hit errors, as sums so that they can be merged.
+struct HitErrorStatistics
+{
+    uint64_t count = 0;
+    double sum = 0;
+    double sum_squares = 0;
+
+    void add(double error)
+    {
+        ++count;
+        sum += error;
+        sum_squares += error * error;
+    }
+    void merge(const HitErrorStatistics& other)
+    {
+        count += other.count;
+        sum += other.sum;
+        sum_squares += other.sum_squares;
+    }
+
+    double mean() const { return count ? sum / count : NAN; }
+    // ten times the (population) standard deviation, NaN with fewer than two hits
+    double unstable_rate() const
+    {
+        if (count < 2)
+            return NAN;
+        double m = mean();
+        return 10 * std::sqrt(std::max(0.0, sum_squares / count - m * m));
+    }
+};
+
+// Hit object results in a section of a map.
+struct SectionCounts
+{
+    uint64_t great = 0;
+    uint64_t ok = 0;
+    uint64_t meh = 0;
+    uint64_t miss = 0;
+
+    uint64_t total() const { return great + ok + meh + miss; }
+    // 0 to 1, NaN if nothing was judged
+    double accuracy() const
+    {
+        return total() ? (300.0 * great + 100.0 * ok + 50.0 * meh) / (300.0 * total()) : NAN;
+    }
+};
+
+struct AnalyticsSettings
+{
+    // length of accuracy sections in the map's time (ms)
+    double section_length = 10000;
+    // hit error bins (ms), covering the widest 50 window
+    double hit_error_min = -200;
+    double hit_error_bin_width = 1;
+    size_t hit_error_bins = 400;
+    // bins of per-replay unstable rates
+    double unstable_rate_bin_width = 10;
+    size_t unstable_rate_bins = 100;
+};
+
+// Statistics of the replays of one map, reduced as the replays are judged.
+struct MapAnalytics
+{
+    explicit MapAnalytics(const AnalyticsSettings& settings = {}):
+        section_length(settings.section_length),
+        hit_error_histogram(settings.hit_error_min, settings.hit_error_bin_width, settings.hit_error_bins),
+        unstable_rate_histogram(0, settings.unstable_rate_bin_width, settings.unstable_rate_bins)
+    {}
+
+    std::string beatmap;
+    // why the beatmap couldn't be parsed, empty if it was
+    std::string error;
+    uint64_t replays = 0;
+    // replays that couldn't be parsed or aren't osu!standard
+    uint64_t failed_replays = 0;
+    double section_length;
+
+    // the hit errors (ms, in the rate's time) of all replays together
+    HitErrorStatistics hit_errors;
+    Histogram hit_error_histogram;
+    // unstable rates of single replays with at least two hits
+    Histogram unstable_rate_histogram;
+    // results by section of the map's time
+    std::vector<SectionCounts> sections;
+
+    // Adds a replay's judgements by judge.
+    void add(const ReplayJudge& judge, const Judgements& judgements)
+    {
+        ++replays;
+        HitErrorStatistics replayErrors;
+        size_t o = 0;
+        for (const auto& h : judge.hit_objects())
+        {
+            if (!is_start_event(h.type))
+                continue;
+            float error = judgements.hit_error[o];
+            if (!std::isnan(error))
+            {
+                replayErrors.add(error);
+                hit_error_histogram.add(error);
+            }
+
+            size_t section = (size_t) std::max(0.0, h.time * judge.settings().rate / section_length);
+            if (section >= sections.size())
+                sections.resize(section + 1);
+            auto& s = sections[section];
+            switch (judgements.result[o])
+            {
+            case HitResult::Great: ++s.great; break;
+            case HitResult::Ok: ++s.ok; break;
+            case HitResult::Meh: ++s.meh; break;
+            case HitResult::Miss: ++s.miss; break;
+            }
+            ++o;
+        }
+        hit_errors.merge(replayErrors);
+        if (replayErrors.count >= 2)
+            unstable_rate_histogram.add(replayErrors.unstable_rate());
+    }
+
+    void merge(const MapAnalytics& other)
+    {
+        replays += other.replays;
+        failed_replays += other.failed_replays;
+        hit_errors.merge(other.hit_errors);
+        hit_error_histogram.merge(other.hit_error_histogram);
+        unstable_rate_histogram.merge(other.unstable_rate_histogram);
+        if (sections.size() < other.sections.size())
+            sections.resize(other.sections.size());
+        for (size_t i = 0; i < other.sections.size(); ++i)
+        {
+            sections[i].great += other.sections[i].great;
+            sections[i].ok += other.sections[i].ok;
+            sections[i].meh += other.sections[i].meh;
+            sections[i].miss += other.sections[i].miss;
+        }
+    }
+};
+
+// Replay files of a beatmap file.
+struct MapReplays
+{
+    std::string beatmap;
+    std::vector<std::string> replays;
+};
+
+namespace detail {
+
+// Shared by the tasks judging one map's replays: the parsed map, a judge per judged mod combination made when a
+// replay first needs it, and the statistics so far. The map and judges are released after the last replay.
+struct MapAnalyticsState
+{
+    MapAnalyticsState(Beatmap beatmap, size_t replays, const AnalyticsSettings& settings):
+        beatmap(std::move(beatmap)),
+        remaining(replays),
+        analytics(settings)
+    {}
+
+    std::shared_ptr<const ReplayJudge> judge(Mods mods)
+    {
+        std::lock_guard lock(mutex);
+        auto& judge = judges[mods & ReplayJudge::judged_mods];
+        if (!judge)
+            judge = std::make_shared<const ReplayJudge>(beatmap, mods & ReplayJudge::judged_mods);
+        return judge;
+    }
+
+    void add(const MapAnalytics& replay)
+    {
+        std::lock_guard lock(mutex);
+        analytics.merge(replay);
+        if (--remaining == 0)
+        {
+            judges.clear();
+            beatmap = {};
+        }
+    }
+
+    std::mutex mutex;
+    Beatmap beatmap;
+    std::map<Mods, std::shared_ptr<const ReplayJudge>> judges;
+    size_t remaining;
+    MapAnalytics analytics;
+};
+
+}
+
+// Judges the replays of each map and reduces them into per-map statistics, in the order of maps. Each beatmap is
+// parsed once on the calling thread while the replays of the maps before it are parsed and judged on pool, one task
+// per replay; a replay is dropped once it is added to its map's statistics, and at most a few tasks per thread are
+// queued at a time, so neither the replays nor the queue grow with the corpus.
+inline std::vector<MapAnalytics> analyze_replays(std::span<const MapReplays> maps, ThreadPool& pool, const AnalyticsSettings& settings = {})
+{
+    std::vector<std::shared_ptr<detail::MapAnalyticsState>> states(maps.size());
+    std::vector<MapAnalytics> results(maps.size(), MapAnalytics(settings));
+
+    std::mutex mutex;
+    std::condition_variable done;
+    size_t queued = 0;
+    const size_t maxQueued = 4 * pool.size();
+
+    for (size_t m = 0; m < maps.size(); ++m)
+    {
+        results[m].beatmap = maps[m].beatmap;
+        try
+        {
+            states[m] = std::make_shared<detail::MapAnalyticsState>(BeatmapParser(maps[m].beatmap).parse(), maps[m].replays.size(), settings);
+        }
+        catch (const std::exception& e)
+        {
+            results[m].error = e.what();
+            continue;
+        }
+
+        for (const auto& path : maps[m].replays)
+        {
+            {
+                std::unique_lock lock(mutex);
+                done.wait(lock, [&] { return queued < maxQueued; });
+                ++queued;
+            }
+            pool.submit([&, state = states[m], path = &path] {
+                MapAnalytics replay(settings);
+                try
+                {
+                    auto r = ReplayParser(*path).parse();
+                    if (r.mode != 0)
+                        throw parse_error("Not an osu!standard replay", parse_error_code::invalid_header);
+                    auto judge = state->judge(r.mods);
+                    replay.add(*judge, judge->judge(r.frames));
+                }
+                catch (const std::exception&)
+                {
+                    replay = MapAnalytics(settings);
+                    replay.failed_replays = 1;
+                }
+                state->add(replay);
+
+                std::lock_guard lock(mutex);
+                --queued;
+                done.notify_all();
+            });
+        }
+    }
+
+    std::unique_lock lock(mutex);
+    done.wait(lock, [&] { return queued == 0; });
+    for (size_t m = 0; m < maps.size(); ++m)
+        if (states[m])
+        {
+            states[m]->analytics.beatmap = maps[m].beatmap;
+            results[m] = std::move(states[m]->analytics);
+        }
+    return results;
+}
+
+}
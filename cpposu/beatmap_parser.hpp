@@ -11,6 +11,7 @@
 #include <sstream>
 #include <charconv>
 #include <cmath>
+#include <cctype>
 
 
 namespace cpposu
@@ -24,6 +25,10 @@ struct BeatmapParser : LineParser
 
     Beatmap parse();
 
+    void set_path_precision(const PathPrecision& precision) { slider_.precision = precision; }
+
+    // Counters of the last parse() (see stats.hpp), all zero unless stats_enabled.
+    const ParseStats& stats() const { return stats_; }
 
 protected:
 
@@ -112,12 +117,6 @@ protected:
             h.y = std::truncf(h.y);
 
             take_numeric_column(h.time, line);
-            if (!beatmap_.hit_objects.empty() &&  beatmap_.hit_objects.back().time - h.time > 1000)
-            {
-                CPPOSU_RAISE_PARSE_ERROR("Likely unsupported aspire map - went back in time by "
-                    << (beatmap_.hit_objects.back().time - h.time) << " ms."
-                    << " Hit object at time " << h.time << " appears later than " << beatmap_.hit_objects.back());
-            }
             uint32_t type;
             take_numeric_column(type, line);
             try_take_column(line); // hit sound -- unused
@@ -130,6 +129,38 @@ protected:
                 beatmap_.hit_objects.push_back(h);
             }
         });
+        sort_hit_objects();
+    }
+
+    // Objects are only out of order if the file was edited by hand (e.g. aspire maps), but some ranked maps are.
+    // Like lazer, stably sort them by start time, keeping each object's events together.
+    void sort_hit_objects()
+    {
+        auto& hit_objects = beatmap_.hit_objects;
+
+        struct ObjectRange { double time; size_t begin, end; };
+        std::vector<ObjectRange> objects;
+        bool sorted = true;
+        for (size_t i=0; i<hit_objects.size(); ++i)
+        {
+            if (!is_start_event(hit_objects[i].type))
+                continue;
+            if (!objects.empty())
+            {
+                objects.back().end = i;
+                sorted = sorted && objects.back().time <= hit_objects[i].time;
+            }
+            objects.push_back({hit_objects[i].time, i, hit_objects.size()});
+        }
+        if (sorted) return;
+
+        std::stable_sort(objects.begin(), objects.end(), [](const auto& a, const auto& b) { return a.time < b.time; });
+
+        std::vector<HitObject> result;
+        result.reserve(hit_objects.size());
+        for (const auto& object : objects)
+            result.insert(result.end(), hit_objects.begin()+object.begin, hit_objects.begin()+object.end);
+        hit_objects = std::move(result);
     }
 
 
@@ -146,10 +177,10 @@ protected:
         beatmap_.hit_objects.push_back(spinner_end);
     }
 
-    slider_type parse_slider_type(std::string_view s)
+    slider_type parse_slider_type(std::string_view s, int& degree)
     {
-        auto result = try_parse_slider_type(s);
-        if (!result) CPPOSU_RAISE_PARSE_ERROR("invalid slider type: " << s);
+        auto result = try_parse_slider_type(s, degree);
+        if (!result) CPPOSU_RAISE_PARSE_ERROR(invalid_slider_type, s, "invalid slider type: " << s);
         return *result;
     }
     Vector2 parse_slider_position(std::string_view s)
@@ -170,7 +201,8 @@ protected:
         slider_.data.slide_count = std::max(take_numeric_column<int>(extras), 1);
         slider_.data.length = take_numeric_column<double>(extras);
 
-        slider_type initial_slider_type = parse_slider_type(take_column(path_data,'|'));
+        int current_degree;
+        slider_type initial_slider_type = parse_slider_type(take_column(path_data,'|'), current_degree);
 
         slider_type current_slider_type = initial_slider_type;
         size_t current_segment_start=0;
@@ -199,15 +231,14 @@ protected:
         };
 
         slider_.data.control_points.clear();
-        slider_.data.control_points.push_back({current_slider_type, {slider_head.x, slider_head.y}});
+        slider_.data.control_points.push_back({current_slider_type, {slider_head.x, slider_head.y}, current_degree});
         while(std::optional<std::string_view> control_point_str = try_take_column(path_data, '|'))
         {
-            if (control_point_str->size() == 1)
+            if (!control_point_str->empty() && std::isalpha((unsigned char)control_point_str->front()))
             {
-                SliderControlPoint p{
-                    parse_slider_type(*control_point_str),
-                    parse_slider_position(take_column(path_data, '|'))
-                };
+                SliderControlPoint p;
+                p.new_slider_type = parse_slider_type(*control_point_str, p.degree);
+                p.position = parse_slider_position(take_column(path_data, '|'));
 
                 // push end of current slider segment, plus start of new segment
                 // note: different to lazer implementation - all slider segments must contain an end point.
@@ -218,6 +249,7 @@ protected:
                 validate_segment();
 
                 current_slider_type = p.new_slider_type;
+                current_degree = p.degree;
                 current_segment_start = slider_.data.control_points.size();
                 slider_.data.control_points.push_back(p);
             }
@@ -231,7 +263,11 @@ protected:
         }
         validate_segment();
 
-        if (!slider_.data.control_points.empty()) current_slider_type = slider_.data.control_points.front().new_slider_type;
+        if (!slider_.data.control_points.empty())
+        {
+            current_slider_type = slider_.data.control_points.front().new_slider_type;
+            current_degree = slider_.data.control_points.front().degree;
+        }
 
         for (size_t i=1; i<slider_.data.control_points.size()-1; ++i)
         {
@@ -244,6 +280,7 @@ protected:
             if (next.new_slider_type != slider_type::None)
             {
                 current_slider_type = next.new_slider_type;
+                current_degree = next.degree;
                 continue;
             }
 
@@ -260,6 +297,7 @@ protected:
 
             // create new implicit slider segment
             current.new_slider_type = current_slider_type;
+            current.degree = current_degree;
         }
 
         // control points are calculated relative to slider head
@@ -333,6 +371,7 @@ protected:
 
     Beatmap beatmap_;
     Slider slider_;
+    ParseStats stats_;
 
 };
 
@@ -340,6 +379,10 @@ protected:
 
 inline Beatmap BeatmapParser::parse()
 {
+    stats_ = {};
+    StatsScope statsScope(stats_);
+    CPPOSU_STAT_TIMER(parse_ns);
+
     parse_header();
     read_line(); // parse_section consumes a line that has already been read (needed to detect section begin)
 
@@ -359,7 +402,7 @@ inline void BeatmapParser::parse_header()
     std::string_view prefix_string = "osu file format v";
 
     if (!try_take_prefix(line, prefix_string))
-        CPPOSU_RAISE_PARSE_ERROR("Invalid file prefix, expected \"" << prefix_string << debug_location(line));
+        CPPOSU_RAISE_PARSE_ERROR(invalid_header, line, "Invalid file prefix, expected \"" << prefix_string << debug_location(line));
 
     beatmap_.version = read_number_or_throw<int>(line);
 }
@@ -368,7 +411,7 @@ inline void BeatmapParser::parse_section()
 {
     auto line = reread_last_line();
     if (!is_section_start(line))
-        CPPOSU_RAISE_PARSE_ERROR("Expected section start: " << debug_location(line));
+        CPPOSU_RAISE_PARSE_ERROR(expected_section, line, "Expected section start: " << debug_location(line));
 
     if(try_take_prefix(line, "[General]"))
         parse_general(line);
@@ -1,7 +1,14 @@
 
 #include <cpposu/beatmap_parser.hpp>
 #include <cpposu/mods.hpp>
+#include <cpposu/replay.hpp>
+#include <cpposu/thread_pool.hpp>
+#include <atomic>
 #include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <utility>
 
 #ifdef _WIN32
 #define CPPOSU_DLL __declspec( dllexport )
@@ -9,19 +16,198 @@
 #define CPPOSU_DLL
 #endif
 
-extern "C" {
+// Error codes are the cpposu::parse_error_code values, or this for failures other than parse errors.
+constexpr int32_t CPPOSU_ERROR_OTHER = 100;
 
-CPPOSU_DLL void* cpposu_parse_beatmap(const char* filename)
+namespace {
+
+struct Error
 {
+    int32_t code = 0;
+    uint64_t line = 0, column = 0;
+    std::string message;
+};
+
+thread_local Error last_error;
+std::atomic<bool> print_errors = true;
+
+struct ParseResult
+{
+    void* handle;
+    Error error;
+};
+
+// Runs parse, which returns a new object, as a handle. On failure the handle is null and the error is reported on
+// stderr unless disabled, but not stored, since this may run on a worker thread.
+template<typename F>
+ParseResult try_parse(const char* what, F&& parse)
+{
+    Error error;
     try {
-        cpposu::BeatmapParser parser(filename);
-        cpposu::Beatmap* beatmap = new cpposu::Beatmap(parser.parse());
-        return (void*) beatmap;
+        return {(void*) parse(), Error{}};
+    }
+    catch(cpposu::parse_error& e)
+    {
+        error = {(int32_t) e.code, e.line, e.column, e.what()};
     }
     catch(std::exception& e)
     {
-        std::cerr << "Error parsing beatmap: " << e.what() << std::endl;
-        return nullptr;
+        error = {CPPOSU_ERROR_OTHER, 0, 0, e.what()};
+    }
+
+    if (print_errors)
+        std::cerr << "Error parsing " << what << ": " << error.message << std::endl;
+    return {nullptr, std::move(error)};
+}
+
+// Parses a beatmap from the parser constructor arguments.
+template<typename... Args>
+ParseResult try_parse_beatmap(const Args&... args)
+{
+    return try_parse("beatmap", [&] { return new cpposu::Beatmap(cpposu::BeatmapParser(args...).parse()); });
+}
+
+// A path the caller passed, which may be null.
+std::optional<std::string> path_argument(const char* path)
+{
+    return path ? std::optional<std::string>(path) : std::nullopt;
+}
+
+// Parses a beatmap file; a null path fails like a file that can't be opened.
+ParseResult try_parse_beatmap_file(const std::optional<std::string>& path)
+{
+    if (!path)
+        return try_parse("beatmap", []() -> cpposu::Beatmap* {
+            throw cpposu::parse_error("Failed to open file: no path given", cpposu::parse_error_code::file_open);
+        });
+    return try_parse_beatmap(*path);
+}
+
+// Returns the handle, storing the error for cpposu_last_error on failure.
+void* take_result(ParseResult&& result)
+{
+    if (!result.handle)
+        last_error = std::move(result.error);
+    return result.handle;
+}
+
+// The shared parse threads, started on first use. The pool is never destroyed by static destruction: that would join
+// its threads while a DLL is being unloaded, under the loader lock, where they can't exit. cpposu_shutdown stops it
+// instead, and otherwise it is left to the process exit.
+std::mutex parse_pool_mutex;
+cpposu::ThreadPool* parse_pool = nullptr;
+
+std::future<ParseResult> submit_parse(const char* path)
+{
+    std::lock_guard lock(parse_pool_mutex);
+    if (!parse_pool)
+        parse_pool = new cpposu::ThreadPool;
+    return parse_pool->submit([path = path_argument(path)] { return try_parse_beatmap_file(path); });
+}
+
+struct ParseRequest
+{
+    std::future<ParseResult> result;
+};
+
+}
+
+extern "C" {
+
+struct cpposu_error
+{
+    int32_t code;
+    // 1-based, 0 if unknown
+    uint64_t line;
+    uint64_t column;
+    const char* message;
+};
+
+// Fills out with the error of the most recent failed call on this thread and returns its code (0 if none failed yet).
+// message stays valid until the next failure on this thread.
+CPPOSU_DLL int32_t cpposu_last_error(cpposu_error* out)
+{
+    if (out)
+        *out = {last_error.code, last_error.line, last_error.column, last_error.message.c_str()};
+    return last_error.code;
+}
+
+// Enables (the default) or disables printing failures to stderr, for all threads.
+CPPOSU_DLL void cpposu_set_error_output(int enabled)
+{
+    print_errors = enabled != 0;
+}
+
+CPPOSU_DLL void* cpposu_parse_beatmap(const char* filename)
+{
+    return take_result(try_parse_beatmap_file(path_argument(filename)));
+}
+
+// Parses size bytes of .osu file contents at data, which is only read during the call.
+CPPOSU_DLL void* cpposu_parse_beatmap_from_memory(const char* data, size_t size)
+{
+    return take_result(try_parse_beatmap(data, size));
+}
+
+// Parses n files on the shared parse threads, writing a beatmap handle (null on failure) per path to out and, if
+// error_codes isn't null, the error code per path (file_open for a null path). cpposu_last_error describes the first
+// failure.
+// Returns the number of beatmaps parsed successfully.
+CPPOSU_DLL size_t cpposu_parse_batch(const char** paths, size_t n, void** out, int32_t* error_codes)
+{
+    std::vector<std::future<ParseResult>> results;
+    results.reserve(n);
+    for (size_t i = 0; i < n; ++i)
+        results.push_back(submit_parse(paths[i]));
+
+    size_t parsed = 0;
+    std::optional<Error> first_error;
+    for (size_t i = 0; i < n; ++i)
+    {
+        auto result = results[i].get();
+        out[i] = result.handle;
+        if (error_codes)
+            error_codes[i] = result.error.code;
+        if (result.handle)
+            ++parsed;
+        else if (!first_error)
+            first_error = std::move(result.error);
+    }
+    if (first_error)
+        last_error = std::move(*first_error);
+    return parsed;
+}
+
+// Starts parsing a file on the shared parse threads. The returned request must be finished with cpposu_parse_wait.
+CPPOSU_DLL void* cpposu_parse_submit(const char* filename)
+{
+    auto* request = new ParseRequest;
+    request->result = submit_parse(filename);
+    return (void*) request;
+}
+
+// Returns 1 if the request has finished, so that cpposu_parse_wait won't block, and 0 otherwise.
+CPPOSU_DLL int cpposu_parse_poll(void* request)
+{
+    auto& result = static_cast<ParseRequest*>(request)->result;
+    return result.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+// Waits for the request, frees it and returns the beatmap handle, or null if parsing failed (see cpposu_last_error).
+CPPOSU_DLL void* cpposu_parse_wait(void* request)
+{
+    std::unique_ptr<ParseRequest> r(static_cast<ParseRequest*>(request));
+    return take_result(r->result.get());
+}
+
+// Finishes the parses already submitted and stops the shared parse threads, which are started again if needed. Call it
+// before unloading the library, while no other call is parsing on them; requests can still be waited for afterwards.
+CPPOSU_DLL void cpposu_shutdown()
+{
+    std::unique_ptr<cpposu::ThreadPool> pool;
+    {
+        std::lock_guard lock(parse_pool_mutex);
+        pool.reset(std::exchange(parse_pool, nullptr));
     }
 }
 
@@ -43,6 +229,64 @@ CPPOSU_DLL void cpposu_apply_stacking(void* handle)
     cpposu::apply_stacking(*beatmap);
 }
 
+// Applies mods (osu! bit values) to a beatmap that has not been stacked yet, stacking it.
+CPPOSU_DLL void cpposu_apply_mods(void* handle, uint32_t mods)
+{
+    auto* beatmap = static_cast<cpposu::Beatmap*>(handle);
+    cpposu::apply_mods(*beatmap, cpposu::Mods(mods));
+}
+
+// Stack heights for each of count approach rates (e.g. with HR and EZ applied), without applying them.
+// out receives count rows of one height per hit object.
+CPPOSU_DLL void cpposu_stack_heights(void* handle, const float* approach_rates, int count, int* out)
+{
+    auto* beatmap = static_cast<cpposu::Beatmap*>(handle);
+    std::vector<cpposu::StackingVariant> variants;
+    for (int i = 0; i < count; ++i)
+        variants.push_back({cpposu::stacking_time_threshold(approach_rates[i], beatmap->info.StackLeniency)});
+
+    auto heights = cpposu::calculate_stack_heights(beatmap->hit_objects, beatmap->version, variants);
+    for (const auto& h : heights)
+        out = std::copy(h.begin(), h.end(), out);
+}
+
+// A view of an unstacked beatmap with mods applied on access, sharing the beatmap's memory. The view must be freed
+// before the beatmap.
+CPPOSU_DLL void* cpposu_create_view(void* handle, uint32_t mods)
+{
+    auto* beatmap = static_cast<cpposu::Beatmap*>(handle);
+    return (void*) new cpposu::TransformedView(*beatmap, cpposu::Mods(mods));
+}
+
+// A view with other mods over the same beatmap as view, sharing its stack heights where possible.
+CPPOSU_DLL void* cpposu_view_with_mods(void* view, uint32_t mods)
+{
+    auto* v = static_cast<cpposu::TransformedView*>(view);
+    return (void*) new cpposu::TransformedView(v->with_mods(cpposu::Mods(mods)));
+}
+
+CPPOSU_DLL void cpposu_free_view(void* view)
+{
+    delete static_cast<cpposu::TransformedView*>(view);
+}
+
+CPPOSU_DLL int cpposu_view_size(void* view)
+{
+    return static_cast<cpposu::TransformedView*>(view)->size();
+}
+
+// Writes count hit objects starting at begin, laid out as returned by cpposu_hit_objects, to out.
+// Returns the number written, which is less than count at the end of the view.
+CPPOSU_DLL int cpposu_view_read(void* view, int begin, int count, void* out)
+{
+    auto* v = static_cast<cpposu::TransformedView*>(view);
+    if (begin < 0 || count < 0 || (size_t)begin > v->size())
+        return 0;
+    count = std::min<size_t>(count, v->size() - begin);
+    v->read(begin, std::span(static_cast<cpposu::HitObject*>(out), count));
+    return count;
+}
+
 CPPOSU_DLL void cpposu_hit_objects(void* handle, void** data, int* size)
 {
     auto* beatmap = static_cast<cpposu::Beatmap*>(handle);
@@ -50,4 +294,157 @@ CPPOSU_DLL void cpposu_hit_objects(void* handle, void** data, int* size)
     *size = beatmap->hit_objects.size();
 }
 
+// Hit object columns, each an array of count elements in native byte order. type holds the HitObjectType values
+// (circle = 0, slider_head, slider_tick, slider_repeat, slider_legacy_last_tick, slider_tail, spinner_start,
+// spinner_end = 7).
+struct cpposu_columns
+{
+    uint64_t count;
+    const uint8_t* type;
+    const float* x;
+    const float* y;
+    const double* time;
+};
+
+// Copies the beatmap's hit objects into columns owned by the returned handle and points out at them. The arrays stay
+// valid and unchanged until cpposu_free_columns, independently of the beatmap.
+CPPOSU_DLL void* cpposu_create_columns(void* handle, cpposu_columns* out)
+{
+    auto* beatmap = static_cast<cpposu::Beatmap*>(handle);
+    auto* columns = new cpposu::HitObjectColumns(cpposu::to_columns(beatmap->hit_objects));
+    *out = {columns->size(), columns->type.data(), columns->x.data(), columns->y.data(), columns->time.data()};
+    return (void*) columns;
+}
+
+CPPOSU_DLL void cpposu_free_columns(void* columns)
+{
+    delete static_cast<cpposu::HitObjectColumns*>(columns);
+}
+
+// Writes the hit object columns into caller-owned arrays of cpposu_hit_object_count elements each; any of them may be
+// null to skip that column.
+CPPOSU_DLL void cpposu_export_columns(void* handle, uint8_t* type, float* x, float* y, double* time)
+{
+    auto* beatmap = static_cast<cpposu::Beatmap*>(handle);
+    for (size_t i = 0; i < beatmap->hit_objects.size(); ++i)
+    {
+        const auto& h = beatmap->hit_objects[i];
+        if (type) type[i] = h.type;
+        if (x) x[i] = h.x;
+        if (y) y[i] = h.y;
+        if (time) time[i] = h.time;
+    }
+}
+
+CPPOSU_DLL uint64_t cpposu_hit_object_count(void* handle)
+{
+    return static_cast<cpposu::Beatmap*>(handle)->hit_objects.size();
+}
+
+// Beatmap metadata in plain C types. The strings point into the beatmap and are valid until it is freed.
+struct cpposu_beatmap_info
+{
+    int32_t version;
+    int32_t mode;
+    float hp_drain_rate;
+    float circle_size;
+    float overall_difficulty;
+    float approach_rate;
+    double slider_multiplier;
+    double slider_tick_rate;
+    float stack_leniency;
+    uint64_t beatmap_id;
+    uint64_t beatmap_set_id;
+    uint64_t hit_object_count;
+    const char* title;
+    const char* artist;
+    const char* creator;
+    const char* difficulty_name;
+};
+
+CPPOSU_DLL void cpposu_beatmap_info(void* handle, cpposu_beatmap_info* out)
+{
+    auto* beatmap = static_cast<cpposu::Beatmap*>(handle);
+    const auto& d = beatmap->difficulty_attributes;
+    const auto& info = beatmap->info;
+    *out = {
+        beatmap->version, info.Mode,
+        d.HPDrainRate, d.CircleSize, d.OverallDifficulty, d.ApproachRate, d.SliderMultiplier, d.SliderTickRate,
+        info.StackLeniency, info.BeatmapID, info.BeatmapSetID, beatmap->hit_objects.size(),
+        info.Title.c_str(), info.Artist.c_str(), info.Creator.c_str(), info.Version.c_str(),
+    };
+}
+
+// Parses a .osr replay, memory-mapping the file. Returns null on failure, see cpposu_last_error.
+CPPOSU_DLL void* cpposu_parse_replay(const char* filename)
+{
+    return take_result(try_parse("replay", [&] {
+        if (!filename)
+            throw cpposu::parse_error("Failed to open file: no path given", cpposu::parse_error_code::file_open);
+        return new cpposu::Replay(cpposu::ReplayParser(filename).parse());
+    }));
+}
+
+// Parses size bytes of .osr file contents at data, which is only read during the call.
+CPPOSU_DLL void* cpposu_parse_replay_from_memory(const char* data, size_t size)
+{
+    return take_result(try_parse("replay", [&] { return new cpposu::Replay(cpposu::ReplayParser(data, size).parse()); }));
+}
+
+CPPOSU_DLL void cpposu_free_replay(void* replay)
+{
+    delete static_cast<cpposu::Replay*>(replay);
+}
+
+struct cpposu_replay_info
+{
+    int32_t mode;
+    int32_t version;
+    int32_t count_300;
+    int32_t count_100;
+    int32_t count_50;
+    int32_t count_geki;
+    int32_t count_katu;
+    int32_t count_miss;
+    int32_t score;
+    int32_t max_combo;
+    int32_t perfect;
+    uint32_t mods;
+    int64_t timestamp;
+    int64_t online_score_id;
+    int32_t seed;
+    uint64_t frame_count;
+    const char* beatmap_hash;
+    const char* player_name;
+    const char* replay_hash;
+};
+
+// The strings stay valid until cpposu_free_replay.
+CPPOSU_DLL void cpposu_replay_info(void* handle, cpposu_replay_info* out)
+{
+    auto* r = static_cast<cpposu::Replay*>(handle);
+    *out = {
+        r->mode, r->version, r->count_300, r->count_100, r->count_50, r->count_geki, r->count_katu, r->count_miss,
+        r->score, r->max_combo, r->perfect, (uint32_t) r->mods, r->timestamp, r->online_score_id, r->seed,
+        r->frames.size(), r->beatmap_hash.c_str(), r->player_name.c_str(), r->replay_hash.c_str(),
+    };
+}
+
+struct cpposu_replay_frames
+{
+    uint64_t count;
+    const int32_t* time_delta;
+    const int32_t* time;
+    const float* x;
+    const float* y;
+    const uint32_t* keys;
+};
+
+// Points out at the replay's frame columns, which stay valid until cpposu_free_replay.
+CPPOSU_DLL void cpposu_replay_frames(void* handle, cpposu_replay_frames* out)
+{
+    const auto& f = static_cast<cpposu::Replay*>(handle)->frames;
+    *out = {f.size(), f.time_delta.data(), f.time.data(), f.x.data(), f.y.data(), f.keys.data()};
+}
+
 }
@@ -0,0 +1,1552 @@
+#pragma once
+
+#include "types.hpp"
+#include "mods.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <numbers>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+// The difficulty and performance calculation (performance.hpp) are ported from a single revision of lazer's osu!
+// ruleset: the one of the 2024 performance points update, with the rhythm islands, difficult strain counts and lazer
+// slider accuracy, and before the 2025 aim changes (smoothstep angle bonuses and the wiggle bonus). Every evaluator
+// term, skill multiplier and performance term follows that revision; the file and member names in the comments are
+// lazer's.
+
+namespace cpposu {
+
+// osu!standard star rating and the values performance is calculated from, as in lazer's OsuDifficultyAttributes.
+// They only depend on the beatmap and the mods, so they can be cached per combination (see write_attributes).
+struct DifficultyAttributes
+{
+    double StarRating = 0;
+    double AimDifficulty = 0;
+    double SpeedDifficulty = 0;
+    double SpeedNoteCount = 0;
+    double FlashlightDifficulty = 0;
+    double SliderFactor = 1;
+    double AimDifficultStrainCount = 0;
+    double SpeedDifficultStrainCount = 0;
+    // adjusted for mods, including the rate
+    double ApproachRate = 0;
+    double OverallDifficulty = 0;
+    double DrainRate = 0;
+    int MaxCombo = 0;
+    int HitCircleCount = 0;
+    int SliderCount = 0;
+    int SpinnerCount = 0;
+};
+
+// OsuPerformanceCalculator.PERFORMANCE_BASE_MULTIPLIER
+constexpr double performance_base_multiplier = 1.15;
+
+namespace detail {
+
+// DifficultyCalculationUtils.cs
+inline double logistic(double x, double midpointOffset, double multiplier, double maxValue = 1)
+{
+    return maxValue / (1 + std::exp(multiplier * (midpointOffset - x)));
+}
+inline double milliseconds_to_bpm(double ms, double delimiter = 4) { return 60000.0 / (ms * delimiter); }
+inline double bpm_to_milliseconds(double bpm, double delimiter = 4) { return 60000.0 / (bpm * delimiter); }
+
+constexpr double normalised_radius = 50;
+constexpr double normalised_diameter = normalised_radius * 2;
+constexpr double min_delta_time = 25;
+constexpr double maximum_slider_radius = normalised_radius * 2.4;
+constexpr double assumed_slider_radius = normalised_radius * 1.8;
+
+// Hit objects as the difficulty calculation sees them, from the start event of each object.
+struct DifficultyObject
+{
+    HitObjectType type;
+    double start_time;
+    Vector2 position;
+    // the slider tail, or the position for other objects
+    Vector2 end_position;
+    // where a lazy cursor leaves the slider
+    Vector2 lazy_end_position;
+    double lazy_travel_distance = 0;
+    double lazy_travel_time = 0;
+    int repeat_count = 0;
+};
+
+// Per-object values the skills read, as in lazer's OsuDifficultyHitObject, one array per value. Element k describes
+// hit object k + 1 relative to the ones before it; the first hit object has no element. The geometry (distances,
+// angles) is filled in by difficulty_geometry and the times by set_rate, so that rates can share the geometry. Both
+// can also be appended one object at a time.
+struct DifficultyObjects
+{
+    std::vector<DifficultyObject> objects;
+
+    std::vector<HitObjectType> type;
+    std::vector<double> lazy_jump_distance;
+    std::vector<double> minimum_jump_distance;
+    std::vector<double> travel_distance;
+    // NaN if undefined
+    std::vector<double> angle;
+    double radius = 0;
+
+    std::vector<double> start_time;
+    std::vector<double> delta_time;
+    std::vector<double> strain_time;
+    std::vector<double> hit_window_great;
+    std::vector<double> minimum_jump_time;
+    std::vector<double> travel_time;
+    double preempt = 0;
+    double fade_in = 0;
+    // OsuDifficultyHitObject.HitWindowGreat of non-spinners
+    double hit_window = 0;
+    double time_rate = 1;
+
+    size_t size() const { return type.size(); }
+    const DifficultyObject& object(size_t k) const { return objects[k + 1]; }
+};
+
+// OsuDifficultyHitObject.computeSliderCursorPosition, over the slider's events. The legacy last tick is at the time
+// lazer tracks the slider until, so its position is the unadjusted lazy end.
+inline void compute_slider_cursor(DifficultyObject& slider, std::span<const HitObject> events, double radius,
+                                  std::vector<const HitObject*>& movements)
+{
+    const HitObject* legacy_last_tick = nullptr;
+    const HitObject* tail = nullptr;
+    movements.clear();
+    for (const auto& e : events.subspan(1))
+    {
+        if (e.type == slider_tick || e.type == slider_repeat)
+            movements.push_back(&e);
+        else if (e.type == slider_legacy_last_tick)
+            legacy_last_tick = &e;
+        else if (e.type == slider_tail)
+            tail = &e;
+        if (e.type == slider_repeat)
+            ++slider.repeat_count;
+    }
+    if (!tail)
+        return;
+    // sliders built by hand may lack the legacy last tick
+    if (!legacy_last_tick)
+        legacy_last_tick = tail;
+
+    // a last tick after the tracking end time is moved to the end
+    if (!movements.empty() && movements.back()->type == slider_tick && movements.back()->time >= legacy_last_tick->time)
+        movements.insert(movements.end() - 1, tail);
+    else
+        movements.push_back(tail);
+
+    slider.end_position = tail->position();
+    slider.lazy_travel_time = legacy_last_tick->time - slider.start_time;
+
+    Vector2 lazy_end = legacy_last_tick->position();
+    Vector2 cursor = slider.position;
+    double scalingFactor = normalised_radius / radius;
+    for (size_t i = 0; i < movements.size(); ++i)
+    {
+        bool last = i + 1 == movements.size();
+        Vector2 movement = movements[i]->position() - cursor;
+        double movementLength = scalingFactor * movement.length();
+        double requiredMovement = assumed_slider_radius;
+
+        if (last)
+        {
+            Vector2 lazyMovement = lazy_end - cursor;
+            if (lazyMovement.length() < movement.length())
+                movement = lazyMovement;
+            movementLength = scalingFactor * movement.length();
+        }
+        else if (movements[i]->type == slider_repeat)
+            requiredMovement = normalised_radius;
+
+        if (movementLength > requiredMovement)
+        {
+            cursor = cursor + movement * (float) ((movementLength - requiredMovement) / movementLength);
+            movementLength *= (movementLength - requiredMovement) / movementLength;
+            slider.lazy_travel_distance += (float) movementLength;
+        }
+    }
+    slider.lazy_end_position = cursor;
+}
+
+// Appends the geometry of the next difficulty object, once d.objects has the hit object it describes.
+inline void append_geometry(DifficultyObjects& d)
+{
+    size_t k = d.type.size();
+    const auto& current = d.objects[k + 1];
+    const auto& last = d.objects[k];
+    const DifficultyObject* lastLast = k > 0 ? &d.objects[k - 1] : nullptr;
+
+    float scalingFactor = normalised_radius / d.radius;
+    if (d.radius < 30)
+        scalingFactor *= 1 + std::min(30 - (float) d.radius, 5.0f) / 50;
+
+    d.type.push_back(current.type);
+    d.lazy_jump_distance.push_back(0);
+    d.minimum_jump_distance.push_back(0);
+    d.travel_distance.push_back(0);
+    d.angle.push_back(NAN);
+
+    // bonus for repeat sliders until a better per nested object strain system can be achieved
+    if (current.type == slider_head)
+        d.travel_distance[k] = current.lazy_travel_distance * std::pow(1 + current.repeat_count / 2.5, 1.0 / 2.5);
+
+    if (current.type == spinner_start || last.type == spinner_start)
+        return;
+
+    Vector2 lastCursor = last.lazy_end_position;
+    d.lazy_jump_distance[k] = (current.position * scalingFactor - lastCursor * scalingFactor).length();
+    d.minimum_jump_distance[k] = d.lazy_jump_distance[k];
+
+    if (last.type == slider_head)
+    {
+        // the player either follows the slider to its lazy end or leaves it around the tail
+        float tailJumpDistance = (last.end_position - current.position).length() * scalingFactor;
+        d.minimum_jump_distance[k] = std::max(0.0, std::min(d.lazy_jump_distance[k] - (maximum_slider_radius - assumed_slider_radius),
+                                                            tailJumpDistance - maximum_slider_radius));
+    }
+
+    if (lastLast && lastLast->type != spinner_start)
+    {
+        Vector2 v1 = lastLast->lazy_end_position - last.position;
+        Vector2 v2 = current.position - lastCursor;
+        float dot = v1.dot(v2);
+        float det = v1.X * v2.Y - v1.Y * v2.X;
+        d.angle[k] = std::abs(std::atan2(det, dot));
+    }
+}
+
+// The difficulty object of the hit object whose events start at the front of events.
+inline DifficultyObject difficulty_object(std::span<const HitObject> events, double radius, std::vector<const HitObject*>& movements)
+{
+    const auto& start = events.front();
+    DifficultyObject o{start.type, start.time, start.position(), start.position(), start.position()};
+    if (start.type == slider_head)
+        compute_slider_cursor(o, events, radius, movements);
+    return o;
+}
+
+// LegacyRulesetExtensions.CalculateScaleFromCircleSize with the fudge factor
+inline double difficulty_radius(const MapDifficultyAttributes& difficulty)
+{
+    double scale = (1.0f - 0.7f * (difficulty.CircleSize - 5) / 5) / 2 * 1.00041f;
+    return 64 * scale;
+}
+
+// The parts of the difficulty objects that don't depend on the rate. hitObjects must have mods and stacking applied.
+inline DifficultyObjects difficulty_geometry(std::span<const HitObject> hitObjects, const MapDifficultyAttributes& difficulty)
+{
+    DifficultyObjects d;
+    d.radius = difficulty_radius(difficulty);
+
+    std::vector<const HitObject*> movements;
+    for (size_t begin = 0, end; begin < hitObjects.size(); begin = end)
+    {
+        for (end = begin + 1; end < hitObjects.size() && !is_start_event(hitObjects[end].type); ++end) {}
+        d.objects.push_back(difficulty_object(hitObjects.subspan(begin, end - begin), d.radius, movements));
+    }
+
+    while (d.type.size() + 1 < d.objects.size())
+        append_geometry(d);
+    return d;
+}
+
+// Appends the times of the next difficulty object, once its geometry is there.
+inline void append_timing(DifficultyObjects& d)
+{
+    size_t k = d.start_time.size();
+    const auto& current = d.objects[k + 1];
+    const auto& last = d.objects[k];
+
+    d.start_time.push_back(current.start_time / d.time_rate);
+    d.delta_time.push_back((current.start_time - last.start_time) / d.time_rate);
+    d.strain_time.push_back(std::max(d.delta_time[k], min_delta_time));
+    d.hit_window_great.push_back(current.type == spinner_start ? 0 : d.hit_window);
+    d.minimum_jump_time.push_back(0);
+    d.travel_time.push_back(0);
+
+    if (current.type == slider_head)
+        d.travel_time[k] = std::max(current.lazy_travel_time / d.time_rate, min_delta_time);
+
+    if (current.type == spinner_start || last.type == spinner_start)
+        return;
+
+    d.minimum_jump_time[k] = d.strain_time[k];
+    if (last.type == slider_head)
+    {
+        double lastTravelTime = std::max(last.lazy_travel_time / d.time_rate, min_delta_time);
+        d.minimum_jump_time[k] = std::max(d.strain_time[k] - lastTravelTime, min_delta_time);
+    }
+}
+
+// Sets the rate the times of the difficulty objects are for, without filling them in: hit object times are divided by
+// timeRate (1 if they are already scaled) and the hit windows and preempt by clockRate.
+inline void set_rate_constants(DifficultyObjects& d, const MapDifficultyAttributes& difficulty, double timeRate, double clockRate)
+{
+    d.time_rate = timeRate;
+    d.preempt = difficulty_range(difficulty.ApproachRate, 1800, 1200, 450) / clockRate;
+    d.fade_in = 400 * std::min(1.0, d.preempt * clockRate / 450) / clockRate;
+    d.hit_window = 2 * difficulty_range(difficulty.OverallDifficulty, 80, 50, 20) / clockRate;
+}
+
+// Fills in the parts of the difficulty objects that depend on the rate, see set_rate_constants.
+inline void set_rate(DifficultyObjects& d, const MapDifficultyAttributes& difficulty, double timeRate, double clockRate)
+{
+    set_rate_constants(d, difficulty, timeRate, clockRate);
+    for (auto* v : {&d.start_time, &d.delta_time, &d.strain_time, &d.hit_window_great, &d.minimum_jump_time, &d.travel_time})
+        v->clear();
+    while (d.start_time.size() < d.type.size())
+        append_timing(d);
+}
+
+// OsuDifficultyHitObject.GetDoubletapness of k against the object after it
+inline double doubletapness(const DifficultyObjects& d, size_t k)
+{
+    if (k + 1 >= d.size())
+        return 0;
+    double currDeltaTime = std::max(1.0, d.delta_time[k]);
+    double nextDeltaTime = std::max(1.0, d.delta_time[k + 1]);
+    double deltaDifference = std::abs(nextDeltaTime - currDeltaTime);
+    double speedRatio = currDeltaTime / std::max(currDeltaTime, deltaDifference);
+    double windowRatio = std::pow(std::min(1.0, currDeltaTime / d.hit_window_great[k]), 2);
+    return 1.0 - std::pow(speedRatio, 1 - windowRatio);
+}
+
+// AimEvaluator.cs
+namespace aim {
+constexpr double wide_angle_multiplier = 1.5;
+constexpr double acute_angle_multiplier = 1.95;
+constexpr double slider_multiplier = 1.35;
+constexpr double velocity_change_multiplier = 0.75;
+
+// calcWideAngleBonus before it is squared, which is the same for the acute angle bonus
+inline double angle_bonus_argument(double angle)
+{
+    return 3.0 / 4 * (std::min(5.0 / 6 * std::numbers::pi, std::max(std::numbers::pi / 6, angle)) - std::numbers::pi / 6);
+}
+inline double wide_angle_bonus(double angle) { return std::pow(std::sin(angle_bonus_argument(angle)), 2); }
+inline double acute_angle_bonus(double angle) { return 1 - wide_angle_bonus(angle); }
+}
+
+// AimEvaluator.EvaluateDifficultyOf the object at k
+inline double aim_at(const DifficultyObjects& d, size_t k, bool withSliderTravelDistance)
+{
+    using namespace aim;
+    constexpr double radius = normalised_radius;
+    constexpr double diameter = normalised_diameter;
+
+    if (k <= 1 || d.type[k] == spinner_start || d.type[k - 1] == spinner_start)
+        return 0;
+    size_t last = k - 1, lastLast = k - 2;
+
+    // velocity to the current object, extended through the last object if it is a slider
+    double currVelocity = d.lazy_jump_distance[k] / d.strain_time[k];
+    if (d.type[last] == slider_head && withSliderTravelDistance)
+    {
+        double travelVelocity = d.travel_distance[last] / d.travel_time[last];
+        double movementVelocity = d.minimum_jump_distance[k] / d.minimum_jump_time[k];
+        currVelocity = std::max(currVelocity, movementVelocity + travelVelocity);
+    }
+    double prevVelocity = d.lazy_jump_distance[last] / d.strain_time[last];
+    if (d.type[lastLast] == slider_head && withSliderTravelDistance)
+    {
+        double travelVelocity = d.travel_distance[lastLast] / d.travel_time[lastLast];
+        double movementVelocity = d.minimum_jump_distance[last] / d.minimum_jump_time[last];
+        prevVelocity = std::max(prevVelocity, movementVelocity + travelVelocity);
+    }
+
+    double wideBonus = 0;
+    double acuteBonus = 0;
+    double sliderBonus = 0;
+    double velocityChangeBonus = 0;
+
+    double aimStrain = currVelocity;
+
+    double shorterTime = std::min(d.strain_time[k], d.strain_time[last]);
+    double longerTime = std::max(d.strain_time[k], d.strain_time[last]);
+    if (longerTime < 1.25 * shorterTime && !std::isnan(d.angle[k]) && !std::isnan(d.angle[last]) && !std::isnan(d.angle[lastLast]))
+    {
+        double currAngle = d.angle[k];
+        double lastAngle = d.angle[last];
+        double lastLastAngle = d.angle[lastLast];
+
+        // rewarding angles, take the smaller velocity as base
+        double angleBonus = std::min(currVelocity, prevVelocity);
+
+        wideBonus = wide_angle_bonus(currAngle);
+        acuteBonus = acute_angle_bonus(currAngle);
+
+        // only buff deltas shorter than 300 BPM 1/2
+        if (d.strain_time[k] > 100)
+            acuteBonus = 0;
+        else
+        {
+            // wiggle patterns only, up to a velocity of 125 / strainTime, scaled from 150 to 200 BPM 1/4 and by the
+            // distance past the radius up to the diameter
+            acuteBonus *= acute_angle_bonus(lastAngle)
+                          * std::min(angleBonus, diameter * 1.25 / d.strain_time[k])
+                          * std::pow(std::sin(std::numbers::pi / 2 * std::min(1.0, (100 - d.strain_time[k]) / 25)), 2)
+                          * std::pow(std::sin(std::numbers::pi / 2 * (std::clamp(d.lazy_jump_distance[k], radius, diameter) - radius) / radius), 2);
+        }
+
+        // penalize repeated wide angles, less so as the last angle gets more acute
+        wideBonus *= angleBonus * (1 - std::min(wideBonus, std::pow(wide_angle_bonus(lastAngle), 3)));
+        // penalize repeated acute angles, less so as the one before last gets wider
+        acuteBonus *= 0.5 + 0.5 * (1 - std::min(acuteBonus, std::pow(acute_angle_bonus(lastLastAngle), 3)));
+    }
+
+    if (std::max(prevVelocity, currVelocity) != 0)
+    {
+        // average velocity over the whole object rather than the individual jump and slider path velocities
+        prevVelocity = (d.lazy_jump_distance[last] + d.travel_distance[lastLast]) / d.strain_time[last];
+        currVelocity = (d.lazy_jump_distance[k] + d.travel_distance[last]) / d.strain_time[k];
+
+        double distRatio = std::pow(std::sin(std::numbers::pi / 2 * std::abs(prevVelocity - currVelocity) / std::max(prevVelocity, currVelocity)), 2);
+
+        // reward for % distance up to 125 / strainTime for overlaps where velocity is still changing
+        double overlapVelocityBuff = std::min(diameter * 1.25 / shorterTime, std::abs(prevVelocity - currVelocity));
+        velocityChangeBonus = overlapVelocityBuff * distRatio;
+
+        // penalize for rhythm changes
+        velocityChangeBonus *= std::pow(shorterTime / longerTime, 2);
+    }
+
+    if (d.type[last] == slider_head)
+        sliderBonus = d.travel_distance[last] / d.travel_time[last];
+
+    aimStrain += std::max(acuteBonus * acute_angle_multiplier, wideBonus * wide_angle_multiplier + velocityChangeBonus * velocity_change_multiplier);
+    if (withSliderTravelDistance)
+        aimStrain += sliderBonus * slider_multiplier;
+
+    return aimStrain;
+}
+
+// AimEvaluator.cs for every object at once, with and without slider travel distance, giving the same values as aim_at.
+// The terms are computed a column at a time, so that those an object shares with the next one are computed once and
+// the loops vectorize (GCC -O3, see -fopt-info-vec); only those calling pow and sin stay scalar. A loop that picks a
+// constant where a condition doesn't hold (a clamp, or a bonus that is 0) and then does more arithmetic is left
+// scalar, as the compiler won't speculate floating point operations or loads that may trap, so those picks end their
+// loop and what they pick from is loaded before the condition. Each loop also reads few enough columns for the
+// compiler to check them for overlap.
+inline void evaluate_aim(const DifficultyObjects& d, std::span<double> withSliders, std::span<double> withoutSliders)
+{
+    using namespace aim;
+    constexpr double radius = normalised_radius;
+    constexpr double diameter = normalised_diameter;
+
+    const size_t n = d.size();
+    std::fill(withSliders.begin(), withSliders.end(), 0.0);
+    std::fill(withoutSliders.begin(), withoutSliders.end(), 0.0);
+    if (n < 3)
+        return;
+
+    constexpr size_t column_count = 17;
+    std::vector<double> columns(n * column_count);
+    auto column = [n, next = columns.data()]() mutable { return std::exchange(next, next + n); };
+
+    // per object
+    double* velocity = column();
+    double* sliderVelocity = column();
+    double* extendedVelocity = column();
+    double* averageVelocity = column();
+    double* wide = column();
+    double* acute = column();
+    double* wideCubed = column();
+    double* acuteCubed = column();
+    double* acuteTime = column();
+    double* acuteDistance = column();
+    // per object against the ones before it
+    double* movementVelocity = column();
+    double* angles = column();
+    double* velocityChange = column();
+    double* sliderTerm = column();
+    // per object against the ones before it, for one variant at a time
+    double* wideTerm = column();
+    double* acuteTerm = column();
+    double* velocityChangeTerm = column();
+
+    const HitObjectType* type = d.type.data();
+    const double* jump = d.lazy_jump_distance.data();
+    const double* minimumJump = d.minimum_jump_distance.data();
+    const double* travel = d.travel_distance.data();
+    const double* angle = d.angle.data();
+    const double* strainTime = d.strain_time.data();
+    const double* minimumJumpTime = d.minimum_jump_time.data();
+    const double* travelTime = d.travel_time.data();
+
+    for (size_t j = 0; j < n; ++j)
+        velocity[j] = jump[j] / strainTime[j];
+    // NaN where there is no slider, and only used where there is
+    for (size_t j = 0; j < n; ++j)
+        sliderVelocity[j] = travel[j] / travelTime[j];
+    for (size_t j = 1; j < n; ++j)
+        movementVelocity[j] = minimumJump[j] / minimumJumpTime[j] + sliderVelocity[j - 1];
+    // velocity to the object, extended through the last object if it is a slider
+    extendedVelocity[0] = velocity[0];
+    for (size_t j = 1; j < n; ++j)
+    {
+        double extended = std::max(velocity[j], movementVelocity[j]);
+        extendedVelocity[j] = type[j - 1] == slider_head ? extended : velocity[j];
+    }
+    // over the whole object rather than the individual jump and slider path
+    for (size_t j = 1; j < n; ++j)
+        averageVelocity[j] = (jump[j] + travel[j - 1]) / strainTime[j];
+
+    // the angle bonuses, and the scales of the acute one by delta and distance, where they apply
+    for (size_t j = 0; j < n; ++j)
+        wide[j] = std::min(5.0 / 6 * std::numbers::pi, std::max(std::numbers::pi / 6, angle[j]));
+    for (size_t j = 0; j < n; ++j)
+        wide[j] = 3.0 / 4 * (wide[j] - std::numbers::pi / 6);
+    for (size_t j = 0; j < n; ++j)
+        acuteTime[j] = std::min(1.0, (100 - strainTime[j]) / 25);
+    for (size_t j = 0; j < n; ++j)
+        acuteTime[j] *= std::numbers::pi / 2;
+    for (size_t j = 0; j < n; ++j)
+        acuteDistance[j] = std::min(std::max(jump[j], radius), diameter);
+    for (size_t j = 0; j < n; ++j)
+        acuteDistance[j] = std::numbers::pi / 2 * (acuteDistance[j] - radius) / radius;
+    for (size_t j = 0; j < n; ++j)
+    {
+        wide[j] = std::sin(wide[j]);
+        acuteTime[j] = std::sin(acuteTime[j]);
+        acuteDistance[j] = std::sin(acuteDistance[j]);
+    }
+    for (size_t j = 0; j < n; ++j)
+    {
+        wide[j] = std::pow(wide[j], 2);
+        acuteTime[j] = std::pow(acuteTime[j], 2);
+        acuteDistance[j] = std::pow(acuteDistance[j], 2);
+    }
+    for (size_t j = 0; j < n; ++j)
+        acute[j] = 1 - wide[j];
+    for (size_t j = 0; j < n; ++j)
+    {
+        wideCubed[j] = std::pow(wide[j], 3);
+        acuteCubed[j] = std::pow(acute[j], 3);
+    }
+
+    // the velocity change bonus, without the condition on the velocities
+    for (size_t k = 2; k < n; ++k)
+        velocityChange[k] = std::numbers::pi / 2 * std::abs(averageVelocity[k - 1] - averageVelocity[k]) / std::max(averageVelocity[k - 1], averageVelocity[k]);
+    for (size_t k = 2; k < n; ++k)
+        velocityChange[k] = std::sin(velocityChange[k]);
+    for (size_t k = 2; k < n; ++k)
+        velocityChange[k] = std::pow(velocityChange[k], 2);
+    for (size_t k = 2; k < n; ++k)
+    {
+        double shorterTime = std::min(strainTime[k], strainTime[k - 1]);
+        double longerTime = std::max(strainTime[k], strainTime[k - 1]);
+        // reward for % distance up to 125 / strainTime for overlaps where velocity is still changing
+        double overlapVelocityBuff = std::min(diameter * 1.25 / shorterTime, std::abs(averageVelocity[k - 1] - averageVelocity[k]));
+        // penalize for rhythm changes
+        velocityChange[k] = overlapVelocityBuff * velocityChange[k] * std::pow(shorterTime / longerTime, 2) * velocity_change_multiplier;
+    }
+
+    for (size_t k = 2; k < n; ++k)
+    {
+        double bonus = sliderVelocity[k - 1];
+        sliderTerm[k] = type[k - 1] == slider_head ? bonus : 0.0;
+    }
+    for (size_t k = 2; k < n; ++k)
+        sliderTerm[k] *= slider_multiplier;
+
+    // whether the angle bonuses apply, as the angles and the deltas of the objects are close enough
+    for (size_t k = 2; k < n; ++k)
+    {
+        double shorterTime = std::min(strainTime[k], strainTime[k - 1]);
+        double longerTime = std::max(strainTime[k], strainTime[k - 1]);
+        angles[k] = (longerTime < 1.25 * shorterTime) & !std::isnan(angle[k]) & !std::isnan(angle[k - 1]) & !std::isnan(angle[k - 2]) ? 1.0 : 0.0;
+    }
+
+    for (int variant = 0; variant < 2; ++variant)
+    {
+        const double* v = variant == 0 ? extendedVelocity : velocity;
+        double* out = variant == 0 ? withSliders.data() : withoutSliders.data();
+
+        // the bonuses, taking the smaller velocity as base and penalizing angle repetition
+        for (size_t k = 2; k < n; ++k)
+            wideTerm[k] = wide[k] * (std::min(v[k], v[k - 1]) * (1 - std::min(wide[k], wideCubed[k - 1]))) * wide_angle_multiplier;
+        for (size_t k = 2; k < n; ++k)
+            acuteTerm[k] = acute[k] * (acute[k - 1] * std::min(std::min(v[k], v[k - 1]), diameter * 1.25 / strainTime[k]) * acuteTime[k] * acuteDistance[k]);
+        for (size_t k = 2; k < n; ++k)
+            acuteTerm[k] = acuteTerm[k] * (0.5 + 0.5 * (1 - std::min(acuteTerm[k], acuteCubed[k - 2]))) * acute_angle_multiplier;
+
+        // and those that don't apply, the acute one only applying to deltas shorter than 300 BPM 1/2
+        for (size_t k = 2; k < n; ++k)
+            wideTerm[k] = angles[k] != 0 ? wideTerm[k] : 0.0;
+        for (size_t k = 2; k < n; ++k)
+            acuteTerm[k] = (angles[k] != 0) & (strainTime[k] <= 100) ? acuteTerm[k] : 0.0;
+        for (size_t k = 2; k < n; ++k)
+        {
+            double bonus = velocityChange[k];
+            velocityChangeTerm[k] = std::max(v[k - 1], v[k]) != 0 ? bonus : 0.0;
+        }
+
+        for (size_t k = 2; k < n; ++k)
+            out[k] = v[k] + std::max(acuteTerm[k], wideTerm[k] + velocityChangeTerm[k]);
+        if (variant == 0)
+            for (size_t k = 2; k < n; ++k)
+                out[k] += sliderTerm[k];
+        for (size_t k = 2; k < n; ++k)
+            out[k] = (type[k] == spinner_start) | (type[k - 1] == spinner_start) ? 0.0 : out[k];
+    }
+}
+
+// SpeedEvaluator.cs
+namespace speed {
+constexpr double single_spacing_threshold = normalised_diameter * 1.25;
+constexpr double min_speed_bonus = 200; // 200 BPM 1/4th
+constexpr double speed_balancing_factor = 40;
+constexpr double distance_multiplier = 0.94;
+}
+
+// SpeedEvaluator.EvaluateDifficultyOf the object at k, which needs the delta time of the object after it
+inline double speed_at(const DifficultyObjects& d, size_t k)
+{
+    using namespace speed;
+
+    if (d.type[k] == spinner_start)
+        return 0;
+
+    double strainTime = d.strain_time[k];
+    double doubletap = 1.0 - doubletapness(d, k);
+
+    // cap delta time to the OD 300 hit window
+    strainTime /= std::clamp((strainTime / d.hit_window_great[k]) / 0.93, 0.92, 1.0);
+
+    double speedBonus = 0.0;
+    if (milliseconds_to_bpm(strainTime) > min_speed_bonus)
+        speedBonus = 0.75 * std::pow((bpm_to_milliseconds(min_speed_bonus) - strainTime) / speed_balancing_factor, 2);
+
+    double travelDistance = k > 0 ? d.travel_distance[k - 1] : 0;
+    double distance = std::min(travelDistance + d.minimum_jump_distance[k], single_spacing_threshold);
+    double distanceBonus = std::pow(distance / single_spacing_threshold, 3.95) * distance_multiplier;
+
+    return (1 + speedBonus + distanceBonus) * 1000 / strainTime * doubletap;
+}
+
+// SpeedEvaluator.cs for every object at once, giving the same values as speed_at. doubletapness is that of every object
+// but the last, as RhythmPairs has it. The terms are computed a column at a time as in evaluate_aim.
+inline void evaluate_speed(const DifficultyObjects& d, std::span<const double> doubletapness, std::span<double> out)
+{
+    using namespace speed;
+
+    const size_t n = d.size();
+    if (n == 0)
+        return;
+
+    std::vector<double> columns(n * 3);
+    double* strainTime = columns.data();
+    double* speedBonus = strainTime + n;
+    double* distanceBonus = speedBonus + n;
+
+    const HitObjectType* type = d.type.data();
+    const double* minimumJump = d.minimum_jump_distance.data();
+    const double* travel = d.travel_distance.data();
+    const double* times = d.strain_time.data();
+    const double* hitWindowGreat = d.hit_window_great.data();
+    const double* doubletap = doubletapness.data();
+    double* result = out.data();
+
+    // cap delta time to the OD 300 hit window, clamping by value for the loop to vectorize
+    for (size_t k = 0; k < n; ++k)
+        strainTime[k] = std::min(std::max((times[k] / hitWindowGreat[k]) / 0.93, 0.92), 1.0);
+    for (size_t k = 0; k < n; ++k)
+        strainTime[k] = times[k] / strainTime[k];
+
+    for (size_t k = 0; k < n; ++k)
+        speedBonus[k] = 0.75 * std::pow((bpm_to_milliseconds(min_speed_bonus) - strainTime[k]) / speed_balancing_factor, 2);
+    for (size_t k = 0; k < n; ++k)
+    {
+        double bonus = speedBonus[k];
+        speedBonus[k] = milliseconds_to_bpm(strainTime[k]) > min_speed_bonus ? bonus : 0.0;
+    }
+
+    distanceBonus[0] = std::min(minimumJump[0], single_spacing_threshold);
+    for (size_t k = 1; k < n; ++k)
+        distanceBonus[k] = std::min(travel[k - 1] + minimumJump[k], single_spacing_threshold);
+    for (size_t k = 0; k < n; ++k)
+        distanceBonus[k] = std::pow(distanceBonus[k] / single_spacing_threshold, 3.95) * distance_multiplier;
+
+    for (size_t k = 0; k + 1 < n; ++k)
+        result[k] = 1.0 - doubletap[k];
+    result[n - 1] = 1.0;
+    for (size_t k = 0; k < n; ++k)
+        result[k] = (1 + speedBonus[k] + distanceBonus[k]) * 1000 / strainTime[k] * result[k];
+    for (size_t k = 0; k < n; ++k)
+        result[k] = type[k] == spinner_start ? 0.0 : result[k];
+}
+
+// runs of objects with about the same delta, for RhythmEvaluator
+struct RhythmIsland
+{
+    double epsilon;
+    int delta = std::numeric_limits<int>::max();
+    int delta_count = 0;
+
+    RhythmIsland(double epsilon): epsilon(epsilon) {}
+    RhythmIsland(int delta, double epsilon): epsilon(epsilon), delta(std::max<int>(delta, min_delta_time)), delta_count(1) {}
+
+    void add_delta(int d)
+    {
+        if (delta == std::numeric_limits<int>::max())
+            delta = std::max<int>(d, min_delta_time);
+        ++delta_count;
+    }
+    bool is_similar_polarity(const RhythmIsland& other) const { return delta_count % 2 == other.delta_count % 2; }
+    bool operator==(const RhythmIsland& other) const { return std::abs(delta - other.delta) < epsilon && delta_count == other.delta_count; }
+};
+
+// The hit window is the same for every object that is evaluated (spinners aren't), so the ratio of each pair of
+// consecutive deltas and the doubletapness are computed once rather than for each object looking back at them.
+struct RhythmPairs
+{
+    std::vector<double> ratio;
+    std::vector<double> doubletapness;
+    std::vector<std::pair<RhythmIsland, int>> island_counts;
+
+    // extends the pairs to the objects in d, the doubletapness to those with a next object
+    void update(const DifficultyObjects& d)
+    {
+        constexpr double rhythm_ratio_multiplier = 12.0;
+        const double deltaDifferenceEpsilon = d.hit_window * 0.3;
+
+        if (ratio.empty() && d.size() > 0)
+            ratio.push_back(0);
+        for (size_t j = ratio.size(); j < d.size(); ++j)
+        {
+            double currDelta = d.strain_time[j];
+            double prevDelta = d.strain_time[j - 1];
+
+            // reduce the bonus for deltas that are multiples of each other (i.e 100 and 200)
+            double deltaDifferenceRatio = std::min(prevDelta, currDelta) / std::max(prevDelta, currDelta);
+            double currRatio = 1.0 + rhythm_ratio_multiplier * std::min(0.5, std::pow(std::sin(std::numbers::pi / deltaDifferenceRatio), 2));
+
+            // reduce the bonus if the delta difference is too big
+            double fraction = std::max(prevDelta / currDelta, currDelta / prevDelta);
+            double fractionMultiplier = std::clamp(2.0 - fraction / 8.0, 0.0, 1.0);
+
+            double windowPenalty = std::min(1.0, std::max(0.0, std::abs(prevDelta - currDelta) - deltaDifferenceEpsilon) / deltaDifferenceEpsilon);
+
+            ratio.push_back(windowPenalty * currRatio * fractionMultiplier);
+        }
+        for (size_t j = doubletapness.size(); j + 1 < d.size(); ++j)
+            doubletapness.push_back(detail::doubletapness(d, j));
+    }
+};
+
+// RhythmEvaluator.EvaluateDifficultyOf the object at k, once pairs are updated to it
+inline double rhythm_at(const DifficultyObjects& d, size_t k, RhythmPairs& pairs)
+{
+    constexpr double history_time_max = 5 * 1000;
+    constexpr int history_objects_max = 32;
+    constexpr double rhythm_overall_multiplier = 0.95;
+    using Island = RhythmIsland;
+
+    const double deltaDifferenceEpsilon = d.hit_window * 0.3;
+    const auto& pairRatio = pairs.ratio;
+    const auto& pairDoubletapness = pairs.doubletapness;
+    auto& islandCounts = pairs.island_counts;
+
+    if (d.type[k] == spinner_start)
+        return 0;
+
+    double rhythmComplexitySum = 0;
+
+    Island island(deltaDifferenceEpsilon);
+    Island previousIsland(deltaDifferenceEpsilon);
+    islandCounts.clear();
+
+    double startRatio = 0;
+    bool firstDeltaSwitch = false;
+
+    int historicalNoteCount = std::min<int>(k, history_objects_max);
+    int rhythmStart = 0;
+    while (rhythmStart < historicalNoteCount - 2 && d.start_time[k] - d.start_time[k - 1 - rhythmStart] < history_time_max)
+        ++rhythmStart;
+
+    if (rhythmStart == 0)
+        return 1;
+    size_t prev = k - 1 - rhythmStart;
+    size_t last = k - 2 - rhythmStart;
+
+    // from the furthest object back to the current one
+    for (int i = rhythmStart; i > 0; --i)
+    {
+        size_t curr = k - i;
+
+        double timeDecay = (history_time_max - (d.start_time[k] - d.start_time[curr])) / history_time_max;
+        double noteDecay = (double) (historicalNoteCount - i) / historicalNoteCount;
+        double currHistoricalDecay = std::min(noteDecay, timeDecay);
+
+        double currDelta = d.strain_time[curr];
+        double prevDelta = d.strain_time[prev];
+        double lastDelta = d.strain_time[last];
+
+        // prev is always curr - 1
+        double effectiveRatio = pairRatio[curr];
+
+        if (firstDeltaSwitch)
+        {
+            if (std::abs(prevDelta - currDelta) < deltaDifferenceEpsilon)
+            {
+                // island is still progressing
+                island.add_delta((int) currDelta);
+            }
+            else
+            {
+                // bpm change into a slider is an easy acc window
+                if (d.type[curr] == slider_head)
+                    effectiveRatio *= 0.125;
+
+                // bpm change from a slider is typically easier than circle -> circle
+                if (d.type[prev] == slider_head)
+                    effectiveRatio *= 0.3;
+
+                // repeated island polarity (2 -> 4, 3 -> 5)
+                if (island.is_similar_polarity(previousIsland))
+                    effectiveRatio *= 0.5;
+
+                // previous increase happened a note ago, 1/1->1/2-1/4, dont want to buff this
+                if (lastDelta > prevDelta + deltaDifferenceEpsilon && prevDelta > currDelta + deltaDifferenceEpsilon)
+                    effectiveRatio *= 0.125;
+
+                // repeated island size (ex: triplet -> triplet)
+                if (previousIsland.delta_count == island.delta_count)
+                    effectiveRatio *= 0.5;
+
+                auto islandCount = std::find_if(islandCounts.begin(), islandCounts.end(), [&](const auto& c) { return c.first == island; });
+                if (islandCount != islandCounts.end())
+                {
+                    // only count islands that follow each other
+                    if (previousIsland == island)
+                        ++islandCount->second;
+
+                    // repeated island (ex: triplet -> triplet)
+                    double power = logistic(island.delta, 58.33, 0.24, 2.75);
+                    effectiveRatio *= std::min(3.0 / islandCount->second, std::pow(1.0 / islandCount->second, power));
+                }
+                else
+                    islandCounts.emplace_back(island, 1);
+
+                // scale down the difficulty if the object is doubletappable
+                effectiveRatio *= 1 - pairDoubletapness[prev] * 0.75;
+
+                rhythmComplexitySum += std::sqrt(effectiveRatio * startRatio) * currHistoricalDecay;
+
+                startRatio = effectiveRatio;
+                previousIsland = island;
+
+                // slowing down, stop counting; when speeding up we keep counting the island size
+                if (prevDelta + deltaDifferenceEpsilon < currDelta)
+                    firstDeltaSwitch = false;
+
+                island = Island((int) currDelta, deltaDifferenceEpsilon);
+            }
+        }
+        else if (prevDelta > currDelta + deltaDifferenceEpsilon)
+        {
+            // speeding up, begin counting the island until the speed changes again
+            firstDeltaSwitch = true;
+
+            if (d.type[curr] == slider_head)
+                effectiveRatio *= 0.6;
+            if (d.type[prev] == slider_head)
+                effectiveRatio *= 0.6;
+
+            startRatio = effectiveRatio;
+            island = Island((int) currDelta, deltaDifferenceEpsilon);
+        }
+
+        last = prev;
+        prev = curr;
+    }
+
+    return std::sqrt(4 + rhythmComplexitySum * rhythm_overall_multiplier) / 2.0;
+}
+
+// RhythmEvaluator.cs, for every object at once, with pairs updated to them.
+inline void evaluate_rhythm(const DifficultyObjects& d, RhythmPairs& pairs, std::span<double> out)
+{
+    for (size_t k = 0; k < d.size(); ++k)
+        out[k] = rhythm_at(d, k, pairs);
+}
+
+// OsuDifficultyHitObject.OpacityAt of the object at k
+inline double opacity_at(const DifficultyObjects& d, size_t k, double time, bool hidden)
+{
+    if (time > d.start_time[k])
+        return 0;
+
+    double fadeInStartTime = d.start_time[k] - d.preempt;
+    double fadeIn = std::clamp((time - fadeInStartTime) / d.fade_in, 0.0, 1.0);
+    if (!hidden)
+        return fadeIn;
+
+    // OsuModHidden, FADE_OUT_DURATION_MULTIPLIER = 0.3
+    double fadeOutStartTime = d.start_time[k] - d.preempt + d.fade_in;
+    double fadeOutDuration = d.preempt * 0.3;
+    return std::min(fadeIn, 1.0 - std::clamp((time - fadeOutStartTime) / fadeOutDuration, 0.0, 1.0));
+}
+
+// FlashlightEvaluator.EvaluateDifficultyOf the object at k
+inline double flashlight_at(const DifficultyObjects& d, size_t k, bool hidden)
+{
+    constexpr double max_opacity_bonus = 0.4;
+    constexpr double hidden_bonus = 0.2;
+    constexpr double min_velocity = 0.5;
+    constexpr double slider_multiplier = 1.3;
+    constexpr double min_angle_multiplier = 0.2;
+
+    if (d.type[k] == spinner_start)
+        return 0;
+
+    double scalingFactor = 52.0 / d.radius;
+    const auto& current = d.object(k);
+
+    double smallDistNerf = 1.0;
+    double cumulativeStrainTime = 0.0;
+    double result = 0.0;
+    size_t last = k;
+    double angleRepeatCount = 0.0;
+
+    // backwards in time from the current object
+    for (size_t i = 0; i < std::min<size_t>(k, 10); ++i)
+    {
+        size_t j = k - 1 - i;
+        cumulativeStrainTime += d.strain_time[last];
+
+        if (d.type[j] != spinner_start)
+        {
+            double jumpDistance = (current.position - d.object(j).end_position).length();
+
+            // nerf objects that can be easily seen within the Flashlight circle radius
+            if (i == 0)
+                smallDistNerf = std::min(1.0, jumpDistance / 75.0);
+
+            // nerf stacks so that only the first object of the stack is accounted for
+            double stackNerf = std::min(1.0, (d.lazy_jump_distance[j] / scalingFactor) / 25.0);
+
+            // bonus based on how visible the object is
+            double opacityBonus = 1.0 + max_opacity_bonus * (1.0 - opacity_at(d, k, d.start_time[j], hidden));
+
+            result += stackNerf * opacityBonus * scalingFactor * jumpDistance / cumulativeStrainTime;
+
+            // objects further back in time count less for the nerf
+            if (!std::isnan(d.angle[j]) && !std::isnan(d.angle[k]) && std::abs(d.angle[j] - d.angle[k]) < 0.02)
+                angleRepeatCount += std::max(1.0 - 0.1 * i, 0.0);
+        }
+        last = j;
+    }
+
+    result = std::pow(smallDistNerf * result, 2.0);
+
+    // less information is present with hidden
+    if (hidden)
+        result *= 1.0 + hidden_bonus;
+
+    // nerf patterns with repeated angles
+    result *= min_angle_multiplier + (1.0 - min_angle_multiplier) / (angleRepeatCount + 1.0);
+
+    double sliderBonus = 0.0;
+    if (d.type[k] == slider_head)
+    {
+        // true travel distance independent of circle size
+        double pixelTravelDistance = current.lazy_travel_distance / scalingFactor;
+
+        // reward sliders based on velocity, longer sliders require more memorisation
+        sliderBonus = std::pow(std::max(0.0, pixelTravelDistance / d.travel_time[k] - min_velocity), 0.5);
+        sliderBonus *= pixelTravelDistance;
+
+        // nerf sliders with repeats, as less memorisation is required
+        if (current.repeat_count > 0)
+            sliderBonus /= current.repeat_count + 1;
+    }
+
+    return result + sliderBonus * slider_multiplier;
+}
+
+// FlashlightEvaluator.cs, for every object at once.
+inline void evaluate_flashlight(const DifficultyObjects& d, bool hidden, std::span<double> out)
+{
+    for (size_t k = 0; k < d.size(); ++k)
+        out[k] = flashlight_at(d, k, hidden);
+}
+
+// Strain of a skill after each object and its peaks per 400ms section, as in lazer's StrainSkill, one object at a
+// time. The strain decays by decayBase per second of step, then adds the object's difficulty; factor scales the result.
+class StrainAccumulator
+{
+public:
+    static constexpr double section_length = 400;
+
+    StrainAccumulator(double skillMultiplier, double decayBase)
+        : skill_multiplier_(skillMultiplier), log_decay_base_(std::log(decayBase)) {}
+
+    void add(double startTime, double step, double difficulty, double factor = 1)
+    {
+        if (object_strains_.empty())
+            section_end_ = std::ceil(startTime / section_length) * section_length;
+
+        while (startTime > section_end_)
+        {
+            peaks_.push_back(section_peak_);
+            section_peak_ = current_strain_ * current_factor_ * decay(section_end_ - previous_time_);
+            section_end_ += section_length;
+        }
+
+        current_strain_ = current_strain_ * decay(step) + difficulty * skill_multiplier_;
+        current_factor_ = factor;
+        object_strains_.push_back(current_strain_ * current_factor_);
+        section_peak_ = std::max(object_strains_.back(), section_peak_);
+        previous_time_ = startTime;
+    }
+
+    const std::vector<double>& object_strains() const { return object_strains_; }
+    // peaks of the sections before the current one
+    const std::vector<double>& finished_peaks() const { return peaks_; }
+    double section_peak() const { return section_peak_; }
+    std::vector<double> peaks() const
+    {
+        auto peaks = peaks_;
+        if (!object_strains_.empty())
+            peaks.push_back(section_peak_);
+        return peaks;
+    }
+
+private:
+    double decay(double ms) const { return std::exp(log_decay_base_ * ms / 1000); }
+
+    double skill_multiplier_;
+    double log_decay_base_;
+    double current_strain_ = 0;
+    double current_factor_ = 1;
+    double section_peak_ = 0;
+    double section_end_ = 0;
+    double previous_time_ = 0;
+    std::vector<double> peaks_;
+    std::vector<double> object_strains_;
+};
+
+// StrainAccumulator over every object at once; factor may be empty.
+inline StrainAccumulator strains(const DifficultyObjects& d, std::span<const double> difficulty, std::span<const double> step,
+                                 std::span<const double> factor, double skillMultiplier, double decayBase)
+{
+    StrainAccumulator s(skillMultiplier, decayBase);
+    for (size_t k = 0; k < d.size(); ++k)
+        s.add(d.start_time[k], step[k], difficulty[k], factor.empty() ? 1 : factor[k]);
+    return s;
+}
+
+constexpr int max_reduced_section_count = 10;
+
+// OsuStrainSkill.DifficultyValue of positive peaks that are sorted in descending order
+inline double weighted_difficulty_sorted(std::span<const double> peaks, int reducedSectionCount)
+{
+    constexpr double reduced_strain_baseline = 0.75;
+    constexpr double decay_weight = 0.9;
+
+    // the reduced peaks are sorted again and merged with the rest
+    std::array<double, max_reduced_section_count> reduced;
+    size_t reducedCount = std::min<size_t>(peaks.size(), reducedSectionCount);
+    for (size_t i = 0; i < reducedCount; ++i)
+    {
+        double scale = std::log10(std::lerp(1.0, 10.0, std::clamp((float) i / reducedSectionCount, 0.0f, 1.0f)));
+        reduced[i] = peaks[i] * std::lerp(reduced_strain_baseline, 1.0, scale);
+    }
+    std::sort(reduced.begin(), reduced.begin() + reducedCount, std::greater<>());
+
+    double difficulty = 0;
+    double weight = 1;
+    for (size_t i = 0, j = reducedCount; i < reducedCount || j < peaks.size();)
+    {
+        double strain = j == peaks.size() || (i < reducedCount && reduced[i] >= peaks[j]) ? reduced[i++] : peaks[j++];
+        difficulty += strain * weight;
+        weight *= decay_weight;
+    }
+    return difficulty;
+}
+
+// OsuStrainSkill.DifficultyValue: weighted sum of the section peaks with the hardest few reduced
+inline double weighted_difficulty(std::vector<double> peaks, int reducedSectionCount)
+{
+    std::erase_if(peaks, [](double p) { return !(p > 0); });
+    std::sort(peaks.begin(), peaks.end(), std::greater<>());
+    return weighted_difficulty_sorted(peaks, reducedSectionCount);
+}
+
+// OsuStrainSkill.CountTopWeightedStrains
+inline double count_top_weighted_strains(std::span<const double> objectStrains, double difficulty)
+{
+    if (objectStrains.empty())
+        return 0;
+
+    // the top strain if all strains were identical
+    double consistentTopStrain = difficulty / 10;
+    if (consistentTopStrain == 0)
+        return objectStrains.size();
+
+    double sum = 0;
+    for (double s : objectStrains)
+        sum += 1.1 / (1 + std::exp(-10 * (s / consistentTopStrain - 0.88)));
+    return sum;
+}
+
+// Speed.RelevantNoteCount
+inline double relevant_note_count(std::span<const double> objectStrains)
+{
+    if (objectStrains.empty())
+        return 0;
+    double maxStrain = *std::max_element(objectStrains.begin(), objectStrains.end());
+    if (maxStrain == 0)
+        return 0;
+
+    double sum = 0;
+    for (double s : objectStrains)
+        sum += 1.0 / (1.0 + std::exp(-(s / maxStrain * 12.0 - 6.0)));
+    return sum;
+}
+
+}
+
+// OsuStrainSkill.DifficultyToPerformance
+inline double difficulty_to_performance(double difficulty)
+{
+    return std::pow(5.0 * std::max(1.0, difficulty / 0.0675) - 4.0, 3.0) / 100000.0;
+}
+
+// Flashlight.DifficultyToPerformance
+inline double flashlight_difficulty_to_performance(double difficulty)
+{
+    return 25 * std::pow(difficulty, 2);
+}
+
+namespace detail {
+
+constexpr double difficulty_multiplier = 0.0675;
+
+// skill multipliers, strain decay bases and reduced section counts of Aim, Speed and Flashlight
+constexpr double aim_skill_multiplier = 25.18;
+constexpr double aim_decay_base = 0.15;
+constexpr int aim_reduced_section_count = 10;
+constexpr double speed_skill_multiplier = 1.430;
+constexpr double speed_decay_base = 0.3;
+constexpr int speed_reduced_section_count = 5;
+constexpr double flashlight_skill_multiplier = 0.05512;
+constexpr double flashlight_decay_base = 0.15;
+
+// Skill difficulties before mods other than the rate are taken into account.
+struct SkillValues
+{
+    double aim = 0;
+    double aim_no_sliders = 0;
+    double speed = 0;
+    double speed_note_count = 0;
+    double aim_difficult_strain_count = 0;
+    double speed_difficult_strain_count = 0;
+};
+
+inline SkillValues skill_values(const DifficultyObjects& d)
+{
+    SkillValues v;
+    if (d.size() == 0)
+        return v;
+
+    std::vector<double> evaluated(d.size());
+    std::vector<double> noSliders(d.size());
+    std::vector<double> rhythm(d.size());
+
+    evaluate_aim(d, evaluated, noSliders);
+    auto aim = strains(d, evaluated, d.delta_time, {}, aim_skill_multiplier, aim_decay_base);
+    v.aim = weighted_difficulty(aim.peaks(), aim_reduced_section_count);
+    v.aim_difficult_strain_count = count_top_weighted_strains(aim.object_strains(), v.aim);
+    v.aim_no_sliders = weighted_difficulty(strains(d, noSliders, d.delta_time, {}, aim_skill_multiplier, aim_decay_base).peaks(),
+                                           aim_reduced_section_count);
+
+    // the doubletapness of the rhythm pairs serves speed as well
+    RhythmPairs pairs;
+    pairs.update(d);
+    evaluate_rhythm(d, pairs, rhythm);
+    evaluate_speed(d, pairs.doubletapness, evaluated);
+    auto speed = strains(d, evaluated, d.strain_time, rhythm, speed_skill_multiplier, speed_decay_base);
+    v.speed = weighted_difficulty(speed.peaks(), speed_reduced_section_count);
+    v.speed_note_count = relevant_note_count(speed.object_strains());
+    v.speed_difficult_strain_count = count_top_weighted_strains(speed.object_strains(), v.speed);
+    return v;
+}
+
+// Flashlight.DifficultyValue
+inline double flashlight_value(const DifficultyObjects& d, bool hidden)
+{
+    if (d.size() == 0)
+        return 0;
+
+    std::vector<double> evaluated(d.size());
+    evaluate_flashlight(d, hidden, evaluated);
+    double value = 0;
+    for (double peak : strains(d, evaluated, d.delta_time, {}, flashlight_skill_multiplier, flashlight_decay_base).peaks())
+        value += peak;
+    return value;
+}
+
+// Object counts and the rest of the attributes that don't need the difficulty objects.
+inline DifficultyAttributes map_attributes(std::span<const HitObject> hitObjects, const MapDifficultyAttributes& difficulty, double clockRate)
+{
+    DifficultyAttributes attributes;
+    for (const auto& h : hitObjects)
+    {
+        attributes.HitCircleCount += h.type == circle;
+        attributes.SliderCount += h.type == slider_head;
+        attributes.SpinnerCount += h.type == spinner_start;
+        // everything but the legacy last tick and the spinner end gives combo
+        attributes.MaxCombo += h.type != slider_legacy_last_tick && h.type != spinner_end;
+    }
+    double preempt = difficulty_range(difficulty.ApproachRate, 1800, 1200, 450) / clockRate;
+    attributes.ApproachRate = preempt > 1200 ? (1800 - preempt) / 120 : (1200 - preempt) / 150 + 5;
+    double hitWindowGreat = difficulty_range(difficulty.OverallDifficulty, 80, 50, 20) / clockRate;
+    attributes.OverallDifficulty = (80 - hitWindowGreat) / 6;
+    attributes.DrainRate = difficulty.HPDrainRate;
+    return attributes;
+}
+
+// OsuDifficultyCalculator.CreateDifficultyAttributes, from map_attributes
+inline DifficultyAttributes difficulty_attributes(DifficultyAttributes attributes, const SkillValues& skills, double flashlightValue, Mods mods)
+{
+    double aimRating = std::sqrt(skills.aim) * difficulty_multiplier;
+    double aimRatingNoSliders = std::sqrt(skills.aim_no_sliders) * difficulty_multiplier;
+    double speedRating = std::sqrt(skills.speed) * difficulty_multiplier;
+    bool flashlight = has_mod(mods, Mods::Flashlight);
+    double flashlightRating = flashlight ? std::sqrt(flashlightValue) * difficulty_multiplier : 0;
+
+    attributes.SliderFactor = aimRating > 0 ? aimRatingNoSliders / aimRating : 1;
+    attributes.SpeedNoteCount = skills.speed_note_count;
+    attributes.AimDifficultStrainCount = skills.aim_difficult_strain_count;
+    attributes.SpeedDifficultStrainCount = skills.speed_difficult_strain_count;
+
+    if (has_mod(mods, Mods::TouchDevice))
+    {
+        aimRating = std::pow(aimRating, 0.8);
+        flashlightRating = std::pow(flashlightRating, 0.8);
+    }
+    if (has_mod(mods, Mods::Relax))
+    {
+        aimRating *= 0.9;
+        speedRating = 0.0;
+        flashlightRating *= 0.7;
+    }
+    else if (has_mod(mods, Mods::Autopilot))
+    {
+        speedRating *= 0.5;
+        aimRating = 0.0;
+        flashlightRating *= 0.4;
+    }
+
+    double baseAimPerformance = difficulty_to_performance(aimRating);
+    double baseSpeedPerformance = difficulty_to_performance(speedRating);
+    double baseFlashlightPerformance = flashlight ? flashlight_difficulty_to_performance(flashlightRating) : 0;
+
+    double basePerformance = std::pow(std::pow(baseAimPerformance, 1.1) + std::pow(baseSpeedPerformance, 1.1) + std::pow(baseFlashlightPerformance, 1.1), 1.0 / 1.1);
+
+    attributes.StarRating = basePerformance > 0.00001
+        ? std::cbrt(performance_base_multiplier) * 0.027 * (std::cbrt(100000 / std::pow(2, 1 / 1.1) * basePerformance) + 4)
+        : 0;
+    attributes.AimDifficulty = aimRating;
+    attributes.SpeedDifficulty = speedRating;
+    attributes.FlashlightDifficulty = flashlightRating;
+    return attributes;
+}
+
+// The largest section peaks in descending order as they are added. The weights past max_size are below 0.9^400, so
+// the peaks left out don't change weighted_difficulty_sorted at double precision.
+class TopPeaks
+{
+public:
+    static constexpr size_t max_size = 400;
+
+    void insert(double peak)
+    {
+        if (!(peak > 0) || (peaks_.size() == max_size && peak <= peaks_.back()))
+            return;
+        peaks_.insert(std::upper_bound(peaks_.begin(), peaks_.end(), peak, std::greater<>()), peak);
+        if (peaks_.size() > max_size)
+            peaks_.pop_back();
+    }
+
+    // weighted_difficulty of the peaks and one more
+    double weighted_difficulty(double peak, int reducedSectionCount)
+    {
+        scratch_ = peaks_;
+        if (peak > 0)
+            scratch_.insert(std::upper_bound(scratch_.begin(), scratch_.end(), peak, std::greater<>()), peak);
+        return weighted_difficulty_sorted(scratch_, reducedSectionCount);
+    }
+
+private:
+    std::vector<double> peaks_;
+    std::vector<double> scratch_;
+};
+
+// A skill whose difficulty value is kept after every object, in a bounded amount of work per object. A negative
+// reduced section count sums the peaks instead, as Flashlight does.
+class IncrementalSkill
+{
+public:
+    IncrementalSkill(double skillMultiplier, double decayBase, int reducedSectionCount)
+        : strains_(skillMultiplier, decayBase), reduced_section_count_(reducedSectionCount) {}
+
+    void add(double startTime, double step, double difficulty, double factor = 1)
+    {
+        strains_.add(startTime, step, difficulty, factor);
+        const auto& finished = strains_.finished_peaks();
+        for (; added_peaks_ < finished.size(); ++added_peaks_)
+        {
+            top_.insert(finished[added_peaks_]);
+            peak_sum_ += finished[added_peaks_];
+        }
+        values_.push_back(reduced_section_count_ < 0 ? peak_sum_ + strains_.section_peak()
+                                                     : top_.weighted_difficulty(strains_.section_peak(), reduced_section_count_));
+    }
+
+    // the difficulty value after each object
+    const std::vector<double>& values() const { return values_; }
+    const std::vector<double>& object_strains() const { return strains_.object_strains(); }
+
+private:
+    StrainAccumulator strains_;
+    int reduced_section_count_;
+    TopPeaks top_;
+    size_t added_peaks_ = 0;
+    double peak_sum_ = 0;
+    std::vector<double> values_;
+};
+
+}
+
+// Difficulty of hit objects that already have mods (including the rate) and stacking applied, e.g. by apply_mods,
+// following lazer's OsuDifficultyCalculator. difficulty is the mod-adjusted one.
+inline DifficultyAttributes calculate_difficulty(std::span<const HitObject> hitObjects, const MapDifficultyAttributes& difficulty, Mods mods)
+{
+    if (hitObjects.empty())
+        return {};
+
+    double clockRate = mod_rate(mods);
+    auto d = detail::difficulty_geometry(hitObjects, difficulty);
+    detail::set_rate(d, difficulty, 1, clockRate);
+
+    double flashlightValue = has_mod(mods, Mods::Flashlight) ? detail::flashlight_value(d, has_mod(mods, Mods::Hidden)) : 0;
+    return detail::difficulty_attributes(detail::map_attributes(hitObjects, difficulty, clockRate), detail::skill_values(d), flashlightValue, mods);
+}
+
+// Difficulty of an unstacked beatmap (as parsed) for each of several mod combinations. The work they have in common
+// is shared: stacking and geometry per HR/EZ combination, and strains per rate on top of that.
+inline std::vector<DifficultyAttributes> calculate_difficulty(const Beatmap& beatmap, std::span<const Mods> modCombinations)
+{
+    constexpr Mods geometry_mods = Mods::HardRock | Mods::Easy;
+
+    std::vector<DifficultyAttributes> results(modCombinations.size());
+    if (beatmap.hit_objects.empty())
+        return results;
+
+    std::vector<bool> done(modCombinations.size());
+    std::vector<HitObject> hitObjects(beatmap.hit_objects.size());
+
+    for (size_t i = 0; i < modCombinations.size(); ++i)
+    {
+        if (done[i])
+            continue;
+
+        // unscaled times, the rate is applied to the difficulty objects
+        Mods geometry = modCombinations[i] & geometry_mods;
+        auto difficulty = apply_mods(beatmap, geometry, hitObjects);
+        const auto d = detail::difficulty_geometry(hitObjects, difficulty);
+
+        for (size_t j = i; j < modCombinations.size(); ++j)
+        {
+            if (done[j] || (modCombinations[j] & geometry_mods) != geometry)
+                continue;
+
+            double rate = mod_rate(modCombinations[j]);
+            auto timed = d;
+            detail::set_rate(timed, difficulty, rate, rate);
+            auto skills = detail::skill_values(timed);
+            auto attributes = detail::map_attributes(hitObjects, difficulty, rate);
+
+            std::optional<double> flashlight[2];
+            for (size_t k = j; k < modCombinations.size(); ++k)
+            {
+                Mods mods = modCombinations[k];
+                if (done[k] || (mods & geometry_mods) != geometry || mod_rate(mods) != rate)
+                    continue;
+
+                bool hidden = has_mod(mods, Mods::Hidden);
+                if (has_mod(mods, Mods::Flashlight) && !flashlight[hidden])
+                    flashlight[hidden] = detail::flashlight_value(timed, hidden);
+
+                results[k] = detail::difficulty_attributes(attributes, skills, flashlight[hidden].value_or(0), mods);
+                done[k] = true;
+            }
+        }
+    }
+    return results;
+}
+
+// Difficulty of an unstacked beatmap (as parsed) with mods.
+inline DifficultyAttributes calculate_difficulty(const Beatmap& beatmap, Mods mods = Mods::None)
+{
+    return calculate_difficulty(beatmap, std::span(&mods, 1))[0];
+}
+
+// Difficulty of every prefix of a map, for the star rating and performance so far during play. Hit object events are
+// pushed in order with mods and stacking applied, as for calculate_difficulty of a span, and each hit object costs a
+// bounded amount of work. attributes(n) are those of the first n hit objects as in lazer's timed attributes, where the
+// speed of an object takes the one after it into account, so they are available once hit object n + 1 is complete.
+// A query is not bounded the same way: the difficult strain counts and the speed note count weigh every strain of the
+// prefix against its difficulty or maximum strain, which change with the prefix, so attributes(n) costs O(n), about
+// 60us at 2000 objects in a Release build. Everything else is kept per object and read in O(1).
+class DifficultyTimeline
+{
+public:
+    DifficultyTimeline(const MapDifficultyAttributes& difficulty, Mods mods)
+        : mods_(mods)
+        , base_(detail::map_attributes({}, difficulty, mod_rate(mods)))
+        , aim_(detail::aim_skill_multiplier, detail::aim_decay_base, detail::aim_reduced_section_count)
+        , aim_no_sliders_(detail::aim_skill_multiplier, detail::aim_decay_base, detail::aim_reduced_section_count)
+        , speed_(detail::speed_skill_multiplier, detail::speed_decay_base, detail::speed_reduced_section_count)
+        , flashlight_(detail::flashlight_skill_multiplier, detail::flashlight_decay_base, -1)
+    {
+        d_.radius = detail::difficulty_radius(difficulty);
+        detail::set_rate_constants(d_, difficulty, 1, mod_rate(mods));
+    }
+
+    // A hit object is complete when the next one starts.
+    void push(const HitObject& hitObject)
+    {
+        if (finished_)
+            throw std::logic_error("DifficultyTimeline: push after finish");
+        if (is_start_event(hitObject.type) && !pending_.empty())
+            complete_object();
+        pending_.push_back(hitObject);
+    }
+    void push(std::span<const HitObject> hitObjects)
+    {
+        for (const auto& h : hitObjects)
+            push(h);
+    }
+
+    // No more hit objects: the last one is complete and has no next one.
+    void finish()
+    {
+        if (finished_)
+            return;
+        if (!pending_.empty())
+            complete_object();
+        if (d_.size() > speed_.values().size())
+            add_speed(d_.size() - 1);
+        finished_ = true;
+    }
+
+    // number of hit objects attributes are available for
+    size_t size() const { return counts_.empty() ? 0 : 1 + speed_.values().size(); }
+
+    // Attributes of the first hitObjectCount hit objects. The strain counts are summed over their strains here, the
+    // rest is kept from when they were pushed.
+    DifficultyAttributes attributes(size_t hitObjectCount) const
+    {
+        if (hitObjectCount == 0)
+            return {};
+        if (hitObjectCount > size())
+            throw std::out_of_range("DifficultyTimeline: attributes of hit objects not evaluated yet");
+
+        auto attributes = base_;
+        const auto& counts = counts_[hitObjectCount - 1];
+        attributes.HitCircleCount = counts.circles;
+        attributes.SliderCount = counts.sliders;
+        attributes.SpinnerCount = counts.spinners;
+        attributes.MaxCombo = counts.combo;
+
+        detail::SkillValues v;
+        double flashlightValue = 0;
+        if (hitObjectCount >= 2)
+        {
+            size_t k = hitObjectCount - 2;
+            auto aimStrains = std::span(aim_.object_strains()).first(k + 1);
+            auto speedStrains = std::span(speed_.object_strains()).first(k + 1);
+
+            v.aim = aim_.values()[k];
+            v.aim_no_sliders = aim_no_sliders_.values()[k];
+            v.speed = speed_.values()[k];
+            v.aim_difficult_strain_count = detail::count_top_weighted_strains(aimStrains, v.aim);
+            v.speed_note_count = detail::relevant_note_count(speedStrains);
+            v.speed_difficult_strain_count = detail::count_top_weighted_strains(speedStrains, v.speed);
+            if (has_mod(mods_, Mods::Flashlight))
+                flashlightValue = flashlight_.values()[k];
+        }
+        return detail::difficulty_attributes(attributes, v, flashlightValue, mods_);
+    }
+    DifficultyAttributes attributes() const { return attributes(size()); }
+
+private:
+    struct Counts
+    {
+        int circles = 0;
+        int sliders = 0;
+        int spinners = 0;
+        int combo = 0;
+    };
+
+    void complete_object()
+    {
+        Counts counts = counts_.empty() ? Counts{} : counts_.back();
+        for (const auto& h : pending_)
+        {
+            counts.circles += h.type == circle;
+            counts.sliders += h.type == slider_head;
+            counts.spinners += h.type == spinner_start;
+            counts.combo += h.type != slider_legacy_last_tick && h.type != spinner_end;
+        }
+        counts_.push_back(counts);
+
+        d_.objects.push_back(detail::difficulty_object(pending_, d_.radius, movements_));
+        pending_.clear();
+        if (d_.objects.size() < 2)
+            return;
+
+        detail::append_geometry(d_);
+        detail::append_timing(d_);
+        rhythm_.update(d_);
+
+        size_t k = d_.size() - 1;
+        aim_.add(d_.start_time[k], d_.delta_time[k], detail::aim_at(d_, k, true));
+        aim_no_sliders_.add(d_.start_time[k], d_.delta_time[k], detail::aim_at(d_, k, false));
+        if (has_mod(mods_, Mods::Flashlight))
+            flashlight_.add(d_.start_time[k], d_.delta_time[k], detail::flashlight_at(d_, k, has_mod(mods_, Mods::Hidden)));
+        // the previous object now has the delta time after it
+        if (k > 0)
+            add_speed(k - 1);
+    }
+
+    void add_speed(size_t k)
+    {
+        speed_.add(d_.start_time[k], d_.strain_time[k], detail::speed_at(d_, k), detail::rhythm_at(d_, k, rhythm_));
+    }
+
+    Mods mods_;
+    DifficultyAttributes base_;
+    detail::DifficultyObjects d_;
+    detail::RhythmPairs rhythm_;
+    detail::IncrementalSkill aim_;
+    detail::IncrementalSkill aim_no_sliders_;
+    detail::IncrementalSkill speed_;
+    detail::IncrementalSkill flashlight_;
+    // of every complete hit object and the ones before it
+    std::vector<Counts> counts_;
+    std::vector<HitObject> pending_;
+    std::vector<const HitObject*> movements_;
+    bool finished_ = false;
+};
+
+}
@@ -0,0 +1,346 @@
+#pragma once
+
+#include "mods.hpp"
+#include "performance.hpp"
+#include "replay.hpp"
+#include "types.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <numbers>
+#include <span>
+#include <vector>
+
+namespace cpposu {
+
+// Result of a hit object, as in lazer's HitResult for osu!standard: miss, 50, 100, 300.
+enum class HitResult : uint8_t
+{
+    Miss,
+    Meh,
+    Ok,
+    Great,
+};
+
+// What judging needs from the map and mods. Windows are in ms either side of the hit object's time, in the rate's
+// time like the hit objects.
+struct JudgementSettings
+{
+    double radius = 0;
+    double window_great = 0;
+    double window_ok = 0;
+    double window_meh = 0;
+    // presses earlier than this don't hit anything
+    double window_miss = 400;
+    double spins_per_second = 0;
+    // replay frames are in the map's time, the hit objects in the rate's
+    double rate = 1;
+};
+
+// Settings for hit objects with mods applied; difficulty is the mod-adjusted one (HR/EZ, not the rate).
+inline JudgementSettings judgement_settings(const MapDifficultyAttributes& difficulty, Mods mods)
+{
+    JudgementSettings s;
+    s.rate = mod_rate(mods);
+    s.radius = 64 * (1.0f - 0.7f * (difficulty.CircleSize - 5) / 5) / 2;
+    // the windows are in the map's time, so they shrink with the rate as the hit objects' times do
+    s.window_great = difficulty_range(difficulty.OverallDifficulty, 80, 50, 20) / s.rate;
+    s.window_ok = difficulty_range(difficulty.OverallDifficulty, 140, 100, 60) / s.rate;
+    s.window_meh = difficulty_range(difficulty.OverallDifficulty, 200, 150, 100) / s.rate;
+    s.window_miss /= s.rate;
+    s.spins_per_second = difficulty_range(difficulty.OverallDifficulty, 1.5, 2.5, 3.75);
+    return s;
+}
+
+// Judgements of one replay.
+struct Judgements
+{
+    // per hit object, in the order of their start events
+    std::vector<HitResult> result;
+    // ms from the hit object's time to the press that hit it, in the rate's time; NaN if no press hit it
+    std::vector<float> hit_error;
+    // per hit object event: 1 for slider ticks, repeats and legacy last ticks that were followed
+    std::vector<uint8_t> tracked;
+    int max_combo = 0;
+    // ticks and repeats that weren't followed
+    int large_tick_misses = 0;
+    // legacy last ticks that were followed
+    int slider_tail_hits = 0;
+
+    size_t size() const { return result.size(); }
+    int count(HitResult r) const { return (int) std::count(result.begin(), result.end(), r); }
+
+    // Statistics for calculate_performance, with classic slider accuracy as stable replays have.
+    ScoreStatistics statistics() const
+    {
+        ScoreStatistics s;
+        s.MaxCombo = max_combo;
+        s.CountGreat = count(HitResult::Great);
+        s.CountOk = count(HitResult::Ok);
+        s.CountMeh = count(HitResult::Meh);
+        s.CountMiss = count(HitResult::Miss);
+        return s;
+    }
+};
+
+// Judges replays against hit objects with stacking and mods applied, as stable roughly does:
+// - a new key press hits the earliest unjudged circle or slider head if the cursor is on it and it is within the miss
+//   window; a press on anything else does nothing (note lock), and objects not hit in time are missed
+// - slider ticks, repeats and the legacy last tick are followed if a key is held and the cursor is within the follow
+//   circle at their time; the slider's result is the fraction of its head and those that were hit
+// - spinners count the cursor's rotation around their centre while a key is held against the spins required
+// The replay is walked together with the hit objects (per kind) instead of searched per object. The cursor and keys
+// at a time are those of the last frame at or before it.
+class ReplayJudge
+{
+public:
+    static constexpr double follow_radius_multiplier = 2.4;
+
+    ReplayJudge(std::vector<HitObject> hitObjects, const JudgementSettings& settings):
+        hit_objects_(std::move(hitObjects)),
+        settings_(settings)
+    {
+        for (uint32_t i = 0; i < hit_objects_.size(); ++i)
+        {
+            auto type = hit_objects_[i].type;
+            if (is_start_event(type))
+                object_events_.push_back(i);
+            if (type == circle || type == slider_head)
+                heads_.push_back(object_events_.size() - 1);
+            else if (type == spinner_start)
+                spinners_.push_back(object_events_.size() - 1);
+            else if (type == slider_tick || type == slider_repeat || type == slider_legacy_last_tick)
+                checks_.push_back(i);
+        }
+        auto byTime = [&](auto event) { return [&, event](uint32_t a, uint32_t b) { return hit_objects_[event(a)].time < hit_objects_[event(b)].time; }; };
+        auto objectEvent = [&](uint32_t o) { return object_events_[o]; };
+        std::stable_sort(heads_.begin(), heads_.end(), byTime(objectEvent));
+        std::stable_sort(spinners_.begin(), spinners_.end(), byTime(objectEvent));
+        // ticks of overlapping sliders interleave
+        std::stable_sort(checks_.begin(), checks_.end(), byTime([](uint32_t e) { return e; }));
+    }
+
+    // Applies mods to an unstacked beatmap for judging its replays.
+    ReplayJudge(const Beatmap& beatmap, Mods mods):
+        ReplayJudge(modded_hit_objects(beatmap, mods), judgement_settings(adjust_difficulty(beatmap.difficulty_attributes, mods), mods))
+    {}
+
+    // mods that change what a replay is judged against
+    static constexpr Mods judged_mods = Mods::HardRock | Mods::Easy | Mods::DoubleTime | Mods::Nightcore | Mods::HalfTime;
+
+    std::span<const HitObject> hit_objects() const { return hit_objects_; }
+    const JudgementSettings& settings() const { return settings_; }
+    size_t object_count() const { return object_events_.size(); }
+
+    Judgements judge(const ReplayFrames& frames) const
+    {
+        Judgements j;
+        j.result.assign(object_events_.size(), HitResult::Miss);
+        j.hit_error.assign(object_events_.size(), NAN);
+        j.tracked.assign(hit_objects_.size(), 0);
+
+        judge_presses(frames, j);
+        judge_nested(frames, j);
+        judge_spinners(frames, j);
+        count_combo(j);
+        return j;
+    }
+
+private:
+    static constexpr uint32_t buttons = (uint32_t) ReplayKeys::M1 | (uint32_t) ReplayKeys::M2;
+
+    static std::vector<HitObject> modded_hit_objects(const Beatmap& beatmap, Mods mods)
+    {
+        std::vector<HitObject> hitObjects(beatmap.hit_objects.size());
+        apply_mods(beatmap, mods, hitObjects);
+        return hitObjects;
+    }
+
+    double frame_time(const ReplayFrames& frames, size_t f) const { return frames.time[f] / settings_.rate; }
+    Vector2 cursor(const ReplayFrames& frames, size_t f) const { return {frames.x[f], frames.y[f]}; }
+    const HitObject& object(size_t o) const { return hit_objects_[object_events_[o]]; }
+
+    void judge_presses(const ReplayFrames& frames, Judgements& j) const
+    {
+        const auto& s = settings_;
+        size_t next = 0;
+        uint32_t held = 0;
+        for (size_t f = 0; f < frames.size() && next < heads_.size(); ++f)
+        {
+            double time = frame_time(frames, f);
+            while (next < heads_.size() && time > object(heads_[next]).time + s.window_meh)
+                ++next;
+
+            uint32_t pressed = frames.keys[f] & buttons;
+            int presses = std::popcount(pressed & ~held);
+            held = pressed;
+
+            for (; presses > 0 && next < heads_.size(); --presses)
+            {
+                const auto& h = object(heads_[next]);
+                if (time < h.time - s.window_miss || (cursor(frames, f) - h.position()).length() > s.radius)
+                    break;
+
+                double error = time - h.time;
+                double e = std::abs(error);
+                auto result = e <= s.window_great ? HitResult::Great : e <= s.window_ok ? HitResult::Ok : e <= s.window_meh ? HitResult::Meh : HitResult::Miss;
+                j.result[heads_[next]] = result;
+                if (result != HitResult::Miss)
+                    j.hit_error[heads_[next]] = (float) error;
+                ++next;
+            }
+        }
+    }
+
+    void judge_nested(const ReplayFrames& frames, Judgements& j) const
+    {
+        const double followRadius = settings_.radius * follow_radius_multiplier;
+        size_t f = 0;
+        for (uint32_t e : checks_)
+        {
+            const auto& check = hit_objects_[e];
+            while (f + 1 < frames.size() && frame_time(frames, f + 1) <= check.time)
+                ++f;
+            if (f >= frames.size() || frame_time(frames, f) > check.time)
+                continue;
+            j.tracked[e] = (frames.keys[f] & buttons) && (cursor(frames, f) - check.position()).length() <= followRadius;
+        }
+
+        // stable's slider result from the fraction of its parts that were hit
+        for (uint32_t o : heads_)
+        {
+            uint32_t begin = object_events_[o];
+            if (hit_objects_[begin].type != slider_head)
+                continue;
+            int parts = 1;
+            int hits = j.result[o] != HitResult::Miss;
+            for (uint32_t e = begin + 1; e < hit_objects_.size() && !is_start_event(hit_objects_[e].type); ++e)
+            {
+                auto type = hit_objects_[e].type;
+                if (type == slider_tick || type == slider_repeat || type == slider_legacy_last_tick)
+                {
+                    ++parts;
+                    hits += j.tracked[e];
+                }
+            }
+            j.result[o] = hits == parts ? HitResult::Great : hits * 2 >= parts ? HitResult::Ok : hits > 0 ? HitResult::Meh : HitResult::Miss;
+        }
+    }
+
+    void judge_spinners(const ReplayFrames& frames, Judgements& j) const
+    {
+        size_t first = 0;
+        for (uint32_t o : spinners_)
+        {
+            uint32_t begin = object_events_[o];
+            const auto& start = hit_objects_[begin];
+            double end = start.time;
+            if (begin + 1 < hit_objects_.size() && hit_objects_[begin + 1].type == spinner_end)
+                end = hit_objects_[begin + 1].time;
+
+            while (first < frames.size() && frame_time(frames, first) < start.time)
+                ++first;
+
+            double rotation = 0;
+            bool tracking = false;
+            double lastAngle = 0;
+            for (size_t f = first; f < frames.size() && frame_time(frames, f) <= end; ++f)
+            {
+                if (!(frames.keys[f] & buttons))
+                {
+                    tracking = false;
+                    continue;
+                }
+                Vector2 d = cursor(frames, f) - start.position();
+                double angle = std::atan2(d.Y, d.X);
+                if (tracking)
+                {
+                    double delta = angle - lastAngle;
+                    if (delta > std::numbers::pi)
+                        delta -= 2 * std::numbers::pi;
+                    else if (delta < -std::numbers::pi)
+                        delta += 2 * std::numbers::pi;
+                    rotation += std::abs(delta);
+                }
+                lastAngle = angle;
+                tracking = true;
+            }
+
+            // lazer's Spinner.SpinsRequired and judgement thresholds, over the duration in the map's time
+            int required = (int) ((end - start.time) * settings_.rate / 1000 * settings_.spins_per_second);
+            double progress = required > 0 ? rotation / (2 * std::numbers::pi) / required : 1;
+            j.result[o] = progress >= 1 ? HitResult::Great : progress > 0.9 ? HitResult::Ok : progress > 0.75 ? HitResult::Meh : HitResult::Miss;
+        }
+    }
+
+    // in hit object order: missed circles, heads, ticks and repeats break combo, a missed slider end doesn't
+    void count_combo(Judgements& j) const
+    {
+        int combo = 0;
+        auto add = [&](bool hit) {
+            combo = hit ? combo + 1 : 0;
+            j.max_combo = std::max(j.max_combo, combo);
+        };
+        for (uint32_t o = 0; o < object_events_.size(); ++o)
+        {
+            uint32_t begin = object_events_[o];
+            auto type = hit_objects_[begin].type;
+            if (type != slider_head)
+            {
+                add(j.result[o] != HitResult::Miss);
+                continue;
+            }
+            add(!std::isnan(j.hit_error[o]));
+            for (uint32_t e = begin + 1; e < hit_objects_.size() && !is_start_event(hit_objects_[e].type); ++e)
+            {
+                auto nested = hit_objects_[e].type;
+                if (nested == slider_tick || nested == slider_repeat)
+                {
+                    add(j.tracked[e]);
+                    j.large_tick_misses += !j.tracked[e];
+                }
+                else if (nested == slider_legacy_last_tick && j.tracked[e])
+                {
+                    add(true);
+                    ++j.slider_tail_hits;
+                }
+            }
+        }
+    }
+
+    std::vector<HitObject> hit_objects_;
+    JudgementSettings settings_;
+    // start event of each hit object
+    std::vector<uint32_t> object_events_;
+    // circles and slider heads, spinners (as hit objects) and slider checks (as events), each by time
+    std::vector<uint32_t> heads_;
+    std::vector<uint32_t> spinners_;
+    std::vector<uint32_t> checks_;
+};
+
+// Judges replays of an unstacked beatmap (as parsed), each with its own mods. The modded map and its preparation
+// are shared by replays whose mods judge the same.
+inline std::vector<Judgements> judge_replays(const Beatmap& beatmap, std::span<const Replay> replays)
+{
+    std::vector<Judgements> results(replays.size());
+    std::vector<bool> done(replays.size());
+    for (size_t i = 0; i < replays.size(); ++i)
+    {
+        if (done[i])
+            continue;
+        Mods mods = replays[i].mods & ReplayJudge::judged_mods;
+        ReplayJudge judge(beatmap, mods);
+        for (size_t k = i; k < replays.size(); ++k)
+        {
+            if (done[k] || (replays[k].mods & ReplayJudge::judged_mods) != mods)
+                continue;
+            results[k] = judge.judge(replays[k].frames);
+            done[k] = true;
+        }
+    }
+    return results;
+}
+
+}
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cpposu/stats.hpp>
+
 #include <iostream>
 #include <fstream>
 #include <stdexcept>
@@ -7,17 +9,42 @@
 #include <sstream>
 #include <charconv>
 #include <optional>
+#include <memory>
 
 namespace cpposu {
 
-#define CPPOSU_RAISE_PARSE_ERROR(args...) do { \
+// location is a string_view into the current line (or empty) giving the error column
+#define CPPOSU_RAISE_PARSE_ERROR(code, location, args...) do { \
         std::ostringstream ss; ss << "Parse error in " << filename_ << " line " << line_number_ << ": " << args; \
-        throw parse_error(ss.str()); \
+        throw parse_error(ss.str(), parse_error_code::code, line_number_, error_column(location)); \
     } while (0)
 
+enum class parse_error_code : int
+{
+    none,
+    file_open,
+    invalid_header,
+    expected_section,
+    invalid_number,
+    missing_delimiter,
+    invalid_slider_type,
+    truncated_data,
+    invalid_compressed_data,
+};
+
 struct parse_error : std::runtime_error
 {
-    using std::runtime_error::runtime_error;
+    parse_error(const std::string& message, parse_error_code code = parse_error_code::none, size_t line = 0, size_t column = 0):
+        std::runtime_error(message),
+        code(code),
+        line(line),
+        column(column)
+    {}
+
+    parse_error_code code;
+    // 1-based, 0 if unknown
+    size_t line;
+    size_t column;
 };
 
 
@@ -91,7 +118,7 @@ template<typename T>
     if (x)
         result = *x;
 
-    return x;
+    return x.has_value();
 }
 template<typename T=double>
 std::optional<T> try_take_numeric_column(std::string_view& line, char delimiter=',')
@@ -112,12 +139,24 @@ template<typename T=double>
 
 
 
+namespace detail {
+// Read-only stream buffer over memory owned by someone else, so parsing from memory doesn't copy it.
+struct MemoryBuffer : std::streambuf
+{
+    MemoryBuffer(const char* data, size_t size)
+    {
+        char* p = const_cast<char*>(data);
+        setg(p, p, p + size);
+    }
+};
+}
+
 class LineParser
 {
     void init()
     {
         if (!stream_)
-            CPPOSU_RAISE_PARSE_ERROR("Failed to open file");
+            CPPOSU_RAISE_PARSE_ERROR(file_open, std::string_view{}, "Failed to open file");
 
         line_data_.reserve(1024);
     }
@@ -137,8 +176,20 @@ public:
         init();
     }
 
+    // Parses size bytes at data, which must outlive the parser.
+    LineParser(const char* data, size_t size, std::string filename="<memory>"):
+        memory_buffer_(std::make_unique<detail::MemoryBuffer>(data, size)),
+        memory_stream_(std::make_unique<std::istream>(memory_buffer_.get())),
+        stream_(*memory_stream_),
+        filename_(filename)
+    {
+        init();
+    }
+
 
     std::unique_ptr<std::ifstream> fstream_;
+    std::unique_ptr<detail::MemoryBuffer> memory_buffer_;
+    std::unique_ptr<std::istream> memory_stream_;
     std::istream& stream_;
     std::string filename_;
     std::string line_data_;
@@ -163,11 +214,21 @@ public:
         return DebugLocation{line_data_, index};
     }
 
+    // 1-based column of data within the current line, 0 if it isn't in it
+    size_t error_column(const std::string_view& data) const
+    {
+        if (!data.data() || data.data() < line_data_.data() || data.data() > line_data_.data() + line_data_.size())
+            return 0;
+        return data.data() - line_data_.data() + 1;
+    }
+
     std::string_view read_line()
     {
         while (std::getline(stream_, line_data_))
         {
             ++line_number_;
+            CPPOSU_STAT_ADD(lines_read, 1);
+            CPPOSU_STAT_ADD(bytes_scanned, line_data_.size() + 1);
 
             auto line = trim_space(line_data_);
             if (!line.empty())
@@ -187,7 +248,7 @@ public:
         auto result = read_number<T>(line);
         if (result) return *result;
 
-        CPPOSU_RAISE_PARSE_ERROR("failed to read number: " << debug_location(line));
+        CPPOSU_RAISE_PARSE_ERROR(invalid_number, line, "failed to read number: " << debug_location(line));
     }
     template<typename T>
     void read_number_or_throw(T& result, const std::string_view& line)
@@ -199,7 +260,7 @@ public:
     {
         auto column = try_take_column(data, delimiter);
         if (!column)
-            CPPOSU_RAISE_PARSE_ERROR("expected delimiter '" << delimiter << "' at " << debug_location(data));
+            CPPOSU_RAISE_PARSE_ERROR(missing_delimiter, data, "expected delimiter '" << delimiter << "' at " << debug_location(data));
         return *column;
     }
 
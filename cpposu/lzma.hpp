@@ -0,0 +1,431 @@
+#pragma once
+
+#include "line_parser.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cpposu {
+
+namespace detail {
+
+// The LZMA decoder of the LZMA SDK specification (lzma-specification.txt / LzmaSpec.cpp), reading from memory.
+class LzmaDecoder
+{
+    static constexpr uint32_t top_value = 1u << 24;
+    static constexpr int num_bit_model_total_bits = 11;
+    static constexpr int num_move_bits = 5;
+    static constexpr uint16_t initial_probability = (1u << num_bit_model_total_bits) / 2;
+
+    static constexpr int num_states = 12;
+    static constexpr int num_pos_bits_max = 4;
+    static constexpr int num_len_to_pos_states = 4;
+    static constexpr int num_align_bits = 4;
+    static constexpr int start_pos_model_index = 4;
+    static constexpr int end_pos_model_index = 14;
+    static constexpr int num_full_distances = 1 << (end_pos_model_index >> 1);
+    static constexpr int match_min_len = 2;
+    static constexpr size_t initial_window_size = 1 << 16;
+    static constexpr uint64_t max_reserve_ratio = 16;
+
+public:
+    // Header is the 13 bytes of the .lzma format: properties, dictionary size, uncompressed size (all ones if unknown).
+    static constexpr size_t header_size = 13;
+
+    explicit LzmaDecoder(std::string_view data):
+        in_(reinterpret_cast<const uint8_t*>(data.data())),
+        in_end_(in_ + data.size())
+    {
+        if (data.size() < header_size)
+            throw parse_error("Truncated LZMA header", parse_error_code::truncated_data);
+
+        unsigned d = in_[0];
+        if (d >= 9 * 5 * 5)
+            throw parse_error("Invalid LZMA properties", parse_error_code::invalid_compressed_data);
+        lc_ = d % 9;
+        d /= 9;
+        lp_ = d % 5;
+        pb_ = d / 5;
+
+        dictionary_size_ = 0;
+        for (int i = 0; i < 4; ++i)
+            dictionary_size_ |= (uint32_t) in_[1 + i] << (8 * i);
+        dictionary_size_ = std::max<uint32_t>(dictionary_size_, 1u << 12);
+
+        unpack_size_ = 0;
+        unpack_size_defined_ = false;
+        for (int i = 0; i < 8; ++i)
+        {
+            unpack_size_ |= (uint64_t) in_[5 + i] << (8 * i);
+            unpack_size_defined_ |= in_[5 + i] != 0xFF;
+        }
+        in_ += header_size;
+        compressed_size_ = in_end_ - in_;
+    }
+
+    // uncompressed size from the header, if it is known
+    bool unpack_size_defined() const { return unpack_size_defined_; }
+    uint64_t unpack_size() const { return unpack_size_; }
+
+    // How much output to reserve for. The header's size isn't trusted beyond a small multiple of the compressed size,
+    // so a corrupted or crafted header can't make the caller allocate more than the input justifies.
+    size_t reserve_size() const
+    {
+        return unpack_size_defined_ ? std::min<uint64_t>(unpack_size_, compressed_size_ * max_reserve_ratio) : 0;
+    }
+
+    // Decodes the whole stream, passing the output to sink as string_views in order. Only a window of the dictionary
+    // size (or the uncompressed size if that is smaller) is held at once. The window grows as it fills, as neither size
+    // in the header is checked against the data yet.
+    template<typename Sink>
+    void decode(Sink&& sink)
+    {
+        size_t windowSize = dictionary_size_;
+        if (unpack_size_defined_)
+            windowSize = std::max<size_t>(std::min<uint64_t>(windowSize, unpack_size_), 1);
+        window_.resize(std::min(windowSize, initial_window_size));
+        pos_ = flushed_ = 0;
+        window_full_ = false;
+        total_pos_ = 0;
+
+        literal_probs_.assign(0x300u << (lc_ + lp_), initial_probability);
+        std::fill_n(reinterpret_cast<uint16_t*>(&probs_), sizeof(probs_) / sizeof(uint16_t), initial_probability);
+        init_range_decoder();
+
+        auto flush = [&] {
+            if (pos_ > flushed_)
+                sink(std::string_view(reinterpret_cast<const char*>(window_.data()) + flushed_, pos_ - flushed_));
+            flushed_ = pos_;
+        };
+        auto put_byte = [&](uint8_t b) {
+            ++total_pos_;
+            window_[pos_++] = b;
+            // until it is full, the window holds everything decoded so far in order, so it can simply be extended
+            if (pos_ == window_.size() && pos_ < windowSize)
+                window_.resize(std::min(windowSize, pos_ * 2));
+            else if (pos_ == window_.size())
+            {
+                flush();
+                pos_ = flushed_ = 0;
+                window_full_ = true;
+            }
+        };
+
+        uint64_t remaining = unpack_size_;
+        uint32_t rep0 = 0, rep1 = 0, rep2 = 0, rep3 = 0;
+        unsigned state = 0;
+        const unsigned pbMask = (1u << pb_) - 1;
+
+        for (;;)
+        {
+            if (unpack_size_defined_ && remaining == 0 && code_ == 0)
+                break;
+
+            unsigned posState = total_pos_ & pbMask;
+            if (decode_bit(probs_.is_match[(state << num_pos_bits_max) + posState]) == 0)
+            {
+                if (unpack_size_defined_ && remaining == 0)
+                    corrupted();
+                put_byte(decode_literal(state, rep0));
+                state = state < 4 ? 0 : state < 10 ? state - 3 : state - 6;
+                --remaining;
+                continue;
+            }
+
+            unsigned len;
+            if (decode_bit(probs_.is_rep[state]) != 0)
+            {
+                if ((unpack_size_defined_ && remaining == 0) || total_pos_ == 0)
+                    corrupted();
+                if (decode_bit(probs_.is_rep_g0[state]) == 0)
+                {
+                    if (decode_bit(probs_.is_rep0_long[(state << num_pos_bits_max) + posState]) == 0)
+                    {
+                        // short rep: one byte at rep0
+                        state = state < 7 ? 9 : 11;
+                        put_byte(byte_at(rep0 + 1));
+                        --remaining;
+                        continue;
+                    }
+                }
+                else
+                {
+                    uint32_t dist;
+                    if (decode_bit(probs_.is_rep_g1[state]) == 0)
+                        dist = rep1;
+                    else
+                    {
+                        if (decode_bit(probs_.is_rep_g2[state]) == 0)
+                            dist = rep2;
+                        else
+                        {
+                            dist = rep3;
+                            rep3 = rep2;
+                        }
+                        rep2 = rep1;
+                    }
+                    rep1 = rep0;
+                    rep0 = dist;
+                }
+                len = decode_len(probs_.rep_len, posState);
+                state = state < 7 ? 8 : 11;
+            }
+            else
+            {
+                rep3 = rep2;
+                rep2 = rep1;
+                rep1 = rep0;
+                len = decode_len(probs_.len, posState);
+                state = state < 7 ? 7 : 10;
+                rep0 = decode_distance(len);
+                if (rep0 == 0xFFFFFFFF)
+                {
+                    // end marker
+                    if (code_ != 0)
+                        corrupted();
+                    break;
+                }
+                if (unpack_size_defined_ && remaining == 0)
+                    corrupted();
+                if (rep0 >= dictionary_size_ || (rep0 >= pos_ && !window_full_) || rep0 >= window_.size())
+                    corrupted();
+            }
+
+            len += match_min_len;
+            if (unpack_size_defined_ && remaining < len)
+                corrupted();
+            size_t from = rep0 < pos_ ? pos_ - rep0 - 1 : window_.size() - rep0 - 1 + pos_;
+            for (unsigned i = 0; i < len; ++i)
+            {
+                put_byte((uint8_t) window_[from]);
+                if (++from == window_.size())
+                    from = 0;
+            }
+            remaining -= len;
+        }
+        flush();
+    }
+
+private:
+    [[noreturn]] static void corrupted()
+    {
+        throw parse_error("Corrupted LZMA data", parse_error_code::invalid_compressed_data);
+    }
+
+    uint8_t next_byte()
+    {
+        if (in_ == in_end_)
+            throw parse_error("Truncated LZMA data", parse_error_code::truncated_data);
+        return *in_++;
+    }
+
+    void init_range_decoder()
+    {
+        range_ = 0xFFFFFFFF;
+        code_ = 0;
+        if (next_byte() != 0)
+            corrupted();
+        for (int i = 0; i < 4; ++i)
+            code_ = (code_ << 8) | next_byte();
+        if (code_ == range_)
+            corrupted();
+    }
+
+    void normalize()
+    {
+        if (range_ < top_value)
+        {
+            range_ <<= 8;
+            code_ = (code_ << 8) | next_byte();
+        }
+    }
+
+    unsigned decode_bit(uint16_t& prob)
+    {
+        unsigned v = prob;
+        uint32_t bound = (range_ >> num_bit_model_total_bits) * v;
+        unsigned symbol;
+        if (code_ < bound)
+        {
+            v += ((1u << num_bit_model_total_bits) - v) >> num_move_bits;
+            range_ = bound;
+            symbol = 0;
+        }
+        else
+        {
+            v -= v >> num_move_bits;
+            code_ -= bound;
+            range_ -= bound;
+            symbol = 1;
+        }
+        prob = (uint16_t) v;
+        normalize();
+        return symbol;
+    }
+
+    uint32_t decode_direct_bits(unsigned numBits)
+    {
+        uint32_t result = 0;
+        do
+        {
+            range_ >>= 1;
+            code_ -= range_;
+            uint32_t t = 0 - (code_ >> 31);
+            code_ += range_ & t;
+            if (code_ == range_)
+                corrupted();
+            normalize();
+            result = (result << 1) + (t + 1);
+        } while (--numBits);
+        return result;
+    }
+
+    unsigned decode_tree(uint16_t* probs, unsigned numBits)
+    {
+        unsigned m = 1;
+        for (unsigned i = 0; i < numBits; ++i)
+            m = (m << 1) + decode_bit(probs[m]);
+        return m - (1u << numBits);
+    }
+
+    unsigned decode_reverse_tree(uint16_t* probs, unsigned numBits)
+    {
+        unsigned m = 1;
+        unsigned symbol = 0;
+        for (unsigned i = 0; i < numBits; ++i)
+        {
+            unsigned bit = decode_bit(probs[m]);
+            m = (m << 1) + bit;
+            symbol |= bit << i;
+        }
+        return symbol;
+    }
+
+    uint8_t byte_at(uint32_t distance) const
+    {
+        return (uint8_t) window_[distance <= pos_ ? pos_ - distance : window_.size() - distance + pos_];
+    }
+
+    uint8_t decode_literal(unsigned state, uint32_t rep0)
+    {
+        unsigned prevByte = total_pos_ > 0 ? byte_at(1) : 0;
+        unsigned litState = ((total_pos_ & ((1u << lp_) - 1)) << lc_) + (prevByte >> (8 - lc_));
+        uint16_t* probs = &literal_probs_[0x300 * litState];
+
+        unsigned symbol = 1;
+        if (state >= 7)
+        {
+            unsigned matchByte = byte_at(rep0 + 1);
+            do
+            {
+                unsigned matchBit = (matchByte >> 7) & 1;
+                matchByte <<= 1;
+                unsigned bit = decode_bit(probs[((1 + matchBit) << 8) + symbol]);
+                symbol = (symbol << 1) | bit;
+                if (matchBit != bit)
+                    break;
+            } while (symbol < 0x100);
+        }
+        while (symbol < 0x100)
+            symbol = (symbol << 1) | decode_bit(probs[symbol]);
+        return (uint8_t) (symbol - 0x100);
+    }
+
+    // choice, choice 2, then the low and mid trees per position state and the high tree
+    struct LenProbs
+    {
+        uint16_t choice;
+        uint16_t choice2;
+        uint16_t low[1 << num_pos_bits_max][1 << 3];
+        uint16_t mid[1 << num_pos_bits_max][1 << 3];
+        uint16_t high[1 << 8];
+    };
+
+    unsigned decode_len(LenProbs& p, unsigned posState)
+    {
+        if (decode_bit(p.choice) == 0)
+            return decode_tree(p.low[posState], 3);
+        if (decode_bit(p.choice2) == 0)
+            return 8 + decode_tree(p.mid[posState], 3);
+        return 16 + decode_tree(p.high, 8);
+    }
+
+    uint32_t decode_distance(unsigned len)
+    {
+        unsigned lenState = std::min<unsigned>(len, num_len_to_pos_states - 1);
+        unsigned posSlot = decode_tree(probs_.pos_slot[lenState], 6);
+        if (posSlot < 4)
+            return posSlot;
+
+        unsigned numDirectBits = (posSlot >> 1) - 1;
+        uint32_t dist = (2 | (posSlot & 1)) << numDirectBits;
+        if (posSlot < end_pos_model_index)
+            dist += decode_reverse_tree(probs_.pos + dist - posSlot, numDirectBits);
+        else
+        {
+            dist += decode_direct_bits(numDirectBits - num_align_bits) << num_align_bits;
+            dist += decode_reverse_tree(probs_.align, num_align_bits);
+        }
+        return dist;
+    }
+
+    const uint8_t* in_;
+    const uint8_t* in_end_;
+    unsigned lc_, lp_, pb_;
+    uint32_t dictionary_size_;
+    uint64_t unpack_size_;
+    bool unpack_size_defined_;
+    size_t compressed_size_;
+
+    uint32_t range_ = 0;
+    uint32_t code_ = 0;
+
+    // char8_t rather than char, which could alias the decoder state and keep the compiler from holding it in registers
+    std::vector<char8_t> window_;
+    size_t pos_ = 0;
+    size_t flushed_ = 0;
+    bool window_full_ = false;
+    uint64_t total_pos_ = 0;
+
+    std::vector<uint16_t> literal_probs_;
+    // every other probability, only uint16_t so they can be reset at once
+    struct
+    {
+        uint16_t is_match[num_states << num_pos_bits_max];
+        uint16_t is_rep[num_states];
+        uint16_t is_rep_g0[num_states];
+        uint16_t is_rep_g1[num_states];
+        uint16_t is_rep_g2[num_states];
+        uint16_t is_rep0_long[num_states << num_pos_bits_max];
+        uint16_t pos_slot[num_len_to_pos_states][1 << 6];
+        uint16_t pos[1 + num_full_distances - end_pos_model_index];
+        uint16_t align[1 << num_align_bits];
+        LenProbs len;
+        LenProbs rep_len;
+    } probs_;
+};
+
+}
+
+// Decodes data in the .lzma format (as 7-Zip's LZMA SDK writes it, and osu! replays use), passing the output to sink
+// as string_views in order, so that it doesn't have to be held in memory at once. Throws parse_error on truncated or
+// corrupted data.
+template<typename Sink>
+void lzma_decode(std::string_view data, Sink&& sink)
+{
+    detail::LzmaDecoder(data).decode(sink);
+}
+
+inline std::string lzma_decode(std::string_view data)
+{
+    std::string result;
+    detail::LzmaDecoder decoder(data);
+    result.reserve(decoder.reserve_size());
+    decoder.decode([&](std::string_view chunk) { result.append(chunk); });
+    return result;
+}
+
+}
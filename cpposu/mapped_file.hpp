@@ -0,0 +1,100 @@
+#pragma once
+
+#include "line_parser.hpp"
+
+#include <string>
+#include <string_view>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace cpposu {
+
+// A whole file mapped read-only into memory, so it can be parsed without reading it into a buffer first.
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::string& filename)
+    {
+#ifdef _WIN32
+        HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            throw parse_error("Failed to open file " + filename, parse_error_code::file_open);
+        LARGE_INTEGER size;
+        bool ok = GetFileSizeEx(file, &size);
+        if (ok && size.QuadPart > 0)
+        {
+            HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            data_ = mapping ? static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+            ok = data_ != nullptr;
+            size_ = size.QuadPart;
+            if (mapping)
+                CloseHandle(mapping);
+        }
+        CloseHandle(file);
+#else
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw parse_error("Failed to open file " + filename, parse_error_code::file_open);
+        struct stat st;
+        bool ok = ::fstat(fd, &st) == 0;
+        if (ok && st.st_size > 0)
+        {
+            void* p = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            ok = p != MAP_FAILED;
+            if (ok)
+            {
+                ::madvise(p, st.st_size, MADV_SEQUENTIAL);
+                data_ = static_cast<const char*>(p);
+                size_ = st.st_size;
+            }
+        }
+        ::close(fd);
+#endif
+        if (!ok)
+            throw parse_error("Failed to map file " + filename, parse_error_code::file_open);
+    }
+
+    MappedFile(MappedFile&& other) noexcept:
+        data_(std::exchange(other.data_, nullptr)),
+        size_(std::exchange(other.size_, 0))
+    {}
+    MappedFile& operator=(MappedFile&& other) noexcept
+    {
+        std::swap(data_, other.data_);
+        std::swap(size_, other.size_);
+        return *this;
+    }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile()
+    {
+        if (!data_)
+            return;
+#ifdef _WIN32
+        UnmapViewOfFile(data_);
+#else
+        ::munmap(const_cast<char*>(data_), size_);
+#endif
+    }
+
+    std::string_view data() const { return {data_, size_}; }
+    size_t size() const { return size_; }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+}
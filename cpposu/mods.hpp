@@ -3,8 +3,68 @@
 #include "types.hpp"
 #include "stacking.hpp"
 
+#include <memory>
+#include <stdexcept>
+
 namespace cpposu {
 
+// Bit values as in osu! replays and scores.
+enum class Mods : uint32_t
+{
+    None = 0,
+    NoFail = 1 << 0,
+    Easy = 1 << 1,
+    TouchDevice = 1 << 2,
+    Hidden = 1 << 3,
+    HardRock = 1 << 4,
+    SuddenDeath = 1 << 5,
+    DoubleTime = 1 << 6,
+    Relax = 1 << 7,
+    HalfTime = 1 << 8,
+    Nightcore = 1 << 9, // set together with DoubleTime
+    Flashlight = 1 << 10,
+    Autoplay = 1 << 11,
+    SpunOut = 1 << 12,
+    Autopilot = 1 << 13,
+    Perfect = 1 << 14,
+};
+
+constexpr Mods operator|(Mods a, Mods b) { return Mods((uint32_t)a | (uint32_t)b); }
+constexpr Mods operator&(Mods a, Mods b) { return Mods((uint32_t)a & (uint32_t)b); }
+constexpr bool has_mod(Mods mods, Mods mod) { return (mods & mod) != Mods::None; }
+
+// Playback rate of the speed changing mods.
+constexpr double mod_rate(Mods mods)
+{
+    if (has_mod(mods, Mods::DoubleTime | Mods::Nightcore))
+        return 1.5;
+    if (has_mod(mods, Mods::HalfTime))
+        return 0.75;
+    return 1;
+}
+
+// based on OsuModHardRock.cs / OsuModEasy.cs: ApplyToDifficulty
+inline MapDifficultyAttributes adjust_difficulty(MapDifficultyAttributes difficulty, Mods mods)
+{
+    if (has_mod(mods, Mods::HardRock))
+    {
+        difficulty.CircleSize = std::min(difficulty.CircleSize * 1.3f, 10.0f);
+
+        const float ratio = 1.4f;
+        difficulty.ApproachRate = std::min(difficulty.ApproachRate * ratio, 10.0f);
+        difficulty.HPDrainRate = std::min(difficulty.HPDrainRate * ratio, 10.0f);
+        difficulty.OverallDifficulty = std::min(difficulty.OverallDifficulty * ratio, 10.0f);
+    }
+    if (has_mod(mods, Mods::Easy))
+    {
+        const float ratio = 0.5f;
+        difficulty.CircleSize *= ratio;
+        difficulty.ApproachRate *= ratio;
+        difficulty.HPDrainRate *= ratio;
+        difficulty.OverallDifficulty *= ratio;
+    }
+    return difficulty;
+}
 
 inline void apply_timescale(std::span<HitObject> hitObjects, double scale)
 {
@@ -30,4 +90,145 @@ inline void flip_vertical(std::span<HitObject> hitObjects)
         obj.y = 384 - obj.y;
     }
 }
+
+// Stack heights with mods. Lazer stacks the HR-flipped positions in unscaled time, but mirroring the playfield
+// doesn't change the distances stacking compares, so the unflipped positions stack the same.
+inline std::vector<int> mod_stack_heights(std::span<const HitObject> hitObjects, const StackingParameters& parameters)
+{
+    return calculate_stack_heights(hitObjects, parameters.version, parameters.time_threshold, parameters.distance_threshold);
+}
+
+namespace detail {
+
+// The per-event part of applying mods: the HR flip, the stack offset and the time scale, in one pass. output may be
+// the same span as input. offset is the stack offset carried into input, if it starts after the start of an object.
+inline void transform_hit_objects(std::span<const HitObject> input, std::span<HitObject> output, std::span<const int> stackHeights,
+    float stackOffset, Mods mods, float offset = 0)
+{
+    const bool flip = has_mod(mods, Mods::HardRock);
+    const double timeScale = 1 / mod_rate(mods);
+    for (size_t i = 0; i < input.size(); ++i)
+    {
+        HitObject h = input[i];
+        if (is_start_event(h.type))
+            offset = stackHeights[i] * stackOffset;
+        h.x += offset;
+        if (flip)
+            h.y = (384 - h.y) + offset;
+        else
+            h.y += offset;
+        h.time *= timeScale;
+        output[i] = h;
+    }
+}
+
+}
+
+// Applies mods to an unstacked beatmap: difficulty changes, stacking, the HR flip and the time scale of speed mods.
+// That is the stacking pass for the stack heights, then one pass over the hit objects that applies the flip, the stack
+// offsets and the time scale together.
+inline void apply_mods(Beatmap& b, Mods mods)
+{
+    b.difficulty_attributes = adjust_difficulty(b.difficulty_attributes, mods);
+
+    auto parameters = stacking_parameters(b);
+    auto stackHeights = mod_stack_heights(b.hit_objects, parameters);
+    detail::transform_hit_objects(b.hit_objects, b.hit_objects, stackHeights, parameters.stack_offset, mods);
+}
+
+// Non-mutating apply_mods: writes the modded hit objects of an unstacked beatmap to output, which must have the same
+// size, and returns the modded difficulty attributes.
+inline MapDifficultyAttributes apply_mods(const Beatmap& b, Mods mods, std::span<HitObject> output)
+{
+    if (output.size() != b.hit_objects.size())
+        throw std::invalid_argument("apply_mods output size differs from the beatmap's hit objects");
+
+    auto difficulty = adjust_difficulty(b.difficulty_attributes, mods);
+    auto parameters = stacking_parameters(b.version, difficulty, b.info.StackLeniency);
+    auto stackHeights = mod_stack_heights(b.hit_objects, parameters);
+    detail::transform_hit_objects(b.hit_objects, output, stackHeights, parameters.stack_offset, mods);
+    return difficulty;
+}
+
+// Read-only view of an unstacked beatmap's hit objects with mods applied on access, without copying the beatmap.
+// Stack heights are computed once per view and shared with views derived through with_mods when they stack the same.
+// The beatmap must outlive the view and its derived views.
+class TransformedView
+{
+public:
+    TransformedView(const Beatmap& b, Mods mods):
+        beatmap_(&b),
+        mods_(mods),
+        difficulty_(adjust_difficulty(b.difficulty_attributes, mods))
+    {
+        auto parameters = stacking_parameters(b.version, difficulty_, b.info.StackLeniency);
+        stack_offset_ = parameters.stack_offset;
+
+        stack_heights_ = std::make_shared<const std::vector<int>>(mod_stack_heights(b.hit_objects, parameters));
+    }
+
+    // A view of the same beatmap with other mods, sharing the stack heights if those mods stack the same (only HR
+    // and EZ change stacking).
+    TransformedView with_mods(Mods mods) const
+    {
+        constexpr Mods stacking_mods = Mods::HardRock | Mods::Easy;
+        if ((mods & stacking_mods) != (mods_ & stacking_mods))
+            return TransformedView(*beatmap_, mods);
+
+        TransformedView view(*this);
+        view.mods_ = mods;
+        view.difficulty_ = adjust_difficulty(beatmap_->difficulty_attributes, mods);
+        return view;
+    }
+
+    size_t size() const { return beatmap_->hit_objects.size(); }
+    Mods mods() const { return mods_; }
+    const MapDifficultyAttributes& difficulty_attributes() const { return difficulty_; }
+    float stack_offset() const { return stack_offset_; }
+    // per event, nonzero only on start events
+    std::span<const int> stack_heights() const { return *stack_heights_; }
+
+    // Events after the start of an object look back to it for the stack height, so access to a slider's later events
+    // costs a few steps; read chunks to transform runs of events.
+    HitObject operator[](size_t i) const
+    {
+        HitObject h = beatmap_->hit_objects[i];
+        float offset = object_offset(i);
+        h.x += offset;
+        if (has_mod(mods_, Mods::HardRock))
+            h.y = (384 - h.y) + offset;
+        else
+            h.y += offset;
+        h.time *= 1 / mod_rate(mods_);
+        return h;
+    }
+
+    // Writes the events from begin on to output, which must fit within the view.
+    void read(size_t begin, std::span<HitObject> output) const
+    {
+        if (begin > size() || output.size() > size() - begin)
+            throw std::out_of_range("TransformedView read past the end");
+
+        auto input = std::span(beatmap_->hit_objects).subspan(begin, output.size());
+        auto heights = std::span(*stack_heights_).subspan(begin, output.size());
+        float offset = output.empty() ? 0 : object_offset(begin);
+        detail::transform_hit_objects(input, output, heights, stack_offset_, mods_, offset);
+    }
+
+private:
+    // The stack offset of the object event i belongs to, from its start event.
+    float object_offset(size_t i) const
+    {
+        const auto& hitObjects = beatmap_->hit_objects;
+        while (i > 0 && !is_start_event(hitObjects[i].type))
+            --i;
+        return (*stack_heights_)[i] * stack_offset_;
+    }
+
+    const Beatmap* beatmap_;
+    Mods mods_;
+    MapDifficultyAttributes difficulty_;
+    float stack_offset_;
+    std::shared_ptr<const std::vector<int>> stack_heights_;
+};
 }
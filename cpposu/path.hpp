@@ -26,6 +26,11 @@ namespace cpposu
         /// </summary>
         inline constexpr int catmull_detail = 50;
 
+        /// <summary>
+        /// The maximum distance between an adaptively tessellated Catmull-Rom segment and the true curve.
+        /// </summary>
+        inline constexpr float catmull_tolerance = 0.25f;
+
         inline constexpr float circular_arc_tolerance = 0.1f;
         /// <summary>
         /// Make sure the 2nd order derivative (approximated using finite elements) is within tolerable bounds.
@@ -34,12 +39,13 @@ namespace cpposu
         ///       need to have a denser approximation to be more "flat".
         /// </summary>
         /// <param name="controlPoints">The control points to check for flatness.</param>
+        /// <param name="tolerance">The tolerable distance between the approximation and the curve.</param>
         /// <returns>Whether the control points are flat enough.</returns>
-        inline bool bezierIsFlatEnough(std::span<Vector2> controlPoints)
+        inline bool bezierIsFlatEnough(std::span<Vector2> controlPoints, float tolerance = bezier_tolerance)
         {
             for (int i = 1; i < controlPoints.size() - 1; i++)
             {
-                if ((controlPoints[i - 1] - 2 * controlPoints[i] + controlPoints[i + 1]).squared_length() > bezier_tolerance * bezier_tolerance * 4)
+                if ((controlPoints[i - 1] - 2 * controlPoints[i] + controlPoints[i + 1]).squared_length() > tolerance * tolerance * 4)
                     return false;
             }
 
@@ -122,9 +128,146 @@ namespace cpposu
 
             return result;
         }
-    }
-    void ApproximateBSpline(std::vector<Vector2>& output, std::span<Vector2> controlPoints, int p = 0);
 
+        /// <summary>
+        /// Adaptively flattens the bezier curves in <paramref name="toFlatten"/>, all of which have <paramref name="p"/>+1
+        /// control points, by repeatedly subdividing them until their approximation error vanishes below a given threshold.
+        /// Curves are consumed from the back, so the first curve of the path must be the last element.
+        /// </summary>
+        inline void flattenBeziers(std::vector<Vector2>& output, std::vector<std::span<Vector2>>& toFlatten, Arena<Vector2>& arena, int p, float tolerance)
+        {
+            auto Pop = [](auto& vec) { auto result = vec.back(); vec.pop_back(); return result; };
+
+            std::vector<std::span<Vector2>> freeBuffers;
+
+            // "toFlatten" contains all the curves which are not yet approximated well enough.
+            // We use a stack to emulate recursion without the risk of running into a stack overflow.
+            // (More specifically, we iteratively and adaptively refine our curve with a
+            // <a href="https://en.wikipedia.org/wiki/Depth-first_search">Depth-first search</a>
+            // over the tree resulting from the subdivisions we make.)
+
+            std::span<Vector2> subdivisionBuffer1 = arena.take(p+1);
+            std::span<Vector2> subdivisionBuffer2 = arena.take(p * 2 + 1);
+
+            std::span<Vector2> leftChild = subdivisionBuffer2;
+
+            while (toFlatten.size() > 0)
+            {
+                std::span<Vector2> parent = Pop(toFlatten);
+
+                CPPOSU_STAT_ADD(bezier_flatness_tests, 1);
+                if (bezierIsFlatEnough(parent, tolerance))
+                {
+                    // If the control points we currently operate on are sufficiently "flat", we use
+                    // an extension to De Casteljau's algorithm to obtain a piecewise-linear approximation
+                    // of the bezier curve represented by our control points, consisting of the same amount
+                    // of points as there are control points.
+                    bezierApproximate(parent, output, subdivisionBuffer1, subdivisionBuffer2, p + 1);
+
+                    freeBuffers.push_back(parent);
+                    continue;
+                }
+
+                // If we do not yet have a sufficiently "flat" (in other words, detailed) approximation we keep
+                // subdividing the curve we are currently operating on.
+                std::span<Vector2> rightChild = freeBuffers.size() > 0 ? Pop(freeBuffers) : arena.take(p+1);
+                CPPOSU_STAT_ADD(bezier_subdivisions, 1);
+                bezierSubdivide(parent, leftChild, rightChild, subdivisionBuffer1, p + 1);
+
+                // We re-use the buffer of the parent for one of the children, so that we save one allocation per iteration.
+                for (int i = 0; i < p + 1; ++i)
+                    parent[i] = leftChild[i];
+
+                toFlatten.push_back(rightChild);
+                toFlatten.push_back(parent);
+            }
+        }
+
+        /// <summary>
+        /// Splits a uniform B-spline into the bezier curves between its knots, by inserting every knot degree-1
+        /// times using Boehm's algorithm. <paramref name="points"/> is overwritten during the subdivision.
+        /// </summary>
+        /// <returns>The bezier curves, each with degree+1 control points, last curve of the path first.</returns>
+        inline std::vector<std::span<Vector2>> bsplineToBeziers(std::span<Vector2> points, int degree, Arena<Vector2>& arena)
+        {
+            std::vector<std::span<Vector2>> result;
+            int pointCount = points.size() - 1;
+
+            if (degree == pointCount)
+            {
+                // B-spline subdivision unnecessary, degenerate to single bezier.
+                result.push_back(points);
+                return result;
+            }
+
+            result.reserve(pointCount - degree + 1);
+            for (int i = 0; i < pointCount - degree; i++)
+            {
+                std::span<Vector2> subBezier = arena.take(degree + 1);
+                subBezier[0] = points[i];
+
+                // Destructively insert the knot degree-1 times via Boehm's algorithm.
+                for (int j = 0; j < degree - 1; j++)
+                {
+                    subBezier[j + 1] = points[i + 1];
+
+                    for (int k = 1; k < degree - j; k++)
+                    {
+                        int l = std::min(k, pointCount - degree - i);
+                        points[i + k] = (l * points[i + k] + points[i + k + 1]) / (l + 1);
+                    }
+                }
+
+                subBezier[degree] = points[i + 1];
+                result.push_back(subBezier);
+            }
+
+            result.push_back(points.subspan(pointCount - degree));
+
+            // The curves are flattened from the back.
+            std::reverse(result.begin(), result.end());
+            return result;
+        }
+
+        /// <summary>
+        /// Sliders longer than their path are extended along the final piece of the path. Appends a point just before
+        /// <paramref name="end"/> along the curve's tangent, so that coarse approximations are extended in the same
+        /// direction as exact ones.
+        /// </summary>
+        inline void appendEndTangent(std::vector<Vector2>& output, Vector2 end, Vector2 tangent, float tolerance)
+        {
+            if (output.empty() || tangent.squared_length() == 0)
+                return;
+
+            float tangentLength = tangent.length();
+            float offset = std::min(tolerance, tangentLength / 2);
+            if ((output.back() - end).squared_length() > 4 * offset * offset)
+                output.push_back(end - tangent * (offset / tangentLength));
+        }
+
+        /// <summary>
+        /// Creates a piecewise-linear approximation of a B-spline of the given degree.
+        /// A degree equal to the number of control points minus one describes a single bezier curve.
+        /// </summary>
+        /// <param name="points">The control points, overwritten during the approximation.</param>
+        inline void approximateBSpline(std::vector<Vector2>& output, std::span<Vector2> points, int degree, Arena<Vector2>& arena, float tolerance)
+        {
+            Vector2 last = points.back();
+
+            auto toFlatten = bsplineToBeziers(points, degree, arena);
+
+            std::optional<Vector2> endTangent;
+            if (tolerance > bezier_tolerance && degree > 0)
+                endTangent = toFlatten.front()[degree] - toFlatten.front()[degree - 1];
+
+            flattenBeziers(output, toFlatten, arena, degree, tolerance);
+
+            if (endTangent)
+                appendEndTangent(output, last, *endTangent, tolerance);
+
+            output.push_back(last);
+        }
+    }
 
     /// <summary>
     /// Creates a piecewise-linear approximation of a bezier curve, by adaptively repeatedly subdividing
@@ -132,7 +275,7 @@ namespace cpposu
     /// </summary>
     /// <param name="controlPoints">The control points.</param>
     /// <returns>A list of vectors representing the piecewise-linear approximation.</returns>
-    inline void ApproximateBezier(std::vector<Vector2>& output, std::span<const SliderControlPoint> controlPoints)
+    inline void ApproximateBezier(std::vector<Vector2>& output, std::span<const SliderControlPoint> controlPoints, float tolerance = detail::bezier_tolerance)
     {
         int p = controlPoints.size() - 1;
 
@@ -141,11 +284,6 @@ namespace cpposu
 
         Arena<Vector2> arena;
 
-        auto Pop = [](auto& vec) { auto result = vec.back(); vec.pop_back(); return result; };
-
-        std::vector<std::span<Vector2>> toFlatten;
-        std::vector<std::span<Vector2>> freeBuffers;
-
         auto inputPoints = arena.take(controlPoints.size());
         {
             size_t i =0;
@@ -155,49 +293,96 @@ namespace cpposu
             }
         }
 
-        toFlatten.push_back(inputPoints);
-        // "toFlatten" contains all the curves which are not yet approximated well enough.
-        // We use a stack to emulate recursion without the risk of running into a stack overflow.
-        // (More specifically, we iteratively and adaptively refine our curve with a
-        // <a href="https://en.wikipedia.org/wiki/Depth-first_search">Depth-first search</a>
-        // over the tree resulting from the subdivisions we make.)
+        detail::approximateBSpline(output, inputPoints, p, arena, tolerance);
+    }
 
-        std::span<Vector2> subdivisionBuffer1 = arena.take(p+1);
-        std::span<Vector2> subdivisionBuffer2 = arena.take(p * 2 + 1);
+    /// <summary>
+    /// Creates a piecewise-linear approximation of a clamped uniform B-spline with polynomial order p,
+    /// by dividing it into a series of bezier control points at its knots, then adaptively repeatedly
+    /// subdividing those until their approximation error vanishes below a given threshold.
+    /// </summary>
+    /// <param name="controlPoints">The control points.</param>
+    /// <param name="p">The polynomial order. Values less than 1 give a single bezier curve through all control points.</param>
+    inline void ApproximateBSpline(std::vector<Vector2>& output, std::span<const Vector2> controlPoints, int p = 0, float tolerance = detail::bezier_tolerance)
+    {
+        if (controlPoints.size() < 2)
+        {
+            if (!controlPoints.empty()) output.push_back(controlPoints[0]);
+            return;
+        }
+
+        int pointCount = controlPoints.size() - 1;
+
+        // Zero-th degree splines would be piecewise-constant, which cannot be represented by the piecewise-
+        // linear output of this function. Negative degrees would require rational splines which this code
+        // does not support.
+        p = p < 1 ? pointCount : std::min(p, pointCount);
+
+        Arena<Vector2> arena;
+        auto inputPoints = arena.take(controlPoints.size());
+        std::copy(controlPoints.begin(), controlPoints.end(), inputPoints.begin());
 
-        std::span<Vector2> leftChild = subdivisionBuffer2;
+        detail::approximateBSpline(output, inputPoints, p, arena, tolerance);
+    }
 
-        while (toFlatten.size() > 0)
+    inline void ApproximateBSpline(std::vector<Vector2>& output, std::span<const SliderControlPoint> controlPoints, int p, float tolerance = detail::bezier_tolerance)
+    {
+        if (controlPoints.size() < 2)
         {
-            std::span<Vector2> parent = Pop(toFlatten);
+            if (!controlPoints.empty()) output.push_back(controlPoints[0].position);
+            return;
+        }
 
-            if (detail::bezierIsFlatEnough(parent))
-            {
-                // If the control points we currently operate on are sufficiently "flat", we use
-                // an extension to De Casteljau's algorithm to obtain a piecewise-linear approximation
-                // of the bezier curve represented by our control points, consisting of the same amount
-                // of points as there are control points.
-                detail::bezierApproximate(parent, output, subdivisionBuffer1, subdivisionBuffer2, p + 1);
-
-                freeBuffers.push_back(parent);
-                continue;
-            }
+        int pointCount = controlPoints.size() - 1;
+        p = p < 1 ? pointCount : std::min(p, pointCount);
+
+        // the positions go straight into the arena, as for ApproximateBezier
+        Arena<Vector2> arena;
+        auto inputPoints = arena.take(controlPoints.size());
+        std::transform(controlPoints.begin(), controlPoints.end(), inputPoints.begin(), [](const SliderControlPoint& point) { return point.position; });
+
+        detail::approximateBSpline(output, inputPoints, p, arena, tolerance);
+    }
+
+    enum class catmull_tessellation
+    {
+        legacy_fixed, // catmull_detail pieces per segment, exactly as osu! does
+        adaptive, // as few pieces per segment as keep the path within a tolerance of the curve
+    };
 
-            // If we do not yet have a sufficiently "flat" (in other words, detailed) approximation we keep
-            // subdividing the curve we are currently operating on.
-            std::span<Vector2> rightChild = freeBuffers.size() > 0 ? Pop(freeBuffers) : arena.take(p+1);
-            detail::bezierSubdivide(parent, leftChild, rightChild, subdivisionBuffer1, p + 1);
+    /// <summary>
+    /// Controls how closely slider paths approximate their curves, trading accuracy for speed.
+    /// The defaults reproduce osu! exactly.
+    /// </summary>
+    struct PathPrecision
+    {
+        float bezier_tolerance = detail::bezier_tolerance;
+        float circular_arc_tolerance = detail::circular_arc_tolerance;
+        catmull_tessellation catmull = catmull_tessellation::legacy_fixed;
+        float catmull_tolerance = detail::catmull_tolerance;
 
-            // We re-use the buffer of the parent for one of the children, so that we save one allocation per iteration.
-            for (int i = 0; i < p + 1; ++i)
-                parent[i] = leftChild[i];
+        /// Identical paths to osu!
+        static constexpr PathPrecision exact_parity() { return {}; }
 
-            toFlatten.push_back(rightChild);
-            toFlatten.push_back(parent);
+        /// osu! tolerances, but without the redundant points of legacy Catmull-Rom sliders.
+        static constexpr PathPrecision standard()
+        {
+            return {
+                .catmull = catmull_tessellation::adaptive,
+            };
         }
 
-        output.push_back(controlPoints[p].position);
-    }
+        /// Coarse paths for previews, within a few pixels of the exact path.
+        static constexpr PathPrecision fast_preview()
+        {
+            return {
+                .bezier_tolerance = 2.0f,
+                .circular_arc_tolerance = 1.0f,
+                .catmull = catmull_tessellation::adaptive,
+                .catmull_tolerance = 2.0f,
+            };
+        }
+    };
 
     /// <summary>
     /// Creates a piecewise-linear approximation of a Catmull-Rom spline.
@@ -221,6 +406,54 @@ namespace cpposu
         }
     }
 
+    /// <summary>
+    /// Creates a piecewise-linear approximation of a Catmull-Rom spline that deviates from the curve by at most
+    /// <paramref name="tolerance"/>, using as few points as possible for each segment.
+    /// Each segment is a cubic bezier curve, so the number of pieces needed follows from the bound on the
+    /// second derivative of its control points (Wang's formula), and nearly straight segments need only one.
+    /// </summary>
+    inline void ApproximateCatmullAdaptive(std::vector<Vector2>& out, std::span<const SliderControlPoint> controlPoints, float tolerance = detail::catmull_tolerance)
+    {
+        if (controlPoints.size() < 2)
+            return;
+
+        Vector2 v1, v2, v3, v4;
+        int pieces = 1;
+        for (size_t i = 0; i + 1 < controlPoints.size(); i++)
+        {
+            v1 = i > 0 ? controlPoints[i - 1].position : controlPoints[i].position;
+            v2 = controlPoints[i].position;
+            v3 = controlPoints[i + 1].position;
+            v4 = i + 2 < controlPoints.size() ? controlPoints[i + 2].position : v3 + v3 - v2;
+
+            // equivalent cubic bezier control points are v2, b1, b2, v3
+            Vector2 b1 = v2 + (v3 - v1) / 6;
+            Vector2 b2 = v3 - (v4 - v2) / 6;
+            float max_second_difference = std::sqrt(std::max(
+                (v2 - 2 * b1 + b2).squared_length(),
+                (b1 - 2 * b2 + v3).squared_length()));
+
+            pieces = std::max(1, (int)std::ceil(std::sqrt(0.75f * max_second_difference / tolerance)));
+
+            for (int c = 0; c < pieces; c++)
+                out.push_back(detail::catmullFindPoint(v1, v2, v3, v4, (float)c / pieces));
+        }
+
+        // Sliders longer than their path are extended along the final piece, so keep its direction the same as the
+        // legacy tessellation, unless the last segment's pieces are already that fine (its last sample is at or past
+        // the legacy one, and adding it would turn the path back).
+        if (pieces < detail::catmull_detail)
+            out.push_back(detail::catmullFindPoint(v1, v2, v3, v4, (float)(detail::catmull_detail - 1) / detail::catmull_detail));
+        out.push_back(detail::catmullFindPoint(v1, v2, v3, v4, 1));
+    }
+
+    inline void ApproximateCatmull(std::vector<Vector2>& out, std::span<const SliderControlPoint> controlPoints, const PathPrecision& precision)
+    {
+        if (precision.catmull == catmull_tessellation::adaptive)
+            return ApproximateCatmullAdaptive(out, controlPoints, precision.catmull_tolerance);
+        return ApproximateCatmull(out, controlPoints);
+    }
+
     struct CircularArc
     {
         Vector2 Centre;
@@ -268,7 +501,7 @@ namespace cpposu
         }
 
 
-        static std::optional<CircularArc> fromControlPoints(std::span<const SliderControlPoint> controlPoints)
+        static std::optional<CircularArc> fromControlPoints(std::span<const SliderControlPoint> controlPoints, float circular_arc_tolerance = detail::circular_arc_tolerance)
         {
             if (controlPoints.size() != 3) return {};
 
@@ -325,7 +558,6 @@ namespace cpposu
 
             // osu! approximates circles as linear segments with below tolerance
             // This makes the overall path shorter
-            constexpr float circular_arc_tolerance = 0.1;
             if (circular_arc_tolerance < 2*result.Radius)
             {
                 double point_count = result.ThetaRange / (2*std::acos((double)(1.0f - circular_arc_tolerance / result.Radius)));
@@ -343,12 +575,20 @@ namespace cpposu
 
     };
 
-    inline void ApproximateCircle(std::vector<Vector2>& output, std::span<const SliderControlPoint> controlPoints)
+    inline void ApproximateCircle(std::vector<Vector2>& output, std::span<const SliderControlPoint> controlPoints, const PathPrecision& precision = {})
     {
-        std::optional<CircularArc> arc = CircularArc::fromControlPoints(controlPoints);
-        if (!arc) return ApproximateBezier(output, controlPoints);
+        std::optional<CircularArc> arc = CircularArc::fromControlPoints(controlPoints, precision.circular_arc_tolerance);
+        if (!arc) return ApproximateBezier(output, controlPoints, precision.bezier_tolerance);
+
+        if (precision.circular_arc_tolerance <= detail::circular_arc_tolerance)
+            return arc->Approximate(output);
 
         arc->Approximate(output);
+        Vector2 end = output.back();
+        output.pop_back();
+        Vector2 radial = end - arc->Centre;
+        detail::appendEndTangent(output, end, Vector2{-radial.Y, radial.X} * arc->Direction, precision.circular_arc_tolerance);
+        output.push_back(end);
     }
 
     inline void AppendLinear(std::vector<Vector2>& path, std::span<const SliderControlPoint> controlPoints)
@@ -361,20 +601,22 @@ namespace cpposu
     }
 
 
-    inline void calculate_segment_path(std::vector<Vector2>& path, std::span<const SliderControlPoint> control_points)
+    inline void calculate_segment_path(std::vector<Vector2>& path, std::span<const SliderControlPoint> control_points, const PathPrecision& precision = {})
     {
         if (control_points.empty()) return;
 
         switch(control_points[0].new_slider_type)
         {
             case slider_type::Bezier:
-                return ApproximateBezier(path, control_points);
+                return ApproximateBezier(path, control_points, precision.bezier_tolerance);
+            case slider_type::BSpline:
+                return ApproximateBSpline(path, control_points, control_points[0].degree, precision.bezier_tolerance);
             case slider_type::PerfectCircle:
-                return ApproximateCircle(path, control_points);
+                return ApproximateCircle(path, control_points, precision);
             case slider_type::Linear:
                 return AppendLinear(path, control_points);
             case slider_type::CentripetalCatmullRom:
-                return ApproximateCatmull(path, control_points);
+                return ApproximateCatmull(path, control_points, precision);
             default:
                 throw std::runtime_error("unknown slider type");
         }
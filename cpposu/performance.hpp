@@ -0,0 +1,285 @@
+#pragma once
+
+#include "difficulty.hpp"
+#include "line_parser.hpp"
+
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <ostream>
+#include <sstream>
+#include <string>
+
+namespace cpposu {
+
+// What a score hit, as needed for performance.
+struct ScoreStatistics
+{
+    int MaxCombo = 0;
+    int CountGreat = 0;
+    int CountOk = 0;
+    int CountMeh = 0;
+    int CountMiss = 0;
+    // Only recorded with lazer's slider accuracy; negative for stable scores, which use classic slider accuracy.
+    int CountLargeTickMiss = -1;
+    int CountSliderTailHit = -1;
+};
+
+struct PerformanceAttributes
+{
+    double Aim = 0;
+    double Speed = 0;
+    double Accuracy = 0;
+    double Flashlight = 0;
+    double EffectiveMissCount = 0;
+    double Total = 0;
+};
+
+namespace detail {
+
+inline double accuracy(const ScoreStatistics& s)
+{
+    int totalHits = s.CountGreat + s.CountOk + s.CountMeh + s.CountMiss;
+    if (totalHits == 0)
+        return 0;
+    return (s.CountGreat * 6.0 + s.CountOk * 2.0 + s.CountMeh) / (totalHits * 6.0);
+}
+
+// OsuPerformanceCalculator.calculateEffectiveMissCount: misses plus slider breaks guessed from the combo
+inline double effective_miss_count(const DifficultyAttributes& attributes, const ScoreStatistics& s)
+{
+    double comboBasedMissCount = 0.0;
+    if (attributes.SliderCount > 0)
+    {
+        if (s.CountLargeTickMiss < 0 || s.CountSliderTailHit < 0)
+        {
+            // dropped slider ends don't break combo; without slider accuracy, guess them as 10% of the sliders
+            double fullComboThreshold = attributes.MaxCombo - 0.1 * attributes.SliderCount;
+            if (s.MaxCombo < fullComboThreshold)
+                comboBasedMissCount = fullComboThreshold / std::max(1.0, (double) s.MaxCombo);
+
+            // clamp to the number of possible breaks
+            comboBasedMissCount = std::min(comboBasedMissCount, (double) (s.CountOk + s.CountMeh + s.CountMiss));
+        }
+        else
+        {
+            double fullComboThreshold = attributes.MaxCombo - (attributes.SliderCount - s.CountSliderTailHit);
+            if (s.MaxCombo < fullComboThreshold)
+                comboBasedMissCount = fullComboThreshold / std::max(1.0, (double) s.MaxCombo);
+
+            // tick misses break combo as well as misses
+            comboBasedMissCount = std::min(comboBasedMissCount, (double) (s.CountLargeTickMiss + s.CountMiss));
+        }
+    }
+    return std::max((double) s.CountMiss, comboBasedMissCount);
+}
+
+inline double length_bonus(int totalHits)
+{
+    return 0.95 + 0.4 * std::min(1.0, totalHits / 2000.0) + (totalHits > 2000 ? std::log10(totalHits / 2000.0) * 0.5 : 0.0);
+}
+
+inline double miss_penalty(double missCount, double difficultStrainCount)
+{
+    return 0.96 / ((missCount / (4 * std::pow(std::log(difficultStrainCount), 0.94))) + 1);
+}
+
+}
+
+// Performance points of a score, following lazer's OsuPerformanceCalculator. attributes must have been calculated
+// with the score's mods; this is cheap enough to run per score.
+inline PerformanceAttributes calculate_performance(const DifficultyAttributes& attributes, Mods mods, const ScoreStatistics& score)
+{
+    PerformanceAttributes pp;
+
+    const int totalHits = score.CountGreat + score.CountOk + score.CountMeh + score.CountMiss;
+    const int totalImperfectHits = score.CountOk + score.CountMeh + score.CountMiss;
+    const bool classicSliderAccuracy = score.CountLargeTickMiss < 0 || score.CountSliderTailHit < 0;
+    const double accuracy = detail::accuracy(score);
+    const bool hidden = has_mod(mods, Mods::Hidden);
+
+    double effectiveMissCount = detail::effective_miss_count(attributes, score);
+
+    double multiplier = performance_base_multiplier;
+    if (has_mod(mods, Mods::NoFail))
+        multiplier *= std::max(0.90, 1.0 - 0.02 * effectiveMissCount);
+    if (has_mod(mods, Mods::SpunOut) && totalHits > 0)
+        multiplier *= 1.0 - std::pow((double) attributes.SpinnerCount / totalHits, 0.85);
+
+    if (has_mod(mods, Mods::Relax))
+    {
+        // OD 13.33 is where the great hit window becomes 0
+        double od = attributes.OverallDifficulty;
+        double okMultiplier = std::max(0.0, od > 0.0 ? 1 - std::pow(od / 13.33, 1.8) : 1.0);
+        double mehMultiplier = std::max(0.0, od > 0.0 ? 1 - std::pow(od / 13.33, 5) : 1.0);
+
+        // the oks and mehs added to the combo breaks can exceed the total hits
+        effectiveMissCount = std::min(effectiveMissCount + score.CountOk * okMultiplier + score.CountMeh * mehMultiplier, (double) totalHits);
+    }
+    pp.EffectiveMissCount = effectiveMissCount;
+
+    const double lengthBonus = detail::length_bonus(totalHits);
+
+    if (!has_mod(mods, Mods::Autopilot))
+    {
+        double aimValue = difficulty_to_performance(attributes.AimDifficulty) * lengthBonus;
+        if (effectiveMissCount > 0)
+            aimValue *= detail::miss_penalty(effectiveMissCount, attributes.AimDifficultStrainCount);
+
+        double approachRateFactor = 0.0;
+        if (attributes.ApproachRate > 10.33)
+            approachRateFactor = 0.3 * (attributes.ApproachRate - 10.33);
+        else if (attributes.ApproachRate < 8.0)
+            approachRateFactor = 0.05 * (8.0 - attributes.ApproachRate);
+        if (has_mod(mods, Mods::Relax))
+            approachRateFactor = 0.0;
+
+        // buff for longer maps with high AR
+        aimValue *= 1.0 + approachRateFactor * lengthBonus;
+
+        // reward lower AR more with hidden
+        if (hidden)
+            aimValue *= 1.0 + 0.04 * (12.0 - attributes.ApproachRate);
+
+        // assume 15% of the sliders are difficult, since the performance calculator can't tell
+        double estimateDifficultSliders = attributes.SliderCount * 0.15;
+        if (attributes.SliderCount > 0)
+        {
+            double estimateImproperlyFollowedDifficultSliders;
+            if (classicSliderAccuracy)
+            {
+                // all missing combo counts as dropped difficult sliders
+                int maximumPossibleDroppedSliders = totalImperfectHits;
+                estimateImproperlyFollowedDifficultSliders = std::clamp<double>(std::min(maximumPossibleDroppedSliders, attributes.MaxCombo - score.MaxCombo), 0, estimateDifficultSliders);
+            }
+            else
+            {
+                // tick misses mean the slider wasn't followed properly either
+                int countSliderEndsDropped = attributes.SliderCount - score.CountSliderTailHit;
+                estimateImproperlyFollowedDifficultSliders = std::clamp<double>(countSliderEndsDropped + score.CountLargeTickMiss, 0, estimateDifficultSliders);
+            }
+
+            double sliderNerfFactor = (1 - attributes.SliderFactor) * std::pow(1 - estimateImproperlyFollowedDifficultSliders / estimateDifficultSliders, 3) + attributes.SliderFactor;
+            aimValue *= sliderNerfFactor;
+        }
+
+        aimValue *= accuracy;
+        // consider accuracy difficulty when scaling with accuracy
+        aimValue *= 0.98 + std::pow(attributes.OverallDifficulty, 2) / 2500;
+        pp.Aim = aimValue;
+    }
+
+    if (!has_mod(mods, Mods::Relax))
+    {
+        double speedValue = difficulty_to_performance(attributes.SpeedDifficulty) * lengthBonus;
+        if (effectiveMissCount > 0)
+            speedValue *= detail::miss_penalty(effectiveMissCount, attributes.SpeedDifficultStrainCount);
+
+        double approachRateFactor = 0.0;
+        if (attributes.ApproachRate > 10.33 && !has_mod(mods, Mods::Autopilot))
+            approachRateFactor = 0.3 * (attributes.ApproachRate - 10.33);
+        speedValue *= 1.0 + approachRateFactor * lengthBonus;
+
+        if (hidden)
+            speedValue *= 1.0 + 0.04 * (12.0 - attributes.ApproachRate);
+
+        // accuracy on the notes that matter for speed, assuming the worst case
+        double relevantTotalDiff = totalHits - attributes.SpeedNoteCount;
+        double relevantCountGreat = std::max(0.0, score.CountGreat - relevantTotalDiff);
+        double relevantCountOk = std::max(0.0, score.CountOk - std::max(0.0, relevantTotalDiff - score.CountGreat));
+        double relevantCountMeh = std::max(0.0, score.CountMeh - std::max(0.0, relevantTotalDiff - score.CountGreat - score.CountOk));
+        double relevantAccuracy = attributes.SpeedNoteCount == 0 ? 0 : (relevantCountGreat * 6.0 + relevantCountOk * 2.0 + relevantCountMeh) / (attributes.SpeedNoteCount * 6.0);
+
+        speedValue *= (0.95 + std::pow(attributes.OverallDifficulty, 2) / 750)
+                      * std::pow((accuracy + relevantAccuracy) / 2.0, (14.5 - std::max(attributes.OverallDifficulty, 8.0)) / 2);
+
+        // punish doubletapping through the number of mehs
+        speedValue *= std::pow(0.99, score.CountMeh < totalHits / 500.0 ? 0 : score.CountMeh - totalHits / 500.0);
+        pp.Speed = speedValue;
+    }
+
+    if (!has_mod(mods, Mods::Relax))
+    {
+        // only objects with a timing hit window count here
+        int amountHitObjectsWithAccuracy = attributes.HitCircleCount;
+        if (!classicSliderAccuracy)
+            amountHitObjectsWithAccuracy += attributes.SliderCount;
+
+        double betterAccuracyPercentage = 0;
+        if (amountHitObjectsWithAccuracy > 0)
+            betterAccuracyPercentage = ((score.CountGreat - (totalHits - amountHitObjectsWithAccuracy)) * 6.0 + score.CountOk * 2.0 + score.CountMeh) / (amountHitObjectsWithAccuracy * 6.0);
+        betterAccuracyPercentage = std::max(0.0, betterAccuracyPercentage);
+
+        double accuracyValue = std::pow(1.52163, attributes.OverallDifficulty) * std::pow(betterAccuracyPercentage, 24) * 2.83;
+
+        // it's harder to keep good accuracy up for longer
+        accuracyValue *= std::min(1.15, std::pow(amountHitObjectsWithAccuracy / 1000.0, 0.3));
+
+        if (hidden)
+            accuracyValue *= 1.08;
+        if (has_mod(mods, Mods::Flashlight))
+            accuracyValue *= 1.02;
+        pp.Accuracy = accuracyValue;
+    }
+
+    if (has_mod(mods, Mods::Flashlight))
+    {
+        double flashlightValue = flashlight_difficulty_to_performance(attributes.FlashlightDifficulty);
+
+        // misses relative to the number of objects, with a 3% reduction for any misses
+        if (effectiveMissCount > 0)
+            flashlightValue *= 0.97 * std::pow(1 - std::pow(effectiveMissCount / totalHits, 0.775), std::pow(effectiveMissCount, .875));
+
+        flashlightValue *= attributes.MaxCombo <= 0 ? 1.0 : std::min(std::pow(score.MaxCombo, 0.8) / std::pow(attributes.MaxCombo, 0.8), 1.0);
+
+        // shorter maps have a higher ratio of 0 combo/100 combo flashlight radius
+        flashlightValue *= 0.7 + 0.1 * std::min(1.0, totalHits / 200.0) + (totalHits > 200 ? 0.2 * std::min(1.0, (totalHits - 200) / 200.0) : 0.0);
+
+        flashlightValue *= 0.5 + accuracy / 2.0;
+        flashlightValue *= 0.98 + std::pow(attributes.OverallDifficulty, 2) / 2500;
+        pp.Flashlight = flashlightValue;
+    }
+
+    pp.Total = std::pow(std::pow(pp.Aim, 1.1) + std::pow(pp.Speed, 1.1) + std::pow(pp.Accuracy, 1.1) + std::pow(pp.Flashlight, 1.1), 1.0 / 1.1) * multiplier;
+    return pp;
+}
+
+#define CPPOSU_DIFFICULTY_ATTRIBUTES(X) \
+    X(StarRating) X(AimDifficulty) X(SpeedDifficulty) X(SpeedNoteCount) X(FlashlightDifficulty) X(SliderFactor) \
+    X(AimDifficultStrainCount) X(SpeedDifficultStrainCount) X(ApproachRate) X(OverallDifficulty) X(DrainRate) \
+    X(MaxCombo) X(HitCircleCount) X(SliderCount) X(SpinnerCount)
+
+// Writes the attributes as "Name: value" lines, read back exactly by read_attributes.
+inline void write_attributes(std::ostream& os, const DifficultyAttributes& attributes)
+{
+    auto precision = os.precision(std::numeric_limits<double>::max_digits10);
+    #define CPPOSU_WRITE_ATTRIBUTE(var) os << #var ": " << attributes.var << "\n";
+    CPPOSU_DIFFICULTY_ATTRIBUTES(CPPOSU_WRITE_ATTRIBUTE)
+    #undef CPPOSU_WRITE_ATTRIBUTE
+    os.precision(precision);
+}
+
+inline std::string to_string(const DifficultyAttributes& attributes)
+{
+    std::ostringstream ss;
+    write_attributes(ss, attributes);
+    return ss.str();
+}
+
+// Reads attributes written by write_attributes. Unknown names are ignored and missing ones keep their defaults, so
+// that cached attributes survive fields being added.
+inline DifficultyAttributes read_attributes(std::istream& stream)
+{
+    DifficultyAttributes attributes;
+    LineParser parser(stream, "<difficulty attributes>");
+    for (auto line = parser.read_line(); !line.empty(); line = parser.read_line())
+    {
+        auto key = trim_space(parser.take_column(line, ':'));
+        #define CPPOSU_READ_ATTRIBUTE(var) if (key == #var) attributes.var = parser.read_number_or_throw<double>(trim_space(line));
+        CPPOSU_DIFFICULTY_ATTRIBUTES(CPPOSU_READ_ATTRIBUTE)
+        #undef CPPOSU_READ_ATTRIBUTE
+    }
+    return attributes;
+}
+
+}
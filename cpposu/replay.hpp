@@ -0,0 +1,313 @@
+#pragma once
+
+#include "line_parser.hpp"
+#include "lzma.hpp"
+#include "mapped_file.hpp"
+#include "mods.hpp"
+
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cpposu {
+
+// Keys held in an osu!standard replay frame. A keyboard key also sets the mouse button it stands for.
+enum class ReplayKeys : uint32_t
+{
+    None = 0,
+    M1 = 1 << 0,
+    M2 = 1 << 1,
+    K1 = 1 << 2,
+    K2 = 1 << 3,
+    Smoke = 1 << 4,
+};
+
+constexpr bool has_key(uint32_t keys, ReplayKeys key) { return (keys & (uint32_t) key) != 0; }
+
+// Replay frames, one array per value.
+struct ReplayFrames
+{
+    // ms since the previous frame, as stored
+    std::vector<int32_t> time_delta;
+    // ms since the start of the replay, the sum of the deltas
+    std::vector<int32_t> time;
+    std::vector<float> x;
+    std::vector<float> y;
+    // ReplayKeys bits
+    std::vector<uint32_t> keys;
+
+    size_t size() const { return time.size(); }
+};
+
+struct LifeBarPoint
+{
+    int32_t time;
+    // 0 to 1
+    float life;
+};
+
+// A parsed .osr file.
+struct Replay
+{
+    int mode = 0;
+    int version = 0;
+    std::string beatmap_hash;
+    std::string player_name;
+    std::string replay_hash;
+    int count_300 = 0;
+    int count_100 = 0;
+    int count_50 = 0;
+    int count_geki = 0;
+    int count_katu = 0;
+    int count_miss = 0;
+    int score = 0;
+    int max_combo = 0;
+    bool perfect = false;
+    Mods mods = Mods::None;
+    std::vector<LifeBarPoint> life_bar;
+    // .NET ticks (100ns since 0001-01-01)
+    int64_t timestamp = 0;
+    // 32-bit before 20140721, and not stored (0) before 20121008
+    int64_t online_score_id = 0;
+    // only set with the target practice mod
+    double target_practice_accuracy = 0;
+    // from the last frame of replays since 20130319, which isn't kept in frames
+    int32_t seed = 0;
+    ReplayFrames frames;
+};
+
+namespace detail {
+
+// Little-endian reader over the bytes of a replay.
+class BinaryReader
+{
+public:
+    explicit BinaryReader(std::string_view data): data_(data) {}
+
+    template<typename T>
+    T read()
+    {
+        auto bytes = take(sizeof(T));
+        std::make_unsigned_t<T> value = 0;
+        for (size_t i = 0; i < sizeof(T); ++i)
+            value |= (std::make_unsigned_t<T>) (uint8_t) bytes[i] << (8 * i);
+        return (T) value;
+    }
+    double read_double() { return std::bit_cast<double>(read<uint64_t>()); }
+
+    // .NET BinaryWriter string: 0x00 if null, or 0x0b and the ULEB128 length of the UTF-8 bytes that follow
+    std::string_view read_string()
+    {
+        uint8_t marker = read<uint8_t>();
+        if (marker == 0)
+            return {};
+        if (marker != 0x0b)
+            throw parse_error("Invalid string in replay", parse_error_code::invalid_header);
+
+        uint64_t length = 0;
+        for (int shift = 0;; shift += 7)
+        {
+            uint8_t b = read<uint8_t>();
+            if (shift > 56)
+                throw parse_error("Invalid string length in replay", parse_error_code::invalid_header);
+            length |= (uint64_t) (b & 0x7F) << shift;
+            if (!(b & 0x80))
+                break;
+        }
+        return take(length);
+    }
+
+    std::string_view take(uint64_t size)
+    {
+        if (size > data_.size() - pos_)
+            throw parse_error("Truncated replay", parse_error_code::truncated_data);
+        auto result = data_.substr(pos_, size);
+        pos_ += size;
+        return result;
+    }
+
+private:
+    std::string_view data_;
+    size_t pos_ = 0;
+};
+
+// Parses "w|x|y|z" frames separated by commas from the decompressed text as it arrives in chunks.
+class ReplayFrameParser
+{
+public:
+    explicit ReplayFrameParser(Replay& replay): replay_(replay) {}
+
+    void feed(std::string_view chunk)
+    {
+        while (!chunk.empty())
+        {
+            size_t end = chunk.find(',');
+            if (end == std::string_view::npos)
+            {
+                carry_.append(chunk);
+                return;
+            }
+            if (carry_.empty())
+                add_frame(chunk.substr(0, end));
+            else
+            {
+                carry_.append(chunk.substr(0, end));
+                add_frame(carry_);
+                carry_.clear();
+            }
+            chunk.remove_prefix(end + 1);
+        }
+    }
+
+    void finish()
+    {
+        add_frame(carry_);
+        carry_.clear();
+    }
+
+private:
+    void add_frame(std::string_view frame)
+    {
+        frame = trim_space(frame);
+        if (frame.empty())
+            return;
+
+        int64_t delta;
+        float x, y;
+        int64_t keys;
+        auto w = try_take_column(frame, '|');
+        auto xs = try_take_column(frame, '|');
+        auto ys = try_take_column(frame, '|');
+        if (!w || !xs || !ys || !read_number(delta, *w) || !read_number(x, *xs) || !read_number(y, *ys) || !read_number(keys, frame))
+            throw parse_error("Invalid replay frame", parse_error_code::invalid_number);
+
+        // the RNG seed is stored as a last frame
+        if (delta == -12345)
+        {
+            replay_.seed = (int32_t) keys;
+            return;
+        }
+
+        auto& frames = replay_.frames;
+        time_ += delta;
+        frames.time_delta.push_back((int32_t) delta);
+        frames.time.push_back((int32_t) time_);
+        frames.x.push_back(x);
+        frames.y.push_back(y);
+        frames.keys.push_back((uint32_t) keys);
+    }
+
+    Replay& replay_;
+    std::string carry_;
+    int64_t time_ = 0;
+};
+
+}
+
+// Parser of .osr replays. Files are memory-mapped, and the frames are decompressed and parsed in chunks straight
+// from the mapping.
+class ReplayParser
+{
+public:
+    explicit ReplayParser(const std::string& filename):
+        file_(std::make_unique<MappedFile>(filename)),
+        data_(file_->data())
+    {}
+
+    // Parses size bytes at data, which must outlive the parser.
+    ReplayParser(const char* data, size_t size):
+        data_(data, size)
+    {}
+
+    // Everything but the frames, which aren't decompressed.
+    Replay parse_header()
+    {
+        Replay replay;
+        parse(replay, false);
+        return replay;
+    }
+
+    Replay parse()
+    {
+        Replay replay;
+        parse(replay, true);
+        return replay;
+    }
+
+private:
+    // from the mods in replays, not one cpposu::Mods knows
+    static constexpr uint32_t target_practice = 1u << 23;
+    // first versions with an online score id, and with a 64-bit one
+    static constexpr int score_id_version = 20121008;
+    static constexpr int long_score_id_version = 20140721;
+
+    void parse(Replay& replay, bool frames)
+    {
+        detail::BinaryReader reader(data_);
+        replay.mode = reader.read<uint8_t>();
+        replay.version = reader.read<int32_t>();
+        replay.beatmap_hash = reader.read_string();
+        replay.player_name = reader.read_string();
+        replay.replay_hash = reader.read_string();
+        replay.count_300 = reader.read<uint16_t>();
+        replay.count_100 = reader.read<uint16_t>();
+        replay.count_50 = reader.read<uint16_t>();
+        replay.count_geki = reader.read<uint16_t>();
+        replay.count_katu = reader.read<uint16_t>();
+        replay.count_miss = reader.read<uint16_t>();
+        replay.score = reader.read<int32_t>();
+        replay.max_combo = reader.read<uint16_t>();
+        replay.perfect = reader.read<uint8_t>() != 0;
+        replay.mods = Mods(reader.read<uint32_t>());
+        parse_life_bar(replay, reader.read_string());
+        replay.timestamp = reader.read<int64_t>();
+
+        int32_t compressedSize = reader.read<int32_t>();
+        auto compressed = reader.take(std::max(compressedSize, 0));
+        if (replay.version >= long_score_id_version)
+            replay.online_score_id = reader.read<int64_t>();
+        else if (replay.version >= score_id_version)
+            replay.online_score_id = reader.read<int32_t>();
+        if ((uint32_t) replay.mods & target_practice)
+            replay.target_practice_accuracy = reader.read_double();
+
+        if (!frames || compressed.empty())
+            return;
+
+        detail::LzmaDecoder decoder(compressed);
+        // about 20 bytes per frame
+        size_t expected = decoder.reserve_size() / 20;
+        for (auto* v : {&replay.frames.time_delta, &replay.frames.time})
+            v->reserve(expected);
+        replay.frames.x.reserve(expected);
+        replay.frames.y.reserve(expected);
+        replay.frames.keys.reserve(expected);
+        detail::ReplayFrameParser frameParser(replay);
+        decoder.decode([&](std::string_view chunk) { frameParser.feed(chunk); });
+        frameParser.finish();
+    }
+
+    static void parse_life_bar(Replay& replay, std::string_view data)
+    {
+        while (auto point = try_take_column(data, ','))
+        {
+            auto p = trim_space(*point);
+            if (p.empty())
+                continue;
+            // "time|life", written "u/v" in places
+            size_t separator = p.find_first_of("|/");
+            LifeBarPoint l;
+            if (separator == std::string_view::npos || !read_number(l.time, p.substr(0, separator)) || !read_number(l.life, p.substr(separator + 1)))
+                throw parse_error("Invalid life bar in replay", parse_error_code::invalid_number);
+            replay.life_bar.push_back(l);
+        }
+    }
+
+    std::unique_ptr<MappedFile> file_;
+    std::string_view data_;
+};
+
+}
@@ -4,6 +4,7 @@
 
 #include <cpposu/path.hpp>
 #include <cpposu/types.hpp>
+#include <cpposu/line_parser.hpp>
 
 #include <cmath>
 
@@ -11,8 +12,21 @@ namespace cpposu {
 
 
 
-inline std::optional<slider_type> try_parse_slider_type(std::string_view s)
+inline std::optional<slider_type> try_parse_slider_type(std::string_view s, int& degree)
 {
+    degree = 0;
+
+    // lazer writes B-splines as a bezier type followed by the degree, and falls back to bezier if the degree is invalid
+    if (s.size() > 1 && s[0] == char(slider_type::Bezier))
+    {
+        auto bspline_degree = read_number<int>(s.substr(1));
+        if (!bspline_degree || *bspline_degree <= 0)
+            return slider_type::Bezier;
+
+        degree = *bspline_degree;
+        return slider_type::BSpline;
+    }
+
     if (s.size() != 1) return {};
     slider_type result{s[0]};
     switch(result)
@@ -27,6 +41,12 @@ inline std::optional<slider_type> try_parse_slider_type(std::string_view s)
     }
 }
 
+inline std::optional<slider_type> try_parse_slider_type(std::string_view s)
+{
+    int degree;
+    return try_parse_slider_type(s, degree);
+}
+
 
 struct slider_data
 {
@@ -51,6 +71,7 @@ struct LegacyLastTickEvent
 struct Slider
 {
     slider_data data;
+    PathPrecision precision;
 
     template <typename OnEvent>
     void generate_hit_objects(TimingPoints& timing_points, int beatmap_version, OnEvent&& on_event)
@@ -82,8 +103,12 @@ struct Slider
             return;
         }
 
-        calculate_path();
-        calculate_distances();
+        count_slider_type();
+        {
+            CPPOSU_STAT_TIMER(slider_path_ns);
+            calculate_path();
+            calculate_distances();
+        }
         calculate_ticks();
 
         double slide_duration = tick_duration * path_length / tick_distance;
@@ -192,6 +217,19 @@ private:
         return {legacyLastTickTime, position(distance) };
     }
 
+    void count_slider_type()
+    {
+        switch (data.control_points.front().new_slider_type)
+        {
+        case slider_type::Linear: CPPOSU_STAT_ADD(sliders_linear, 1); break;
+        case slider_type::PerfectCircle: CPPOSU_STAT_ADD(sliders_perfect_circle, 1); break;
+        case slider_type::Bezier: CPPOSU_STAT_ADD(sliders_bezier, 1); break;
+        case slider_type::CentripetalCatmullRom: CPPOSU_STAT_ADD(sliders_catmull, 1); break;
+        case slider_type::BSpline: CPPOSU_STAT_ADD(sliders_bspline, 1); break;
+        default: break;
+        }
+    }
+
     void calculate_path()
     {
         auto begin = data.control_points.begin();
@@ -203,7 +241,7 @@ private:
             ++next;
             if (next==end || next->new_slider_type != slider_type::None) // reached new segment
             {
-                calculate_segment_path(path, {begin, next});
+                calculate_segment_path(path, {begin, next}, precision);
                 if (next==end)
                     break;
                 else
@@ -261,6 +299,7 @@ private:
     {
         // assume approximately equidistant points, linear search to find exact location and lerp
         size_t approx_location = (distance / path_length) * cumulative_distance.size();
+        CPPOSU_STAT_ADD(slider_position_lookups, 1);
 
         if (approx_location < cumulative_distance.size())
         {
@@ -268,6 +307,7 @@ private:
             {
                 for (size_t i=approx_location-1; i>=0 ; --i)
                 {
+                    CPPOSU_STAT_ADD(slider_position_scan_length, 1);
                     if (cumulative_distance[i]<distance)
                         return position(i,distance);
                 }
@@ -276,6 +316,7 @@ private:
             else {
                 for (size_t i=approx_location+1, end=cumulative_distance.size(); i<end ; ++i)
                 {
+                    CPPOSU_STAT_ADD(slider_position_scan_length, 1);
                     if (cumulative_distance[i]>distance)
                         return position(i-1,distance);
                 }
@@ -5,6 +5,13 @@
 
 #include <cpposu/types.hpp>
 
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+
 namespace cpposu {
 
 
@@ -51,6 +58,7 @@ inline std::vector<int> calculate_legacy_stack_heights(std::span<const HitObject
             if (hitObjects[j].time - *lastStackTime > time_threshold)
                 break;
 
+            CPPOSU_STAT_ADD(stacking_comparisons, 1);
             if ((currHitObject.position()-hitObjects[j].position()).squared_length() < d_squared)
             {
                 stackHeight++;
@@ -123,7 +131,7 @@ inline std::vector<int> calculate_stack_heights(std::span<const HitObject> hitOb
                     --n;
                 }
                 auto& objectN = hitObjects[n];
-
+                CPPOSU_STAT_ADD(stacking_comparisons, 1);
 
                 if (objectN.type == slider_head && (sliderEndPos - currentStackPos).squared_length() < d_squared)
                 {
@@ -177,6 +185,7 @@ inline std::vector<int> calculate_stack_heights(std::span<const HitObject> hitOb
                     // We are no longer within stacking range of the previous object.
                     break;
 
+                CPPOSU_STAT_ADD(stacking_comparisons, 1);
                 if ((endPosition - currentStackPosition).squared_length() < d_squared)
                 {
                     stackHeights[n] = ++stackHeight;
@@ -189,13 +198,449 @@ inline std::vector<int> calculate_stack_heights(std::span<const HitObject> hitOb
     return stackHeights;
 }
 
-inline void apply_stacking(std::span<HitObject> hitObjects, int beatmapVersion, double timeThreshold, float distanceThreshold, float stackOffset)
+namespace detail {
+
+// Minimum over index ranges of a fixed array, in O(log n).
+class RangeMin
 {
-    auto stackHeights = (beatmapVersion < 6)
-        ? calculate_legacy_stack_heights(hitObjects, timeThreshold, distanceThreshold)
-        : calculate_stack_heights(hitObjects, timeThreshold, distanceThreshold);
+public:
+    RangeMin() = default;
+    explicit RangeMin(std::span<const double> values):
+        size_(values.size()),
+        tree_(2*values.size())
+    {
+        std::copy(values.begin(), values.end(), tree_.begin()+size_);
+        for (size_t i = size_; i-- > 1;)
+            tree_[i] = std::min(tree_[2*i], tree_[2*i+1]);
+    }
 
-    int i=0;
+    // minimum of values [begin, end)
+    double min(size_t begin, size_t end) const
+    {
+        double result = INFINITY;
+        for (begin += size_, end += size_; begin < end; begin /= 2, end /= 2)
+        {
+            if (begin & 1) result = std::min(result, tree_[begin++]);
+            if (end & 1) result = std::min(result, tree_[--end]);
+        }
+        return result;
+    }
+
+private:
+    size_t size_ = 0;
+    std::vector<double> tree_;
+};
+
+// Uniform grid over the playfield. Each cell lists the indices of the entries inside it in ascending order, which
+// for hit objects is time order. Positions outside the playfield are clamped into the border cells.
+class PlayfieldGrid
+{
+public:
+    static constexpr float cell_size = 16;
+    static constexpr int columns = 512 / cell_size;
+    static constexpr int rows = 384 / cell_size;
+
+    PlayfieldGrid() = default;
+
+    // Indexes positions[i] for each i where include(i).
+    template<typename Include>
+    PlayfieldGrid(std::span<const Vector2> positions, Include&& include):
+        cell_begin_(columns*rows+1)
+    {
+        for (size_t i = 0; i < positions.size(); ++i)
+            if (include(i))
+                ++cell_begin_[cell(positions[i])+1];
+        for (size_t c = 1; c < cell_begin_.size(); ++c)
+            cell_begin_[c] += cell_begin_[c-1];
+
+        indices_.resize(cell_begin_.back());
+        std::vector<int> fill(cell_begin_.begin(), cell_begin_.end()-1);
+        for (size_t i = 0; i < positions.size(); ++i)
+            if (include(i))
+                indices_[fill[cell(positions[i])]++] = i;
+    }
+
+    // The largest index not above max_index of an entry which may be within distance of position, or -1.
+    int previous_candidate(Vector2 position, float distance, int max_index) const
+    {
+        // widened slightly, so rounding can't exclude an entry that is within distance
+        float reach = distance + 1;
+        int x_begin = column(position.X - reach), x_end = column(position.X + reach);
+        int y_begin = row(position.Y - reach), y_end = row(position.Y + reach);
+
+        int result = -1;
+        for (int y = y_begin; y <= y_end; ++y)
+        {
+            for (int x = x_begin; x <= x_end; ++x)
+            {
+                size_t c = y*columns + x;
+                auto begin = indices_.begin() + cell_begin_[c];
+                auto end = indices_.begin() + cell_begin_[c+1];
+                auto next = std::upper_bound(begin, end, max_index);
+                if (next != begin)
+                    result = std::max(result, *std::prev(next));
+            }
+        }
+        return result;
+    }
+
+private:
+    static int clamped_cell(float v, int count)
+    {
+        v *= 1 / cell_size;
+        return v >= 0 ? (v < count ? (int)v : count-1) : 0;
+    }
+    static int column(float x) { return clamped_cell(x, columns); }
+    static int row(float y) { return clamped_cell(y, rows); }
+    static size_t cell(Vector2 p) { return row(p.Y)*columns + column(p.X); }
+
+    std::vector<int> cell_begin_;
+    std::vector<int> indices_;
+};
+
+}
+
+struct StackingVariant
+{
+    double time_threshold;
+    float distance_threshold = 3;
+};
+
+// Spatio-temporal index over hit objects, giving identical stack heights to calculate_stack_heights while
+// only comparing against objects near the current stack.
+// The backwards walk for each stack first steps over the few preceding objects directly, which is all a typical
+// map needs. Past that, objects (a start event and the events following it) indexed by start and end position in
+// grids let it jump straight to the previous object that could stack, checking the skipped objects against the
+// time threshold all at once with the range minimum of their times.
+// The hit objects must outlive the index and not be modified.
+class StackingIndex
+{
+public:
+    // objects walked directly before falling back to the grids
+    static constexpr int direct_walk = 128;
+
+    explicit StackingIndex(std::span<const HitObject> hitObjects):
+        hit_objects_(hitObjects)
+    {
+        heads_.reserve(hitObjects.size());
+        types_.reserve(hitObjects.size());
+        starts_.reserve(hitObjects.size());
+        ends_.reserve(hitObjects.size());
+        start_times_.reserve(hitObjects.size());
+        end_times_.reserve(hitObjects.size());
+
+        for (int i = 0; i < (int)hitObjects.size(); ++i)
+        {
+            if (!is_start_event(hitObjects[i].type) && i > 0)
+                continue;
+
+            int end = i;
+            while (end+1 < (int)hitObjects.size() && !is_start_event(hitObjects[end+1].type))
+                ++end;
+
+            heads_.push_back(i);
+            types_.push_back(hitObjects[i].type);
+            starts_.push_back(hitObjects[i].position());
+            ends_.push_back(hitObjects[end].position());
+            start_times_.push_back(hitObjects[i].time);
+            end_times_.push_back(hitObjects[end].time);
+        }
+    }
+
+    StackingIndex(const StackingIndex&) = delete;
+    StackingIndex& operator=(const StackingIndex&) = delete;
+
+    std::span<const HitObject> hit_objects() const { return hit_objects_; }
+
+    std::vector<int> stack_heights(double time_threshold, float distance_threshold) const
+    {
+        std::vector<int> stackHeights(hit_objects_.size());
+        const Stack stacks[] = {{time_threshold, stackHeights.data()}};
+        std::vector<Stack> active;
+
+        // Reverse pass for stack calculation.
+        for (int object = heads_.size()-1; object > 0; object--)
+            walk(object, distance_threshold, stacks, active);
+        return stackHeights;
+    }
+
+    // Stack heights for each variant. The walk from an object compares against the same objects and makes the same
+    // decisions for every time threshold until it goes out of that threshold's range; only the stack heights read
+    // and written differ. So variants with the same distance threshold share one walk with the largest time
+    // threshold, which drops each smaller one where its own walk would have stopped.
+    std::vector<std::vector<int>> stack_heights(std::span<const StackingVariant> variants) const
+    {
+        std::vector<std::vector<int>> stackHeights(variants.size(), std::vector<int>(hit_objects_.size()));
+
+        // by distance threshold, then by descending time threshold
+        std::vector<size_t> order(variants.size());
+        for (size_t v = 0; v < order.size(); ++v)
+            order[v] = v;
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            if (variants[a].distance_threshold != variants[b].distance_threshold)
+                return variants[a].distance_threshold < variants[b].distance_threshold;
+            return variants[a].time_threshold > variants[b].time_threshold;
+        });
+
+        std::vector<Stack> stacks;
+        std::vector<size_t> groupBegin;
+        for (size_t k = 0; k < order.size(); ++k)
+        {
+            const auto& variant = variants[order[k]];
+            if (k == 0 || variant.distance_threshold != variants[order[k-1]].distance_threshold)
+                groupBegin.push_back(k);
+            stacks.push_back({variant.time_threshold, stackHeights[order[k]].data()});
+        }
+        groupBegin.push_back(order.size());
+
+        std::vector<Stack> active;
+        for (int object = heads_.size()-1; object > 0; object--)
+            for (size_t g = 0; g + 1 < groupBegin.size(); ++g)
+            {
+                std::span<const Stack> group(stacks.begin() + groupBegin[g], stacks.begin() + groupBegin[g+1]);
+                walk(object, variants[order[groupBegin[g]]].distance_threshold, group, active);
+            }
+        return stackHeights;
+    }
+
+private:
+    // The stack heights of one time threshold.
+    struct Stack
+    {
+        double time_threshold;
+        int* heights;
+    };
+
+    // code/comments based on OsuBeatmapProcessor.cs: private void applyStacking(Beatmap<OsuHitObject> beatmap, int startIndex, int endIndex)
+    // One iteration of the reverse pass, stacking onto the given object, for stacks in descending order of time
+    // threshold. Those that already stacked the object sit it out; active is scratch space for the rest.
+    void walk(int object, float distance_threshold, std::span<const Stack> stacks, std::vector<Stack>& active) const
+    {
+        float d_squared = distance_threshold * distance_threshold;
+
+        int i = heads_[object];
+        if (!is_target_circle(types_[object])) return;
+        active.clear();
+        for (const auto& stack : stacks)
+            if (stack.heights[i] == 0)
+                active.push_back(stack);
+        if (active.empty()) return;
+
+        // Index of the next (earlier) object to consider.
+        int n = object - 1;
+
+        if (types_[object] == HitObjectType::circle)
+        {
+            Vector2 currentStackPos = starts_[object];
+            double currentStackTime = start_times_[object];
+
+            auto is_candidate = [&](int k) {
+                CPPOSU_STAT_ADD(stacking_comparisons, 1);
+                return (types_[k] == slider_head && (ends_[k] - currentStackPos).squared_length() < d_squared)
+                    || (is_target_circle(types_[k]) && (starts_[k] - currentStackPos).squared_length() < d_squared);
+            };
+            auto grid_candidate = [&](int k) {
+                return std::max(
+                    grids().starts.previous_candidate(currentStackPos, distance_threshold, k),
+                    grids().ends.previous_candidate(currentStackPos, distance_threshold, k));
+            };
+
+            int currentStackHeight = 0;
+            while ((n = previous_candidate(n, currentStackTime, active, end_times_, &Grids::end_time_min, is_candidate, grid_candidate)) >= 0)
+            {
+                Vector2 sliderEndPos = ends_[n];
+
+                if (types_[n] == slider_head && (sliderEndPos - currentStackPos).squared_length() < d_squared)
+                {
+                    for (const auto& stack : active)
+                    {
+                        int offset = currentStackHeight - stack.heights[heads_[n]] + 1;
+
+                        for (int j = n + 1; j <= object; j++)
+                        {
+                            // For each object which was declared under this slider, we will offset it to appear *below* the slider end (rather than above).
+                            if (is_target_circle(types_[j]) && (sliderEndPos - starts_[j]).squared_length() < d_squared)
+                                stack.heights[heads_[j]] -= offset;
+                        }
+                    }
+
+                    // We have hit a slider.  We should restart calculation using this as the new base.
+                    // Breaking here will mean that the slider still has StackCount of 0, so will be handled in the i-outer-loop.
+                    break;
+                }
+                else if (is_target_circle(types_[n]))
+                {
+                    if ((starts_[n] - currentStackPos).squared_length() < d_squared)
+                    {
+                        ++currentStackHeight;
+                        for (const auto& stack : active)
+                            stack.heights[heads_[n]] = currentStackHeight;
+                        currentStackPos = starts_[n];
+                        currentStackTime = start_times_[n];
+                    }
+                }
+                --n;
+            }
+        }
+        else if (types_[object] == HitObjectType::slider_head)
+        {
+            int stackHeight = 0;
+            Vector2 currentStackPosition = starts_[object];
+            double currentStackTime = start_times_[object];
+
+            auto is_candidate = [&](int k) {
+                CPPOSU_STAT_ADD(stacking_comparisons, 1);
+                return (ends_[k] - currentStackPosition).squared_length() < d_squared;
+            };
+            auto grid_candidate = [&](int k) {
+                return grids().ends.previous_candidate(currentStackPosition, distance_threshold, k);
+            };
+
+            while ((n = previous_candidate(n, currentStackTime, active, start_times_, &Grids::start_time_min, is_candidate, grid_candidate)) >= 0)
+            {
+                if ((ends_[n] - currentStackPosition).squared_length() < d_squared)
+                {
+                    ++stackHeight;
+                    for (const auto& stack : active)
+                        stack.heights[heads_[n]] = stackHeight;
+                    currentStackPosition = starts_[n];
+                    currentStackTime = start_times_[n];
+                }
+                --n;
+            }
+        }
+    }
+
+    struct Grids
+    {
+        detail::PlayfieldGrid starts; // circles and slider heads by start position
+        detail::PlayfieldGrid ends; // all objects by end position
+        detail::RangeMin start_time_min, end_time_min;
+    };
+
+    // The object at or before n which may change the stack, or -1 once the walk is out of stacking range
+    // (an object's time is more than time_threshold before stack_time) or out of objects. Stacks out of range
+    // before that object are dropped from the back of active, which is in descending order of time threshold.
+    template<typename IsCandidate, typename GridCandidate>
+    int previous_candidate(int n, double stack_time, std::vector<Stack>& active,
+        const std::vector<double>& times, detail::RangeMin Grids::* time_min,
+        IsCandidate&& is_candidate, GridCandidate&& grid_candidate) const
+    {
+        auto drop_out_of_range = [&](double time) {
+            while (!active.empty() && stack_time - time > active.back().time_threshold)
+                active.pop_back();
+            return active.empty();
+        };
+
+        for (int end = std::max(n - direct_walk, -1); n > end; --n)
+        {
+            if (drop_out_of_range(times[n]))
+                return -1;
+            if (is_candidate(n))
+                return n;
+        }
+        if (n < 0)
+            return -1;
+
+        int candidate = grid_candidate(n);
+        if (candidate < 0 || drop_out_of_range((grids().*time_min).min(candidate, n+1)))
+            return -1;
+        return candidate;
+    }
+
+    std::span<const HitObject> hit_objects_;
+
+    // per object: its first event, and the position and time of its first and last event
+    std::vector<int> heads_;
+    std::vector<HitObjectType> types_;
+    std::vector<Vector2> starts_, ends_;
+    std::vector<double> start_times_, end_times_;
+
+    // Built on the first walk that outruns direct_walk, which typical maps never do.
+    const Grids& grids() const
+    {
+        std::call_once(grids_built_, [this] {
+            grids_ = std::make_unique<Grids>(Grids{
+                detail::PlayfieldGrid(starts_, [&](size_t k) { return is_target_circle(types_[k]); }),
+                detail::PlayfieldGrid(ends_, [](size_t) { return true; }),
+                detail::RangeMin(start_times_),
+                detail::RangeMin(end_times_),
+            });
+        });
+        return *grids_;
+    }
+
+    mutable std::once_flag grids_built_;
+    mutable std::unique_ptr<Grids> grids_;
+};
+
+inline std::vector<int> calculate_indexed_stack_heights(std::span<const HitObject> hitObjects, double time_threshold, float distance_threshold)
+{
+    return StackingIndex(hitObjects).stack_heights(time_threshold, distance_threshold);
+}
+
+// Mean number of events within time_threshold before an event, which bounds how far the reverse pass walks back
+// from it. Estimated from a few events spread over the map, searching for the start of each one's window, so that it
+// costs nothing next to the pass itself. Events are taken to be ordered by time.
+inline double mean_stacking_window(std::span<const HitObject> hitObjects, double time_threshold)
+{
+    constexpr size_t samples = 64;
+    const size_t n = std::min(samples, hitObjects.size());
+    double total = 0;
+    for (size_t s = 1; s <= n; ++s)
+    {
+        auto event = hitObjects.begin() + (hitObjects.size() - 1) * s / n;
+        auto first = std::partition_point(hitObjects.begin(), event, [&](const HitObject& h) { return event->time - h.time > time_threshold; });
+        total += event - first;
+    }
+    return n ? total / n : 0;
+}
+
+// Whether StackingIndex is faster than the plain reverse pass. The index walks the same objects directly up to
+// direct_walk back, so it only pays for building it once walks go well past that, which takes objects a millisecond
+// or two apart. In bench_pathological the index is slower up to a mean window of about 250 events, and twice as fast
+// at 800.
+inline bool prefer_stacking_index(std::span<const HitObject> hitObjects, double time_threshold)
+{
+    constexpr double min_mean_window = 3 * StackingIndex::direct_walk;
+    return mean_stacking_window(hitObjects, time_threshold) > min_mean_window;
+}
+
+// Stack heights for hit objects of a beatmap with the given version, which picks the algorithm.
+inline std::vector<int> calculate_stack_heights(std::span<const HitObject> hitObjects, int beatmapVersion, double timeThreshold, float distanceThreshold)
+{
+    CPPOSU_STAT_TIMER(stacking_ns);
+    if (beatmapVersion < 6)
+        return calculate_legacy_stack_heights(hitObjects, timeThreshold, distanceThreshold);
+    if (prefer_stacking_index(hitObjects, timeThreshold))
+        return calculate_indexed_stack_heights(hitObjects, timeThreshold, distanceThreshold);
+    return calculate_stack_heights(hitObjects, timeThreshold, distanceThreshold);
+}
+
+// Stack heights for several variants, e.g. the approach rates of different mods. Where the index pays off (see
+// prefer_stacking_index) they are computed together over one shared index, with one walk per object for the variants
+// of each distance threshold (see StackingIndex::stack_heights); otherwise, and for legacy maps (version < 6), each
+// variant has its own pass.
+inline std::vector<std::vector<int>> calculate_stack_heights(std::span<const HitObject> hitObjects, int beatmapVersion, std::span<const StackingVariant> variants)
+{
+    CPPOSU_STAT_TIMER(stacking_ns);
+    double maxTimeThreshold = 0;
+    for (const auto& variant : variants)
+        maxTimeThreshold = std::max(maxTimeThreshold, variant.time_threshold);
+    if (beatmapVersion >= 6 && prefer_stacking_index(hitObjects, maxTimeThreshold))
+        return StackingIndex(hitObjects).stack_heights(variants);
+
+    std::vector<std::vector<int>> stackHeights;
+    for (const auto& variant : variants)
+        stackHeights.push_back(beatmapVersion < 6
+            ? calculate_legacy_stack_heights(hitObjects, variant.time_threshold, variant.distance_threshold)
+            : calculate_stack_heights(hitObjects, variant.time_threshold, variant.distance_threshold));
+    return stackHeights;
+}
+
+// Moves every event of each object by its stack height times stackOffset.
+inline void apply_stack_offsets(std::span<HitObject> hitObjects, std::span<const int> stackHeights, float stackOffset)
+{
     float totalOffset = 0;
     for (int i=0; i<hitObjects.size(); ++i)
     {
@@ -208,16 +653,452 @@ inline void apply_stacking(std::span<HitObject> hitObjects, int beatmapVersion,
     }
 }
 
-inline void apply_stacking(Beatmap& b)
+inline void apply_stacking(std::span<HitObject> hitObjects, int beatmapVersion, double timeThreshold, float distanceThreshold, float stackOffset)
+{
+    auto stackHeights = calculate_stack_heights(hitObjects, beatmapVersion, timeThreshold, distanceThreshold);
+    apply_stack_offsets(hitObjects, stackHeights, stackOffset);
+}
+
+struct StackingParameters
+{
+    int version;
+    double time_threshold;
+    float distance_threshold;
+    float stack_offset;
+};
+
+inline double stacking_time_threshold(double approachRate, double stackLeniency)
+{
+    double time_preempt = (float)difficulty_range(approachRate, 1800, 1200, 450);
+    return time_preempt * stackLeniency;
+}
+
+inline float stack_offset_multiplier(float circleSize)
+{
+    float scale = (1.0f - 0.7f * (circleSize - 5) / 5) / 2;
+    return scale * -6.4f;
+}
+
+inline StackingParameters stacking_parameters(int version, const MapDifficultyAttributes& difficulty, float stackLeniency)
 {
     constexpr float distance_threshold=3;
 
-    double time_preempt = (float)difficulty_range(b.difficulty_attributes.ApproachRate, 1800, 1200, 450);
-    double time_threshold = time_preempt * b.info.StackLeniency;
+    double time_threshold = stacking_time_threshold(difficulty.ApproachRate, stackLeniency);
+    float stackOffsetMult = stack_offset_multiplier(difficulty.CircleSize);
 
-    float scale = (1.0f - 0.7f * (b.difficulty_attributes.CircleSize - 5) / 5) / 2;
-    float stackOffsetMult = scale * -6.4f;
+    return {version, time_threshold, distance_threshold, stackOffsetMult};
+}
 
-    apply_stacking(b.hit_objects,b.version,time_threshold,distance_threshold,stackOffsetMult);
+inline StackingParameters stacking_parameters(const Beatmap& b)
+{
+    return stacking_parameters(b.version, b.difficulty_attributes, b.info.StackLeniency);
 }
+
+inline void apply_stacking(Beatmap& b)
+{
+    auto params = stacking_parameters(b);
+    apply_stacking(b.hit_objects, params.version, params.time_threshold, params.distance_threshold, params.stack_offset);
+}
+
+// Unstacked hit objects with their stack heights, for editing a map and keeping the stacking up to date.
+// Each walk of the reverse pass in calculate_stack_heights records the lowest event whose data it read, and the
+// lowest event whose stack height it read or wrote. After an edit, the walks starting from the end of the map down
+// to the first one that read edited data stay the same, and below the edit the heights only change back to where
+// no walk from later objects touched an earlier stack height. Only the walks in between are rerun.
+// Legacy (version < 6) maps are recomputed whole on each update.
+class StackingState
+{
+public:
+    StackingState(std::vector<HitObject> hitObjects, const StackingParameters& parameters):
+        parameters_(parameters),
+        hit_objects_(std::move(hitObjects)),
+        stack_heights_(hit_objects_.size()),
+        data_low_(hit_objects_.size()),
+        state_low_(hit_objects_.size())
+    {
+        if (parameters_.version < 6)
+            stack_heights_ = calculate_legacy_stack_heights(hit_objects_, parameters_.time_threshold, parameters_.distance_threshold);
+        else
+            reverse_pass(0, hit_objects_.size(), 0);
+    }
+
+    // beatmap must not have had stacking applied
+    explicit StackingState(const Beatmap& beatmap):
+        StackingState(beatmap.hit_objects, stacking_parameters(beatmap))
+    {}
+
+    const StackingParameters& parameters() const { return parameters_; }
+    std::span<const HitObject> unstacked() const { return hit_objects_; }
+    // per event, nonzero only on start events
+    std::span<const int> stack_heights() const { return stack_heights_; }
+
+    HitObject stacked(size_t i) const
+    {
+        size_t head = i;
+        while (head > 0 && !is_start_event(hit_objects_[head].type))
+            --head;
+
+        HitObject result = hit_objects_[i];
+        float offset = stack_heights_[head] * parameters_.stack_offset;
+        result.x += offset;
+        result.y += offset;
+        return result;
+    }
+
+    std::vector<HitObject> stacked() const
+    {
+        std::vector<HitObject> result = hit_objects_;
+        apply_stack_offsets(result, stack_heights_, parameters_.stack_offset);
+        return result;
+    }
+
+    // Replaces the events [begin, end), which must be whole objects, by replacement.
+    // Returns the indices (after the edit) of the events whose stacked position changed or that were replaced.
+    std::vector<size_t> update(size_t begin, size_t end, std::span<const HitObject> replacement)
+    {
+        if (begin > end || end > hit_objects_.size() || !is_object_boundary(begin) || !is_object_boundary(end)
+            || (!replacement.empty() && !is_start_event(replacement.front().type)))
+            throw std::invalid_argument("stacking update must replace whole hit objects");
+
+        size_t replaced_end = begin + replacement.size();
+        std::ptrdiff_t growth = (std::ptrdiff_t)replacement.size() - (std::ptrdiff_t)(end - begin);
+
+        if (parameters_.version < 6)
+        {
+            std::vector<int> old_heights = stack_heights_;
+            splice(hit_objects_, begin, end, replacement);
+            stack_heights_ = calculate_legacy_stack_heights(hit_objects_, parameters_.time_threshold, parameters_.distance_threshold);
+            return changed_events(0, hit_objects_.size(), begin, replaced_end, growth,
+                [&](size_t old) { return old_heights[old]; });
+        }
+
+        // The first object from which on no walk read edited data or a stack height before the object.
+        size_t window_end = hit_objects_.size();
+        size_t min_data = SIZE_MAX, min_state = SIZE_MAX;
+        for (size_t i = hit_objects_.size(); i-- > end;)
+        {
+            min_data = std::min(min_data, data_low_[i]);
+            min_state = std::min(min_state, state_low_[i]);
+            if (min_data < end)
+                break;
+            if (is_start_event(hit_objects_[i].type) && min_state >= i)
+                window_end = i;
+        }
+
+        // The last object before which no walk from it on touched a stack height.
+        min_state = SIZE_MAX;
+        for (size_t i = begin; i < hit_objects_.size(); ++i)
+            min_state = std::min(min_state, state_low_[i]);
+        size_t window_begin = begin;
+        auto extend_window_begin = [&] {
+            do
+            {
+                --window_begin;
+                min_state = std::min(min_state, state_low_[window_begin]);
+            } while (!(is_object_boundary(window_begin) && min_state >= window_begin));
+        };
+        if (!(is_object_boundary(begin) && min_state >= begin))
+            extend_window_begin();
+
+        std::vector<int> old_heights(stack_heights_.begin() + window_begin, stack_heights_.begin() + window_end);
+        size_t old_window_begin = window_begin;
+
+        splice(hit_objects_, begin, end, replacement);
+        splice(stack_heights_, begin, end, std::vector<int>(replacement.size()));
+        splice(data_low_, begin, end, std::vector<size_t>(replacement.size()));
+        splice(state_low_, begin, end, std::vector<size_t>(replacement.size()));
+        window_end += growth;
+        for (size_t i = window_end; i < hit_objects_.size(); ++i)
+        {
+            data_low_[i] += growth;
+            state_low_[i] += growth;
+        }
+
+        // Rerun the walks in the window, moving its start back while they reach before it.
+        for (;;)
+        {
+            std::fill(stack_heights_.begin() + window_begin, stack_heights_.begin() + window_end, 0);
+            if (reverse_pass(window_begin, window_end, window_begin))
+                break;
+
+            size_t previous_begin = window_begin;
+            extend_window_begin();
+            old_heights.insert(old_heights.begin(), stack_heights_.begin() + window_begin, stack_heights_.begin() + previous_begin);
+            old_window_begin = window_begin;
+        }
+
+        return changed_events(window_begin, window_end, begin, replaced_end, growth,
+            [&](size_t old) { return old_heights[old - old_window_begin]; });
+    }
+
+private:
+    bool is_object_boundary(size_t i) const
+    {
+        return i == 0 || i == hit_objects_.size() || is_start_event(hit_objects_[i].type);
+    }
+
+    template<typename T, typename Replacement>
+    static void splice(std::vector<T>& v, size_t begin, size_t end, const Replacement& replacement)
+    {
+        size_t common = std::min(end - begin, (size_t)replacement.size());
+        std::copy_n(replacement.begin(), common, v.begin() + begin);
+        if (common < end - begin)
+            v.erase(v.begin() + begin + common, v.begin() + end);
+        else
+            v.insert(v.begin() + end, replacement.begin() + common, replacement.end());
+    }
+
+    // Events in [first, last) that were replaced, or whose object's height differs from old_height at its index
+    // before the edit.
+    template<typename OldHeight>
+    std::vector<size_t> changed_events(size_t first, size_t last, size_t begin, size_t replaced_end, std::ptrdiff_t growth, OldHeight&& old_height) const
+    {
+        std::vector<size_t> changed;
+        bool height_changed = false;
+        for (size_t i = first; i < last; ++i)
+        {
+            if (i >= begin && i < replaced_end)
+            {
+                changed.push_back(i);
+                continue;
+            }
+            if (is_start_event(hit_objects_[i].type))
+                height_changed = stack_heights_[i] != old_height(i < begin ? i : i - growth);
+            if (height_changed)
+                changed.push_back(i);
+        }
+        return changed;
+    }
+
+    // code/comments based on OsuBeatmapProcessor.cs: private void applyStacking(Beatmap<OsuHitObject> beatmap, int startIndex, int endIndex)
+    // The walks of calculate_stack_heights from the objects in [first, last), recording how far back each one reached.
+    // Returns false, leaving the heights before floor untouched, if a walk would touch one of them.
+    bool reverse_pass(size_t first, size_t last, size_t floor)
+    {
+        const auto& hitObjects = hit_objects_;
+        auto& stackHeights = stack_heights_;
+        const double time_threshold = parameters_.time_threshold;
+        const float d_squared = parameters_.distance_threshold * parameters_.distance_threshold;
+
+        for (int i = (int)last-1; i >= (int)first; i--)
+        {
+            int n = i;
+            data_low_[i] = state_low_[i] = i;
+
+            const HitObject& objectI = hitObjects[i];
+            if (i == 0 || stackHeights[i] != 0 || !is_target_circle(objectI.type)) continue;
+
+            if (objectI.type == HitObjectType::circle)
+            {
+                Vector2 sliderEndPos{};
+                Vector2 currentStackPos=objectI.position();
+                double currentStackTime=objectI.time;
+
+                int currentStackHeight = 0;
+                while (--n >= 0)
+                {
+                    data_low_[i] = n;
+                    if (currentStackTime - hitObjects[n].time > time_threshold)
+                        // We are no longer within stacking range of the previous object.
+                        break;
+
+                    if (hitObjects[n].type == slider_tail)
+                        sliderEndPos = hitObjects[n].position();
+
+                    while (!is_start_event(hitObjects[n].type) && n>0)
+                    {
+                        // skip to start event
+                        --n;
+                    }
+                    data_low_[i] = n;
+                    auto& objectN = hitObjects[n];
+
+                    if (objectN.type == slider_head && (sliderEndPos - currentStackPos).squared_length() < d_squared)
+                    {
+                        if (n < (int)floor)
+                            return false;
+                        state_low_[i] = n;
+
+                        int offset = currentStackHeight - stackHeights[n] + 1;
+
+                        for (int j = n + 1; j <= i; j++)
+                        {
+                            // For each object which was declared under this slider, we will offset it to appear *below* the slider end (rather than above).
+                            if (is_target_circle(hitObjects[j].type) && (sliderEndPos - hitObjects[j].position()).squared_length() < d_squared)
+                                stackHeights[j] -= offset;
+                        }
+
+                        // We have hit a slider.  We should restart calculation using this as the new base.
+                        // Breaking here will mean that the slider still has StackCount of 0, so will be handled in the i-outer-loop.
+                        break;
+                    }
+                    else if (is_target_circle(objectN.type))
+                    {
+                        if ((objectN.position() - currentStackPos).squared_length() < d_squared)
+                        {
+                            if (n < (int)floor)
+                                return false;
+                            state_low_[i] = n;
+
+                            stackHeights[n] = ++currentStackHeight;
+                            currentStackPos = objectN.position();
+                            currentStackTime = objectN.time;
+                        }
+                    }
+                }
+            }
+            else if (objectI.type == HitObjectType::slider_head)
+            {
+                int stackHeight=0;
+                auto currentStackPosition=objectI.position();
+                auto currentStackTime = objectI.time;
+                while (--n >= 0)
+                {
+                    Vector2 endPosition = hitObjects[n].position();
+                    while (!is_start_event(hitObjects[n].type) && n>0)
+                    {
+                        // skip to start event
+                        --n;
+                    }
+                    data_low_[i] = n;
+                    auto& objectN = hitObjects[n];
+
+                    if (currentStackTime - objectN.time > time_threshold)
+                        // We are no longer within stacking range of the previous object.
+                        break;
+
+                    if ((endPosition - currentStackPosition).squared_length() < d_squared)
+                    {
+                        if (n < (int)floor)
+                            return false;
+                        state_low_[i] = n;
+
+                        stackHeights[n] = ++stackHeight;
+                        currentStackPosition=objectN.position();
+                        currentStackTime = objectN.time;
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+    StackingParameters parameters_;
+    std::vector<HitObject> hit_objects_;
+    std::vector<int> stack_heights_;
+
+    // per event, for the walk starting there: the lowest event whose data it read, and whose stack height it read or wrote
+    std::vector<size_t> data_low_;
+    std::vector<size_t> state_low_;
+};
+
+// Stacks a stream of hit object events in time order while only buffering a bounded part of it.
+// Nothing after a start more than time_threshold past the latest event before it stacks with anything before it, so
+// the buffer is stacked and emitted at each such gap, exactly as stacking the whole map would.
+// Dense maps may go on without a gap for longer than max_buffered events. Then the older half of the buffer is
+// stacked and emitted early, keeping up to max_buffered/2 emitted events as context for the rest. That is only
+// approximate: a chain of stacked objects reaching across the cut could have changed the emitted heights, or the
+// heights after it. push() returns false on each such cut, or throws std::length_error instead if the stacker was made
+// with requireExact. A context shorter than the events within time_threshold of each other makes deviations likely:
+// on dense_stream_preset, circles 1ms apart with a threshold of 420ms, max_buffered = 256 moves stacks by up to about
+// 50px, while 4096 still matches stacking the whole map.
+class StreamingStacker
+{
+public:
+    static constexpr size_t default_max_buffered = 1 << 14;
+
+    explicit StreamingStacker(const StackingParameters& parameters, size_t max_buffered = default_max_buffered, bool requireExact = false):
+        parameters_(parameters),
+        max_buffered_(std::max<size_t>(max_buffered, 2)),
+        require_exact_(requireExact)
+    {}
+
+    // Adds the next event. Returns false if the buffer was full and its older half was emitted without a gap, so that
+    // the events emitted may differ from stacking the whole map.
+    bool push(const HitObject& h)
+    {
+        bool cut = false;
+        if (is_start_event(h.type) && !buffer_.empty())
+        {
+            if (h.time - max_time_ > parameters_.time_threshold)
+            {
+                flush(buffer_.size());
+                buffer_.clear();
+                context_ = 0;
+            }
+            else if (buffer_.size() - context_ >= max_buffered_)
+            {
+                if (require_exact_)
+                    throw std::length_error("StreamingStacker: more than max_buffered events without a gap");
+                flush_older_half();
+                cut = true;
+            }
+        }
+        buffer_.push_back(h);
+        max_time_ = std::max(max_time_, h.time);
+        return !cut;
+    }
+
+    // Emits everything still buffered, at the end of the stream.
+    void finish()
+    {
+        flush(buffer_.size());
+        buffer_.clear();
+        context_ = 0;
+        max_time_ = -INFINITY;
+    }
+
+    // Takes the stacked events emitted so far, in order.
+    std::vector<HitObject> take() { return std::exchange(ready_, {}); }
+
+    // Whether all events were emitted at gaps, making the output identical to stacking the whole map at once, i.e. every
+    // push() returned true.
+    bool exact() const { return exact_; }
+
+private:
+    // Stacks the buffer and emits the events from context_ to end.
+    void flush(size_t end)
+    {
+        auto stackHeights = calculate_stack_heights(buffer_, parameters_.version, parameters_.time_threshold, parameters_.distance_threshold);
+
+        float totalOffset = 0;
+        for (size_t i = context_; i < end; ++i)
+        {
+            if (is_start_event(buffer_[i].type))
+                totalOffset = stackHeights[i] * parameters_.stack_offset;
+            HitObject h = buffer_[i];
+            h.x += totalOffset;
+            h.y += totalOffset;
+            ready_.push_back(h);
+        }
+    }
+
+    void flush_older_half()
+    {
+        exact_ = false;
+
+        size_t end = context_ + (buffer_.size() - context_) / 2;
+        while (end < buffer_.size() && !is_start_event(buffer_[end].type))
+            ++end;
+        flush(end);
+
+        size_t keep = end > max_buffered_/2 ? end - max_buffered_/2 : 0;
+        while (keep > 0 && !is_start_event(buffer_[keep].type))
+            --keep;
+        buffer_.erase(buffer_.begin(), buffer_.begin() + keep);
+        context_ = end - keep;
+    }
+
+    StackingParameters parameters_;
+    size_t max_buffered_;
+    bool require_exact_;
+
+    // events [0, context_) were already emitted, and are only kept for stacking the ones after them
+    std::vector<HitObject> buffer_;
+    size_t context_ = 0;
+    double max_time_ = -INFINITY;
+
+    std::vector<HitObject> ready_;
+    bool exact_ = true;
+};
 }
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+// Hot-path counters and timers, compiled in only if CPPOSU_ENABLE_STATS is 1 (e.g. with the CMake option of the
+// same name). Otherwise the CPPOSU_STAT_* macros expand to empty statements, their arguments aren't evaluated, and
+// StatsScope is empty, so stats cost nothing. The same value must be used throughout a program.
+#ifndef CPPOSU_ENABLE_STATS
+#define CPPOSU_ENABLE_STATS 0
+#endif
+
+namespace cpposu {
+
+constexpr bool stats_enabled = CPPOSU_ENABLE_STATS;
+
+// What parsing (or anything else run in a StatsScope) did, for finding out why a map is slow. All zero unless
+// stats_enabled.
+struct ParseStats
+{
+    uint64_t lines_read = 0;
+    // bytes of the lines read, including line ends
+    uint64_t bytes_scanned = 0;
+
+    // sliders by the type of their first segment
+    uint64_t sliders_linear = 0;
+    uint64_t sliders_perfect_circle = 0;
+    uint64_t sliders_bezier = 0;
+    uint64_t sliders_catmull = 0;
+    uint64_t sliders_bspline = 0;
+
+    uint64_t bezier_flatness_tests = 0;
+    uint64_t bezier_subdivisions = 0;
+    uint64_t arena_grows = 0;
+
+    // Slider::position lookups, and the entries of cumulative_distance they stepped over
+    uint64_t slider_position_lookups = 0;
+    uint64_t slider_position_scan_length = 0;
+
+    // hit objects compared against a stack by the stacking passes
+    uint64_t stacking_comparisons = 0;
+
+    // wall time
+    uint64_t parse_ns = 0;
+    uint64_t slider_path_ns = 0;
+    uint64_t stacking_ns = 0;
+
+    ParseStats& operator+=(const ParseStats& other)
+    {
+        lines_read += other.lines_read;
+        bytes_scanned += other.bytes_scanned;
+        sliders_linear += other.sliders_linear;
+        sliders_perfect_circle += other.sliders_perfect_circle;
+        sliders_bezier += other.sliders_bezier;
+        sliders_catmull += other.sliders_catmull;
+        sliders_bspline += other.sliders_bspline;
+        bezier_flatness_tests += other.bezier_flatness_tests;
+        bezier_subdivisions += other.bezier_subdivisions;
+        arena_grows += other.arena_grows;
+        slider_position_lookups += other.slider_position_lookups;
+        slider_position_scan_length += other.slider_position_scan_length;
+        stacking_comparisons += other.stacking_comparisons;
+        parse_ns += other.parse_ns;
+        slider_path_ns += other.slider_path_ns;
+        stacking_ns += other.stacking_ns;
+        return *this;
+    }
+
+    bool operator==(const ParseStats&) const = default;
+};
+
+#if CPPOSU_ENABLE_STATS
+
+namespace detail {
+
+// where the CPPOSU_STAT_* macros on this thread count, if anywhere
+inline thread_local ParseStats* active_stats = nullptr;
+
+// Adds the time until it is destroyed to a ParseStats field.
+class StatsTimer
+{
+public:
+    explicit StatsTimer(uint64_t ParseStats::* field):
+        field_(field),
+        start_(std::chrono::steady_clock::now())
+    {}
+
+    ~StatsTimer()
+    {
+        if (active_stats)
+            active_stats->*field_ += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_).count();
+    }
+
+    StatsTimer(const StatsTimer&) = delete;
+
+private:
+    uint64_t ParseStats::* field_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+}
+
+// Counts what runs on this thread while it exists into stats. Scopes nest; the innermost one counts.
+class StatsScope
+{
+public:
+    explicit StatsScope(ParseStats& stats):
+        previous_(detail::active_stats)
+    {
+        detail::active_stats = &stats;
+    }
+    ~StatsScope() { detail::active_stats = previous_; }
+
+    StatsScope(const StatsScope&) = delete;
+
+private:
+    ParseStats* previous_;
+};
+
+#define CPPOSU_STAT_ADD(field, n) do { if (auto* cpposu_stats_ = ::cpposu::detail::active_stats) cpposu_stats_->field += (n); } while (0)
+#define CPPOSU_STAT_TIMER(field) ::cpposu::detail::StatsTimer cpposu_stats_timer_##field(&::cpposu::ParseStats::field)
+
+#else
+
+class StatsScope
+{
+public:
+    explicit StatsScope(ParseStats&) {}
+    StatsScope(const StatsScope&) = delete;
+};
+
+#define CPPOSU_STAT_ADD(field, n) do {} while (0)
+#define CPPOSU_STAT_TIMER(field) do {} while (0)
+
+#endif
+
+}
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cpposu/stats.hpp>
+
 #include <algorithm>
 #include <math.h>
 #include <stdexcept>
@@ -154,12 +156,19 @@ struct TimingPoint
     uint64_t effects{};
 };
 
+/// The beat length and slider velocity in effect from a point in time onwards.
+struct TimingState
+{
+    double time;
+    double beatLength;
+    double sliderVelocityMultiplier;
+};
+
 struct TimingPoints
 {
     static constexpr double default_beat_length = 60000.0 / 60.0;
     std::vector<TimingPoint> points;
     double currentTime=-INFINITY;
-    size_t nextIndex=0;
     double currentBeatLength=default_beat_length;
     double currentSliderVelocityMultiplier=1;
     double baseSliderVelocity=1;
@@ -180,34 +189,77 @@ struct TimingPoints
     void applyDefaults()
     {
         if (points.size()>0) currentBeatLength = points[0].beatLength;
+        buildStates();
     }
-    void advanceTime(double time)
+
+    /// Precomputes the timing state after each group of timing points sharing a time,
+    /// so that it can be looked up at any time rather than only sequentially.
+    void buildStates()
     {
-        if (currentTime > time)
-        {
-            throw std::runtime_error("Time points accessed non-sequentially, probably an aspire map");
-        }
-        currentTime=time;
-        while(nextIndex < points.size() && points[nextIndex].time <= time)
+        states.clear();
+        initialBeatLength = points.size()>0 ? points[0].beatLength : default_beat_length;
+
+        double beatLength = initialBeatLength;
+        double sliderVelocityMultiplier = 1;
+
+        // Points are applied in file order, so a point can't take effect before any point listed ahead of it.
+        double activationTime = -INFINITY;
+
+        size_t index = 0;
+        while(index < points.size())
         {
-            double currentTime = points[nextIndex].time;
-            currentSliderVelocityMultiplier=1;
+            double groupTime = points[index].time;
+            activationTime = std::max(activationTime, groupTime);
+            sliderVelocityMultiplier=1;
 
             do
             {
-                size_t currentIndex = nextIndex;
-                nextIndex++;
-                if (points[currentIndex].timing_change)
+                const auto& point = points[index];
+                index++;
+                if (point.timing_change)
                 {
-                    currentBeatLength = std::clamp(points[currentIndex].beatLength, 6.0, 60000.0);
+                    beatLength = std::clamp(point.beatLength, 6.0, 60000.0);
                 }
-                else if (points[currentIndex].beatLength < 0)
+                else if (point.beatLength < 0)
                 {
-                    currentSliderVelocityMultiplier = std::clamp(-100/points[currentIndex].beatLength, 0.1, 10.0);
+                    sliderVelocityMultiplier = std::clamp(-100/point.beatLength, 0.1, 10.0);
                 }
-            } while(nextIndex < points.size() && points[nextIndex].time == currentTime);
+            } while(index < points.size() && points[index].time == groupTime);
+
+            states.push_back({activationTime, beatLength, sliderVelocityMultiplier});
         }
+        statesPointCount = points.size();
+    }
+
+    /// Looks up the timing state in effect at a time, in O(log n).
+    TimingState stateAt(double time) const
+    {
+        auto next = std::upper_bound(states.begin(), states.end(), time,
+            [](double t, const TimingState& state) { return t < state.time; });
+        if (next == states.begin())
+            return {-INFINITY, initialBeatLength, 1};
+        return *std::prev(next);
     }
+
+    /// Sets the current beat length and slider velocity to those in effect at a time.
+    /// Times may be visited in any order.
+    void advanceTime(double time)
+    {
+        if (statesPointCount != points.size())
+            buildStates();
+
+        TimingState state = stateAt(time);
+        currentTime = time;
+        currentBeatLength = state.beatLength;
+        currentSliderVelocityMultiplier = state.sliderVelocityMultiplier;
+    }
+
+    std::span<const TimingState> timingStates() const { return states; }
+
+private:
+    std::vector<TimingState> states;
+    size_t statesPointCount = 0;
+    double initialBeatLength = default_beat_length;
 };
 
 enum HitObjectTypeFlags
@@ -232,6 +284,33 @@ inline std::ostream& operator <<(std::ostream& os, const HitObject& h)
     return os << "HitObject( " << h.type << " x=" << h.x << " y=" << h.y << " time=" << h.time << ")";
 }
 
+// Hit objects as one array per field, e.g. for handing out to columnar consumers.
+struct HitObjectColumns
+{
+    std::vector<uint8_t> type;
+    std::vector<float> x, y;
+    std::vector<double> time;
+
+    size_t size() const { return time.size(); }
+};
+
+inline HitObjectColumns to_columns(std::span<const HitObject> hitObjects)
+{
+    HitObjectColumns columns;
+    columns.type.resize(hitObjects.size());
+    columns.x.resize(hitObjects.size());
+    columns.y.resize(hitObjects.size());
+    columns.time.resize(hitObjects.size());
+    for (size_t i = 0; i < hitObjects.size(); ++i)
+    {
+        columns.type[i] = hitObjects[i].type;
+        columns.x[i] = hitObjects[i].x;
+        columns.y[i] = hitObjects[i].y;
+        columns.time[i] = hitObjects[i].time;
+    }
+    return columns;
+}
+
 struct Beatmap
 {
     static constexpr int FIRST_LAZER_VERSION = 128;
@@ -250,12 +329,14 @@ enum class slider_type
     CentripetalCatmullRom='C',
     Linear='L',
     PerfectCircle='P',
+    BSpline='b', // written as 'B' followed by the degree, e.g. "B3"
 };
 
 struct SliderControlPoint
 {
     slider_type new_slider_type = slider_type::None;
     Vector2 position;
+    int degree = 0; // only used by slider_type::BSpline
 };
 
 
@@ -267,6 +348,7 @@ class Arena
 
     void grow(size_t required_size)
     {
+        CPPOSU_STAT_ADD(arena_grows, 1);
         size = std::max(2*size, required_size);
         allocations.emplace_back(std::make_unique<T[]>(size));
         available = {allocations.back().get(), size};
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace cpposu::bench {
+
+// Runs f repeatedly for at least min_seconds and returns the mean time per run in seconds.
+template <typename F>
+double time_per_run(F&& f, double min_seconds = 0.25)
+{
+    using clock = std::chrono::steady_clock;
+    size_t runs = 0;
+    auto start = clock::now();
+    std::chrono::duration<double> elapsed{};
+    do
+    {
+        f();
+        ++runs;
+        elapsed = clock::now() - start;
+    } while (elapsed.count() < min_seconds);
+
+    return elapsed.count() / runs;
+}
+
+inline std::string read_file(const std::string& filename)
+{
+    std::ifstream file(filename, std::ios::binary);
+    if (!file)
+        throw std::runtime_error("Failed to open " + filename);
+    std::ostringstream ss;
+    ss << file.rdbuf();
+    return ss.str();
+}
+
+struct BenchmarkInput
+{
+    std::string filename;
+    std::string contents;
+};
+
+// A timed case and its results, mostly throughputs (per second, e.g. "MB/s"), as printed and written with --json.
+struct Measurement
+{
+    std::string benchmark;
+    std::string name;
+    double seconds;
+    std::vector<std::pair<std::string, double>> rates;
+};
+
+inline std::vector<Measurement>& measurements()
+{
+    static std::vector<Measurement> all;
+    return all;
+}
+
+// Prints the measurement as a row and keeps it for the JSON output.
+inline void report(Measurement m)
+{
+    std::cout << std::fixed << std::setprecision(3) << std::setw(24) << m.name << std::setw(12) << m.seconds * 1e6 << " us";
+    for (const auto& [unit, rate] : m.rates)
+        std::cout << std::setw(14) << std::setprecision(rate < 100 ? 3 : 0) << rate << " " << unit;
+    std::cout << "\n";
+    measurements().push_back(std::move(m));
+}
+
+inline void write_json(std::ostream& os, const std::vector<Measurement>& all)
+{
+    auto quoted = [](const std::string& s) {
+        std::string result = "\"";
+        for (char c : s)
+        {
+            if (c == '"' || c == '\\')
+                result += '\\';
+            result += c;
+        }
+        return result + '"';
+    };
+
+    os << "[\n";
+    for (size_t i = 0; i < all.size(); ++i)
+    {
+        const auto& m = all[i];
+        os << "  {\"benchmark\": " << quoted(m.benchmark) << ", \"name\": " << quoted(m.name)
+            << ", \"seconds\": " << std::setprecision(9) << std::scientific << m.seconds << std::defaultfloat;
+        for (const auto& [unit, rate] : m.rates)
+            os << ", " << quoted(unit) << ": " << std::setprecision(9) << rate;
+        os << (i + 1 < all.size() ? "},\n" : "}\n");
+    }
+    os << "]\n";
+}
+
+void bench_path_precision(const std::vector<BenchmarkInput>& inputs);
+void bench_mods(const std::vector<BenchmarkInput>& inputs);
+void bench_throughput(const std::vector<BenchmarkInput>& inputs);
+void bench_scaling(const std::vector<BenchmarkInput>& inputs);
+void bench_pathological(const std::vector<BenchmarkInput>& inputs);
+void bench_evaluators(const std::vector<BenchmarkInput>& inputs);
+
+}
@@ -0,0 +1,52 @@
+#include "bench.hpp"
+#include "synthetic_beatmap.hpp"
+
+#include <cpposu/beatmap_parser.hpp>
+#include <cpposu/difficulty.hpp>
+
+namespace cpposu::bench {
+
+// The aim and speed evaluators run per object, as the strain timeline does, against the column kernels that
+// calculate_difficulty runs over all objects at once, and calculate_difficulty itself, on a generated 200 BPM stream.
+void bench_evaluators(const std::vector<BenchmarkInput>&)
+{
+    auto contents = synthetic::generate_beatmap(synthetic::dense_stream_200bpm_preset(7));
+    auto beatmap = BeatmapParser(contents.data(), contents.size()).parse();
+
+    auto row = [&](const std::string& name, Mods mods) {
+        std::vector<HitObject> hitObjects(beatmap.hit_objects.size());
+        auto difficulty = apply_mods(beatmap, mods, hitObjects);
+        auto d = detail::difficulty_geometry(hitObjects, difficulty);
+        detail::set_rate(d, difficulty, 1, mod_rate(mods));
+
+        std::vector<double> withSliders(d.size()), withoutSliders(d.size()), speed(d.size());
+        detail::RhythmPairs pairs;
+        pairs.update(d);
+
+        const double objects = (double) d.size();
+        auto add = [&](const std::string& evaluator, double seconds) {
+            report({"evaluators", name + "_" + evaluator, seconds, {{"objects/s", objects / seconds}, {"ns/object", seconds * 1e9 / objects}}});
+        };
+        add("aim_per_object", time_per_run([&] {
+            for (size_t k = 0; k < d.size(); ++k)
+            {
+                withSliders[k] = detail::aim_at(d, k, true);
+                withoutSliders[k] = detail::aim_at(d, k, false);
+            }
+        }));
+        add("aim_columns", time_per_run([&] { detail::evaluate_aim(d, withSliders, withoutSliders); }));
+        add("speed_per_object", time_per_run([&] {
+            for (size_t k = 0; k < d.size(); ++k)
+                speed[k] = detail::speed_at(d, k);
+        }));
+        add("speed_columns", time_per_run([&] { detail::evaluate_speed(d, pairs.doubletapness, speed); }));
+        // the whole calculation from the parsed map, for how much of it the evaluators are
+        add("calculate_difficulty", time_per_run([&] { calculate_difficulty(beatmap, mods); }));
+    };
+
+    row("NM", Mods::None);
+    row("HR", Mods::HardRock);
+    row("DT", Mods::DoubleTime);
+}
+
+}
@@ -0,0 +1,69 @@
+#include "bench.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+using namespace cpposu::bench;
+
+struct Benchmark
+{
+    const char* name;
+    void (*run)(const std::vector<BenchmarkInput>&);
+};
+
+static constexpr Benchmark benchmarks[] = {
+    {"path_precision", bench_path_precision},
+    {"mods", bench_mods},
+    {"throughput", bench_throughput},
+    {"scaling", bench_scaling},
+    {"pathological", bench_pathological},
+    {"evaluators", bench_evaluators},
+};
+
+int main(int argc, char* argv[])
+{
+    std::string filter;
+    std::string json;
+    std::vector<BenchmarkInput> inputs;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!std::strcmp(argv[i], "--filter") && i + 1 < argc)
+            filter = argv[++i];
+        else if (!std::strcmp(argv[i], "--json") && i + 1 < argc)
+            json = argv[++i];
+        else if (argv[i][0] == '-')
+        {
+            std::cout << "usage: " << argv[0] << " [--filter <benchmark>] [--json <output.json>] [beatmap.osu...]" << std::endl;
+            return 1;
+        }
+        else
+            inputs.push_back({argv[i], read_file(argv[i])});
+    }
+
+    if (inputs.empty())
+    {
+        std::string tutorial = CPPOSU_TEST_DIR "/Peter Lambert - osu! tutorial (peppy) [Gameplay basics].osu";
+        inputs.push_back({tutorial, read_file(tutorial)});
+    }
+
+    for (const auto& benchmark : benchmarks)
+    {
+        if (!filter.empty() && filter != benchmark.name)
+            continue;
+        std::cout << "== " << benchmark.name << " ==\n";
+        benchmark.run(inputs);
+    }
+
+    if (!json.empty())
+    {
+        std::ofstream file(json);
+        write_json(file, measurements());
+        if (!file)
+        {
+            std::cerr << "Failed to write " << json << std::endl;
+            return 1;
+        }
+    }
+}
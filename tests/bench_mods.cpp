@@ -0,0 +1,41 @@
+#include "bench.hpp"
+
+#include <cpposu/beatmap_parser.hpp>
+#include <cpposu/mods.hpp>
+
+namespace cpposu::bench {
+
+// The per-event mod transform for each combination of the mods that change hit objects.
+void bench_mods(const std::vector<BenchmarkInput>& inputs)
+{
+    constexpr size_t min_events = 1 << 14;
+
+    std::vector<HitObject> hitObjects;
+    for (const auto& input : inputs)
+    {
+        std::istringstream stream(input.contents);
+        BeatmapParser parser(stream, input.filename);
+        auto beatmap = parser.parse();
+        hitObjects.insert(hitObjects.end(), beatmap.hit_objects.begin(), beatmap.hit_objects.end());
+    }
+    if (hitObjects.empty())
+        return;
+    // kept small enough to stay in cache, so that the loops rather than memory bandwidth are measured
+    for (size_t size = hitObjects.size(); hitObjects.size() < min_events;)
+        hitObjects.insert(hitObjects.end(), hitObjects.begin(), hitObjects.begin() + size);
+
+    auto stackHeights = calculate_stack_heights(hitObjects, 14, 500, 3);
+    std::vector<HitObject> output(hitObjects.size());
+    const float stackOffset = -3.2f;
+
+    const double events = (double) hitObjects.size();
+    auto add = [&](std::string name, double seconds) {
+        report({"mods", std::move(name), seconds, {{"events/s", events / seconds}, {"ns/event", seconds * 1e9 / events}}});
+    };
+
+    for (auto [name, mods] : {std::pair{"NM", Mods::None}, {"HR", Mods::HardRock}, {"DT", Mods::DoubleTime},
+             {"HT", Mods::HalfTime}, {"HRDT", Mods::HardRock | Mods::DoubleTime}, {"HRHT", Mods::HardRock | Mods::HalfTime}})
+        add(name, time_per_run([&] { detail::transform_hit_objects(hitObjects, output, stackHeights, stackOffset, mods); }));
+}
+
+}
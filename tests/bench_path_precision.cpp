@@ -0,0 +1,142 @@
+#include "bench.hpp"
+#include "synthetic_beatmap.hpp"
+
+#include <cpposu/beatmap_parser.hpp>
+
+namespace cpposu::bench {
+
+static std::vector<Beatmap> parse_all(const std::vector<BenchmarkInput>& inputs, const PathPrecision& precision)
+{
+    std::vector<Beatmap> result;
+    for (const auto& input : inputs)
+    {
+        std::istringstream stream(input.contents);
+        BeatmapParser parser(stream, input.filename);
+        parser.set_path_precision(precision);
+        result.push_back(parser.parse());
+    }
+    return result;
+}
+
+struct Deviation
+{
+    double max_position=0, total_position=0;
+    double max_tick_position=0, total_tick_position=0;
+    double max_time=0;
+    size_t objects=0, ticks=0;
+    size_t groups=0, changed_groups=0;
+
+    void add(const HitObject& exact, const HitObject& approx)
+    {
+        double position = (exact.position() - approx.position()).length();
+        max_position = std::max(max_position, position);
+        total_position += position;
+        max_time = std::max(max_time, std::abs(exact.time - approx.time));
+        ++objects;
+
+        if (!is_start_event(exact.type))
+        {
+            max_tick_position = std::max(max_tick_position, position);
+            total_tick_position += position;
+            ++ticks;
+        }
+    }
+};
+
+// Compares hit objects one object (slider head and its events) at a time.
+// Objects whose tick structure changed are counted rather than compared.
+static void compare(Deviation& deviation, std::span<const HitObject> exact, std::span<const HitObject> approx)
+{
+    auto group_end = [](std::span<const HitObject> objects, size_t begin) {
+        size_t end = begin + 1;
+        while (end < objects.size() && !is_start_event(objects[end].type)) ++end;
+        return end;
+    };
+
+    size_t i = 0, j = 0;
+    while (i < exact.size() && j < approx.size())
+    {
+        size_t exact_end = group_end(exact, i);
+        size_t approx_end = group_end(approx, j);
+        ++deviation.groups;
+
+        bool same_structure = exact_end - i == approx_end - j;
+        for (size_t k = 0; same_structure && k < exact_end - i; ++k)
+            same_structure = exact[i + k].type == approx[j + k].type;
+
+        if (same_structure)
+        {
+            for (size_t k = 0; k < exact_end - i; ++k)
+                deviation.add(exact[i + k], approx[j + k]);
+        }
+        else
+            ++deviation.changed_groups;
+
+        i = exact_end;
+        j = approx_end;
+    }
+}
+
+// Tiers against exact_parity on the inputs and on generated maps of long, curved sliders, where the tiers' tolerances
+// actually show.
+void bench_path_precision(const std::vector<BenchmarkInput>& inputs)
+{
+    struct Tier
+    {
+        const char* name;
+        PathPrecision precision;
+    };
+    const Tier tiers[] = {
+        {"exact_parity", PathPrecision::exact_parity()},
+        {"standard", PathPrecision::standard()},
+        {"fast_preview", PathPrecision::fast_preview()},
+    };
+
+    synthetic::GeneratorSettings curved;
+    curved.objects = 500;
+    curved.slider_fraction = 1;
+    curved.spinner_fraction = 0;
+    curved.slider_mix = {.linear = 0, .perfect_circle = 1, .bezier = 2, .catmull = 2};
+    curved.bezier_points = 12;
+    curved.catmull_points = 8;
+    curved.min_slider_length = 100;
+    curved.max_slider_length = 300;
+    curved.curve_length_factor = 2;
+    curved.stack_fraction = 0;
+
+    const std::pair<const char*, std::vector<BenchmarkInput>> sets[] = {
+        {"inputs", inputs},
+        {"curved", {{"curved.osu", synthetic::generate_beatmap(curved)}}},
+    };
+
+    for (const auto& [set, setInputs] : sets)
+    {
+        auto exact = parse_all(setInputs, PathPrecision::exact_parity());
+        double exact_time = 0;
+        for (const auto& tier : tiers)
+        {
+            double seconds = time_per_run([&]{ parse_all(setInputs, tier.precision); });
+            if (exact_time == 0) exact_time = seconds;
+
+            Deviation deviation;
+            auto approx = parse_all(setInputs, tier.precision);
+            for (size_t i = 0; i < exact.size(); ++i)
+                compare(deviation, exact[i].hit_objects, approx[i].hit_objects);
+
+            // deviations from exact_parity in osu!pixels and ms, and the objects whose ticks changed
+            report({"path_precision", std::string(set) + "_" + tier.name, seconds, {
+                {"parses/s", 1 / seconds},
+                {"speedup", exact_time / seconds},
+                {"max_px", deviation.max_position},
+                {"mean_px", deviation.total_position / std::max<size_t>(deviation.objects, 1)},
+                {"max_tick_px", deviation.max_tick_position},
+                {"mean_tick_px", deviation.total_tick_position / std::max<size_t>(deviation.ticks, 1)},
+                {"max_ms", deviation.max_time},
+                {"changed_objects", (double) deviation.changed_groups},
+                {"objects", (double) deviation.groups},
+            }});
+        }
+    }
+}
+
+}
@@ -0,0 +1,54 @@
+#include "bench.hpp"
+#include "synthetic_beatmap.hpp"
+
+#include <cpposu/beatmap_parser.hpp>
+#include <cpposu/stacking.hpp>
+
+namespace cpposu::bench {
+
+namespace {
+
+// Parsing and stacking a generated map, per object.
+void bench_generated(const std::string& benchmark, const std::string& name, const synthetic::GeneratorSettings& settings)
+{
+    auto contents = synthetic::generate_beatmap(settings);
+    auto parse = [&] { return BeatmapParser(contents.data(), contents.size(), name).parse(); };
+    auto beatmap = parse();
+    double objects = (double) settings.objects;
+
+    double seconds = time_per_run(parse);
+    report({benchmark, name + "_parse", seconds, {{"MB/s", contents.size() / 1e6 / seconds}, {"objects/s", objects / seconds}}});
+
+    // the versioned entry point picks one of the other two
+    auto params = stacking_parameters(beatmap);
+    seconds = time_per_run([&] { calculate_stack_heights(beatmap.hit_objects, params.version, params.time_threshold, params.distance_threshold); });
+    report({benchmark, name + "_stacking", seconds, {{"objects/s", objects / seconds}}});
+    seconds = time_per_run([&] { calculate_stack_heights(beatmap.hit_objects, params.time_threshold, params.distance_threshold); });
+    report({benchmark, name + "_stacking_walk", seconds, {{"objects/s", objects / seconds}}});
+    seconds = time_per_run([&] { calculate_indexed_stack_heights(beatmap.hit_objects, params.time_threshold, params.distance_threshold); });
+    report({benchmark, name + "_stacking_index", seconds, {{"objects/s", objects / seconds}}});
+}
+
+}
+
+// Generated maps of growing size, for how parsing and stacking scale.
+void bench_scaling(const std::vector<BenchmarkInput>&)
+{
+    for (size_t objects : {1000, 10000, 100000})
+    {
+        synthetic::GeneratorSettings settings;
+        settings.objects = objects;
+        bench_generated("scaling", std::to_string(objects), settings);
+    }
+}
+
+// The worst cases: 10^6 objects, 10^4-point Bezier sliders, long stacks and objects a millisecond apart.
+void bench_pathological(const std::vector<BenchmarkInput>&)
+{
+    bench_generated("pathological", "million_objects", synthetic::million_objects_preset());
+    bench_generated("pathological", "long_bezier", synthetic::long_bezier_preset());
+    bench_generated("pathological", "stack_heavy", synthetic::stack_heavy_preset());
+    bench_generated("pathological", "dense_stream", synthetic::dense_stream_preset());
+}
+
+}
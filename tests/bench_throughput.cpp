@@ -0,0 +1,164 @@
+#include "bench.hpp"
+
+#include <cpposu/beatmap_parser.hpp>
+#include <cpposu/difficulty.hpp>
+#include <cpposu/mods.hpp>
+#include <cpposu/replay.hpp>
+
+#include <algorithm>
+
+namespace cpposu::bench {
+
+namespace {
+
+struct SliderShape
+{
+    const char* name;
+    slider_type type;
+    int degree;
+    std::vector<Vector2> points;
+    double length;
+};
+
+// One slider per path type, with points relative to the head as the parser leaves them.
+const SliderShape slider_shapes[] = {
+    {"linear", slider_type::Linear, 0, {{0, 0}, {200, 0}}, 200},
+    {"perfect_circle", slider_type::PerfectCircle, 0, {{0, 0}, {100, 100}, {200, 0}}, 300},
+    {"bezier", slider_type::Bezier, 0, {{0, 0}, {50, 120}, {120, -80}, {200, 100}, {260, -40}, {320, 40}}, 400},
+    {"catmull", slider_type::CentripetalCatmullRom, 0, {{0, 0}, {60, 40}, {120, 0}, {180, 40}, {240, 0}}, 300},
+    {"bspline", slider_type::BSpline, 3, {{0, 0}, {50, 120}, {120, -80}, {200, 100}, {260, -40}, {320, 40}}, 400},
+};
+
+std::vector<SliderControlPoint> control_points(const SliderShape& shape)
+{
+    std::vector<SliderControlPoint> points;
+    for (const auto& p : shape.points)
+        points.push_back({points.empty() ? shape.type : slider_type::None, p, points.empty() ? shape.degree : 0});
+    return points;
+}
+
+Beatmap parse(const BenchmarkInput& input)
+{
+    return BeatmapParser(input.contents.data(), input.contents.size(), input.filename).parse();
+}
+
+size_t count_objects(std::span<const HitObject> hitObjects, bool slidersOnly = false)
+{
+    return std::count_if(hitObjects.begin(), hitObjects.end(), [&](const HitObject& h) {
+        return slidersOnly ? h.type == slider_head : is_start_event(h.type);
+    });
+}
+
+}
+
+// Throughput of the hot paths, from reading lines to the mod transforms.
+void bench_throughput(const std::vector<BenchmarkInput>& inputs)
+{
+    constexpr size_t min_events = 1 << 14;
+    auto add = [](std::string name, double seconds, std::vector<std::pair<std::string, double>> rates) {
+        for (auto& [unit, rate] : rates)
+            rate /= seconds;
+        report({"throughput", std::move(name), seconds, std::move(rates)});
+    };
+
+    double bytes = 0, objects = 0, sliders = 0;
+    std::vector<Beatmap> beatmaps;
+    for (const auto& input : inputs)
+    {
+        beatmaps.push_back(parse(input));
+        bytes += input.contents.size();
+        objects += count_objects(beatmaps.back().hit_objects);
+        sliders += count_objects(beatmaps.back().hit_objects, true);
+    }
+
+    add("line_parser", time_per_run([&] {
+        for (const auto& input : inputs)
+        {
+            LineParser parser(input.contents.data(), input.contents.size());
+            for (auto line = parser.read_line(); !line.empty(); line = parser.read_line())
+                while (try_take_column(line))
+                    ;
+        }
+    }), {{"MB/s", bytes / 1e6}});
+
+    add("beatmap_parse", time_per_run([&] {
+        for (const auto& input : inputs)
+            parse(input);
+    }), {{"MB/s", bytes / 1e6}, {"objects/s", objects}, {"sliders/s", sliders}});
+
+    for (const auto& shape : slider_shapes)
+    {
+        auto points = control_points(shape);
+        std::vector<Vector2> path;
+        size_t pathPoints = 0;
+        double seconds = time_per_run([&] {
+            path.clear();
+            calculate_segment_path(path, points);
+            pathPoints = path.size();
+        });
+        add(std::string("path_") + shape.name, seconds, {{"paths/s", 1}, {"points/s", (double) pathPoints}});
+    }
+
+    for (const auto& shape : slider_shapes)
+    {
+        TimingPoints timingPoints;
+        timingPoints.points.push_back({.time = 0, .beatLength = 500, .meter = 4, .timing_change = true});
+        timingPoints.baseSliderVelocity = 1.4;
+        timingPoints.sliderTickRate = 2;
+        timingPoints.applyDefaults();
+
+        Slider slider;
+        slider.data.slider_head = {slider_head, 100, 100, 1000};
+        slider.data.control_points = control_points(shape);
+        slider.data.slide_count = 2;
+        slider.data.length = shape.length;
+        size_t events = 0;
+        double seconds = time_per_run([&] {
+            events = 0;
+            slider.generate_hit_objects(timingPoints, 14, [&](const HitObject&) { ++events; });
+        });
+        add(std::string("slider_") + shape.name, seconds, {{"sliders/s", 1}, {"events/s", (double) events}});
+    }
+
+    // maps repeated one after another until large enough, which needs a map with hit objects
+    if (std::all_of(beatmaps.begin(), beatmaps.end(), [](const Beatmap& b) { return b.hit_objects.empty(); }))
+        return;
+    std::vector<HitObject> hitObjects;
+    for (double offset = 0; hitObjects.size() < min_events;)
+        for (const auto& beatmap : beatmaps)
+        {
+            if (beatmap.hit_objects.empty())
+                continue;
+            for (auto h : beatmap.hit_objects)
+            {
+                h.time += offset;
+                hitObjects.push_back(h);
+            }
+            offset = hitObjects.back().time + 1000;
+        }
+    double repeatedObjects = count_objects(hitObjects);
+
+    add("stacking_legacy", time_per_run([&] { calculate_legacy_stack_heights(hitObjects, 500, 3); }), {{"objects/s", repeatedObjects}});
+    add("stacking", time_per_run([&] { calculate_stack_heights(hitObjects, 500, 3); }), {{"objects/s", repeatedObjects}});
+    add("stacking_indexed", time_per_run([&] { calculate_indexed_stack_heights(hitObjects, 500, 3); }), {{"objects/s", repeatedObjects}});
+    const StackingVariant variants[] = {{300}, {500}, {800}};
+    add("stacking_3_variants", time_per_run([&] { calculate_stack_heights(hitObjects, 14, variants); }), {{"objects/s", repeatedObjects}});
+
+    Beatmap repeated = beatmaps.front();
+    repeated.hit_objects = hitObjects;
+    std::vector<HitObject> output(hitObjects.size());
+    for (auto [name, mods] : {std::pair("mods_NM", Mods::None), {"mods_HR", Mods::HardRock}, {"mods_HRDT", Mods::HardRock | Mods::DoubleTime}})
+        add(name, time_per_run([&] { apply_mods(repeated, mods, output); }), {{"objects/s", repeatedObjects}});
+
+    add("difficulty", time_per_run([&] {
+        for (const auto& beatmap : beatmaps)
+            calculate_difficulty(beatmap);
+    }), {{"objects/s", objects}});
+
+    auto replay = read_file(CPPOSU_TEST_DIR "/synthetic.osr");
+    double frames = (double) ReplayParser(replay.data(), replay.size()).parse().frames.size();
+    add("replay_parse", time_per_run([&] { ReplayParser(replay.data(), replay.size()).parse(); }),
+        {{"MB/s", replay.size() / 1e6}, {"frames/s", frames}});
+}
+
+}
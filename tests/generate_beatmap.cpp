@@ -0,0 +1,49 @@
+#include "synthetic_beatmap.hpp"
+
+#include <cstring>
+#include <iostream>
+#include <string>
+
+int main(int argc, char* argv[])
+{
+    using namespace cpposu::synthetic;
+
+    GeneratorSettings settings;
+    uint64_t seed = 1;
+    long long objects = -1;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--seed" && i + 1 < argc)
+            seed = std::stoull(argv[++i]);
+        else if (arg == "--objects" && i + 1 < argc)
+            objects = std::stoll(argv[++i]);
+        else if (arg == "--preset" && i + 1 < argc)
+        {
+            std::string preset = argv[++i];
+            if (preset == "million_objects")
+                settings = million_objects_preset();
+            else if (preset == "long_bezier")
+                settings = long_bezier_preset();
+            else if (preset == "stack_heavy")
+                settings = stack_heavy_preset();
+            else if (preset == "dense_stream_200bpm")
+                settings = dense_stream_200bpm_preset();
+            else if (preset != "default")
+            {
+                std::cerr << "unknown preset " << preset << std::endl;
+                return 1;
+            }
+        }
+        else
+        {
+            std::cout << "usage: " << argv[0] << " [--preset default|million_objects|long_bezier|stack_heavy|dense_stream_200bpm] [--seed <n>] [--objects <n>] > beatmap.osu" << std::endl;
+            return 1;
+        }
+    }
+    settings.seed = seed;
+    if (objects >= 0)
+        settings.objects = objects;
+
+    std::cout << generate_beatmap(settings);
+}
@@ -0,0 +1,397 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <numbers>
+#include <string>
+#include <vector>
+
+namespace cpposu::synthetic {
+
+// splitmix64, so that a seed gives the same map everywhere (the standard distributions are implementation-defined)
+class Random
+{
+public:
+    explicit Random(uint64_t seed): state_(seed) {}
+
+    uint64_t next()
+    {
+        uint64_t z = (state_ += 0x9e3779b97f4a7c15);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+        return z ^ (z >> 31);
+    }
+    // [0, 1)
+    double uniform() { return (next() >> 11) * 0x1.0p-53; }
+    double uniform(double min, double max) { return min + (max - min) * uniform(); }
+    // [min, max]
+    int integer(int min, int max) { return min + (int) (next() % (uint64_t) (max - min + 1)); }
+    bool chance(double p) { return uniform() < p; }
+
+private:
+    uint64_t state_;
+};
+
+// Relative weights of the slider path types.
+struct SliderMix
+{
+    double linear = 1;
+    double perfect_circle = 1;
+    double bezier = 1;
+    double catmull = 1;
+    double bspline = 0;
+};
+
+struct GeneratorSettings
+{
+    uint64_t seed = 1;
+    int version = 14;
+    // circles, sliders and spinners
+    size_t objects = 1000;
+    double slider_fraction = 0.4;
+    double spinner_fraction = 0.01;
+    SliderMix slider_mix;
+    // control points of Bezier and B-spline sliders (the Bezier degree is one less), and of Catmull sliders
+    int bezier_points = 6;
+    int catmull_points = 5;
+    int bspline_degree = 3;
+    // perfect circles whose middle point is about a pixel off the line through the others
+    double degenerate_circle_fraction = 0.1;
+    // slider length in osu!pixels, and the repeats (slides - 1) up to
+    double min_slider_length = 50;
+    double max_slider_length = 300;
+    int max_repeats = 2;
+    // control points are spread over about this times the slider length; above 1, sliders end on their curves instead
+    // of extending past them
+    double curve_length_factor = 1;
+
+    double beat_length = 400;
+    // objects are spaced by a beat over this
+    int beat_divisor = 2;
+    double slider_multiplier = 1.4;
+    double slider_tick_rate = 1;
+    // a slider velocity (inherited) timing point every this many objects, 0 for none
+    size_t sv_change_interval = 16;
+    double min_sv = 0.5;
+    double max_sv = 2;
+
+    // chance of starting a stack of up to max_stack circles on one spot, a quarter beat apart
+    double stack_fraction = 0.1;
+    int max_stack = 8;
+
+    float circle_size = 4;
+    float overall_difficulty = 8;
+    float approach_rate = 9;
+    float stack_leniency = 0.7f;
+};
+
+namespace detail {
+
+inline void append(std::string& out, double value)
+{
+    char buffer[32];
+    auto [end, ec] = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, end);
+}
+
+inline void append(std::string& out, int value)
+{
+    char buffer[16];
+    auto [end, ec] = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, end);
+}
+
+struct Point
+{
+    int x, y;
+};
+
+inline Point clamp_to_playfield(double x, double y)
+{
+    return {(int) std::clamp(std::round(x), 0.0, 512.0), (int) std::clamp(std::round(y), 0.0, 384.0)};
+}
+
+class Generator
+{
+public:
+    explicit Generator(const GeneratorSettings& settings): s_(settings), random_(settings.seed) {}
+
+    std::string generate()
+    {
+        std::string hitObjects;
+        std::string timingPoints = "0,";
+        append(timingPoints, s_.beat_length);
+        timingPoints += ",4,2,0,60,1,0\n";
+
+        double time = 1000;
+        double sv = 1;
+        Point last{256, 192};
+        int stack = 0;
+        for (size_t i = 0; i < s_.objects; ++i)
+        {
+            if (s_.sv_change_interval && i > 0 && i % s_.sv_change_interval == 0)
+            {
+                sv = random_.uniform(s_.min_sv, s_.max_sv);
+                append(timingPoints, (int) time);
+                timingPoints += ',';
+                append(timingPoints, -100 / sv);
+                timingPoints += ",4,2,0,60,0,0\n";
+            }
+
+            if (stack > 0)
+            {
+                --stack;
+                circle(hitObjects, last, time);
+                time += s_.beat_length / 4;
+                continue;
+            }
+            if (random_.chance(s_.stack_fraction))
+                stack = random_.integer(1, std::max(1, s_.max_stack - 1));
+
+            double kind = random_.uniform();
+            Point p = next_position(last);
+            double end = time;
+            if (kind < s_.spinner_fraction)
+            {
+                end = time + 2 * s_.beat_length;
+                spinner(hitObjects, time, end);
+                p = {256, 192};
+            }
+            else if (kind < s_.spinner_fraction + s_.slider_fraction)
+                end = slider(hitObjects, p, time, sv);
+            else
+                circle(hitObjects, p, time);
+
+            last = p;
+            time = end + s_.beat_length / s_.beat_divisor;
+        }
+
+        std::string out = "osu file format v";
+        append(out, s_.version);
+        out += "\n\n[General]\nAudioFilename: audio.mp3\nAudioLeadIn: 0\nPreviewTime: -1\nStackLeniency: ";
+        append(out, (double) s_.stack_leniency);
+        out += "\nMode: 0\n\n[Metadata]\nTitle:synthetic\nArtist:cpposu\nCreator:cpposu\nVersion:seed ";
+        out += std::to_string(s_.seed);
+        out += "\n\n[Difficulty]\nHPDrainRate:5\nCircleSize:";
+        append(out, (double) s_.circle_size);
+        out += "\nOverallDifficulty:";
+        append(out, (double) s_.overall_difficulty);
+        out += "\nApproachRate:";
+        append(out, (double) s_.approach_rate);
+        out += "\nSliderMultiplier:";
+        append(out, s_.slider_multiplier);
+        out += "\nSliderTickRate:";
+        append(out, s_.slider_tick_rate);
+        out += "\n\n[TimingPoints]\n";
+        out += timingPoints;
+        out += "\n[HitObjects]\n";
+        out += hitObjects;
+        return out;
+    }
+
+private:
+    Point next_position(Point last)
+    {
+        // a jump of up to a third of the playfield
+        double angle = random_.uniform(0, 2 * std::numbers::pi);
+        double length = random_.uniform(0, 170);
+        double x = last.x + length * std::cos(angle), y = last.y + length * std::sin(angle);
+        if (x < 0 || x > 512)
+            x = last.x - length * std::cos(angle);
+        if (y < 0 || y > 384)
+            y = last.y - length * std::sin(angle);
+        return clamp_to_playfield(x, y);
+    }
+
+    void start(std::string& out, Point p, double time, int type)
+    {
+        append(out, p.x);
+        out += ',';
+        append(out, p.y);
+        out += ',';
+        append(out, (int) time);
+        out += ',';
+        append(out, type);
+        out += ",0";
+    }
+
+    void circle(std::string& out, Point p, double time)
+    {
+        start(out, p, time, 1);
+        out += '\n';
+    }
+
+    void spinner(std::string& out, double time, double end)
+    {
+        start(out, {256, 192}, time, 12);
+        out += ',';
+        append(out, (int) end);
+        out += '\n';
+    }
+
+    // Writes a slider at p and returns its end time.
+    double slider(std::string& out, Point p, double time, double sv)
+    {
+        const auto& m = s_.slider_mix;
+        double weights[] = {m.linear, m.perfect_circle, m.bezier, m.catmull, m.bspline};
+        double total = 0;
+        for (double w : weights)
+            total += w;
+        double pick = random_.uniform(0, total);
+        int type = 0;
+        while (type < 4 && pick >= weights[type])
+            pick -= weights[type++];
+
+        double length = random_.uniform(s_.min_slider_length, s_.max_slider_length);
+        double spread = length * s_.curve_length_factor;
+        std::vector<Point> points{p};
+        switch (type)
+        {
+        case 0:
+            points.push_back(walk(p, spread));
+            break;
+        case 1:
+            points.push_back(walk(p, spread / 2));
+            if (random_.chance(s_.degenerate_circle_fraction))
+            {
+                // the end continues the line, and the middle moves a pixel off it
+                Point a = points[0], b = points[1];
+                points.push_back(clamp_to_playfield(2 * b.x - a.x, 2 * b.y - a.y));
+                points[1].x += random_.chance(0.5) ? 1 : -1;
+            }
+            else
+                points.push_back(walk(points[1], spread / 2));
+            break;
+        case 2:
+        case 4:
+            for (int i = 1; i < s_.bezier_points; ++i)
+                points.push_back(walk(points.back(), spread / std::max(1, s_.bezier_points - 1) * 2));
+            break;
+        case 3:
+            for (int i = 1; i < s_.catmull_points; ++i)
+                points.push_back(walk(points.back(), spread / std::max(1, s_.catmull_points - 1)));
+            break;
+        }
+
+        start(out, p, time, 2);
+        out += ',';
+        switch (type)
+        {
+        case 0: out += 'L'; break;
+        case 1: out += 'P'; break;
+        case 2: out += 'B'; break;
+        case 3: out += 'C'; break;
+        case 4: out += 'B'; append(out, s_.bspline_degree); break;
+        }
+        for (size_t i = 1; i < points.size(); ++i)
+        {
+            out += '|';
+            append(out, points[i].x);
+            out += ':';
+            append(out, points[i].y);
+        }
+        int repeats = random_.integer(0, s_.max_repeats);
+        out += ',';
+        append(out, repeats + 1);
+        out += ',';
+        append(out, length);
+        out += '\n';
+
+        return time + length / (100 * s_.slider_multiplier * sv) * s_.beat_length * (repeats + 1);
+    }
+
+    Point walk(Point from, double length)
+    {
+        double angle = random_.uniform(0, 2 * std::numbers::pi);
+        double x = from.x + length * std::cos(angle), y = from.y + length * std::sin(angle);
+        if (x < 0 || x > 512)
+            x = from.x - length * std::cos(angle);
+        if (y < 0 || y > 384)
+            y = from.y - length * std::sin(angle);
+        Point p = clamp_to_playfield(x, y);
+        // a repeated point would start a new segment
+        if (p.x == from.x && p.y == from.y)
+            p.x += p.x < 512 ? 1 : -1;
+        return p;
+    }
+
+    const GeneratorSettings& s_;
+    Random random_;
+};
+
+}
+
+// .osu file contents for the settings; the same settings give the same text.
+inline std::string generate_beatmap(const GeneratorSettings& settings)
+{
+    return detail::Generator(settings).generate();
+}
+
+// 10^6 objects of circles, short sliders and stacks, for parsing and stacking at scale.
+inline GeneratorSettings million_objects_preset(uint64_t seed = 1)
+{
+    GeneratorSettings s;
+    s.seed = seed;
+    s.objects = 1000000;
+    s.slider_fraction = 0.3;
+    s.max_slider_length = 150;
+    s.stack_fraction = 0.2;
+    return s;
+}
+
+// Bezier sliders of 10^4 control points, for ApproximateBezier's subdivision.
+inline GeneratorSettings long_bezier_preset(uint64_t seed = 1)
+{
+    GeneratorSettings s;
+    s.seed = seed;
+    s.objects = 20;
+    s.slider_fraction = 1;
+    s.spinner_fraction = 0;
+    s.slider_mix = {.linear = 0, .perfect_circle = 0, .bezier = 1, .catmull = 0};
+    s.bezier_points = 10000;
+    s.min_slider_length = 5000;
+    s.max_slider_length = 10000;
+    s.stack_fraction = 0;
+    return s;
+}
+
+// Long stacks of circles and slider ends on few spots at high stack leniency, for the stacking passes.
+inline GeneratorSettings stack_heavy_preset(uint64_t seed = 1)
+{
+    GeneratorSettings s;
+    s.seed = seed;
+    s.objects = 10000;
+    s.stack_fraction = 0.5;
+    s.max_stack = 32;
+    s.approach_rate = 5;
+    s.stack_leniency = 1;
+    return s;
+}
+
+// 1000 objects of 1/4 streams and jumps at 200 BPM, AR9 OD8 CS4: a dense but playable map, whose difficulty and
+// performance are pinned in the tests with seed 7.
+inline GeneratorSettings dense_stream_200bpm_preset(uint64_t seed = 1)
+{
+    GeneratorSettings s;
+    s.seed = seed;
+    s.beat_length = 300;
+    s.beat_divisor = 4;
+    return s;
+}
+
+// Circles a millisecond apart, so that each is within the stacking time threshold of hundreds before it.
+inline GeneratorSettings dense_stream_preset(uint64_t seed = 1)
+{
+    GeneratorSettings s;
+    s.seed = seed;
+    s.objects = 100000;
+    s.slider_fraction = 0;
+    s.spinner_fraction = 0;
+    s.beat_length = 2;
+    s.sv_change_interval = 0;
+    return s;
+}
+
+}
@@ -0,0 +1,88 @@
+#include <external/catch2/catch.hpp>
+
+#include <cpposu/aim.hpp>
+#include <cpposu/beatmap_parser.hpp>
+#include <cpposu/judgement.hpp>
+
+#include <cmath>
+#include <random>
+
+TEST_CASE("cursor offsets against a brute force search", "[aim]")
+{
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> position(0, 512);
+
+    cpposu::ReplayFrames frames;
+    int32_t time = -50;
+    for (int i = 0; i < 2000; ++i)
+    {
+        int32_t delta = (int32_t) (rng() % 40);
+        time += delta;
+        frames.time_delta.push_back(delta);
+        frames.time.push_back(time);
+        frames.x.push_back(position(rng));
+        frames.y.push_back(position(rng));
+        frames.keys.push_back(0);
+    }
+
+    std::vector<cpposu::HitObject> targets;
+    double t = -200;
+    for (int i = 0; i < 500; ++i)
+    {
+        t += std::uniform_real_distribution<double>(0, 200)(rng);
+        targets.push_back({cpposu::circle, position(rng), position(rng), t});
+    }
+
+    for (double rate : {1.0, 1.5, 0.75})
+    {
+        const float radius = 40;
+        auto offsets = cpposu::cursor_offsets(frames, targets, radius, rate);
+        REQUIRE(offsets.size() == targets.size());
+        for (size_t i = 0; i < targets.size(); ++i)
+        {
+            double mapTime = targets[i].time * rate;
+            size_t nearest = 0;
+            for (size_t f = 1; f < frames.size(); ++f)
+                if (std::abs(frames.time[f] - mapTime) < std::abs(frames.time[nearest] - mapTime))
+                    nearest = f;
+
+            // the nearest time, on ties with whichever frame
+            CHECK(std::abs(frames.time[offsets.frame[i]] - mapTime) == std::abs(frames.time[nearest] - mapTime));
+            size_t f = offsets.frame[i];
+            float distance = (cpposu::Vector2{frames.x[f], frames.y[f]} - targets[i].position()).length();
+            CHECK(offsets.distance[i] == Approx(distance));
+            CHECK(offsets.in_radius[i] == (distance <= radius));
+            CHECK(offsets.time_offset[i] == Approx((frames.time[f] - mapTime) / rate).margin(1e-3));
+        }
+    }
+
+    auto none = cpposu::cursor_offsets(cpposu::ReplayFrames{}, targets, 40);
+    CHECK(std::isinf(none.distance[0]));
+    CHECK(std::isnan(none.time_offset[0]));
+    CHECK(none.in_radius[0] == 0);
+}
+
+TEST_CASE("cursor offsets on a beatmap", "[aim]")
+{
+    auto beatmap = cpposu::BeatmapParser(CPPOSU_TEST_DIR "/Peter Lambert - osu! tutorial (peppy) [Gameplay basics].osu").parse();
+    cpposu::ReplayJudge judge(beatmap, cpposu::Mods::DoubleTime);
+    auto targets = cpposu::aim_targets(judge.hit_objects());
+    REQUIRE(!targets.empty());
+    CHECK(std::is_sorted(targets.begin(), targets.end(), [](auto& a, auto& b) { return a.time < b.time; }));
+
+    // a frame on every target, in the map's time, and the cursor 10 to the right of it
+    cpposu::ReplayFrames frames;
+    for (const auto& h : targets)
+    {
+        frames.time.push_back((int32_t) std::round(h.time * judge.settings().rate));
+        frames.x.push_back(h.x + 10);
+        frames.y.push_back(h.y);
+    }
+    auto offsets = cpposu::cursor_offsets(frames, targets, (float) judge.settings().radius, judge.settings().rate);
+    for (size_t i = 0; i < offsets.size(); ++i)
+    {
+        CHECK(offsets.distance[i] == Approx(10));
+        CHECK(offsets.in_radius[i] == 1);
+        CHECK(std::abs(offsets.time_offset[i]) <= 1);
+    }
+}
@@ -0,0 +1,124 @@
+#include <external/catch2/catch.hpp>
+
+#include <cpposu/analytics.hpp>
+
+namespace {
+
+const char* tutorial = CPPOSU_TEST_DIR "/Peter Lambert - osu! tutorial (peppy) [Gameplay basics].osu";
+const char* synthetic_replay = CPPOSU_TEST_DIR "/synthetic.osr";
+
+}
+
+TEST_CASE("histograms and hit error statistics", "[analytics]")
+{
+    cpposu::Histogram h(-10, 5, 4);
+    for (double v : {-11.0, -10.0, -5.5, -5.0, 0.0, 4.9, 10.0})
+        h.add(v);
+    CHECK(h.underflow == 1);
+    CHECK(h.overflow == 1);
+    CHECK(h.counts == std::vector<uint64_t>{2, 1, 2, 0});
+    CHECK(h.total() == 7);
+    CHECK(h.max() == 10);
+
+    auto merged = h;
+    merged.merge(h);
+    CHECK(merged.counts == std::vector<uint64_t>{4, 2, 4, 0});
+    CHECK(merged.underflow == 2);
+    CHECK_THROWS_AS(merged.merge(cpposu::Histogram(-10, 5, 3)), std::invalid_argument);
+
+    cpposu::HitErrorStatistics a, b;
+    CHECK(std::isnan(a.mean()));
+    a.add(-10);
+    CHECK(std::isnan(a.unstable_rate()));
+    b.add(10);
+    a.merge(b);
+    CHECK(a.mean() == 0);
+    CHECK(a.unstable_rate() == Approx(100));
+}
+
+TEST_CASE("map analytics of judged replays", "[analytics]")
+{
+    auto beatmap = cpposu::BeatmapParser(tutorial).parse();
+    cpposu::ReplayJudge judge(beatmap, cpposu::Mods::None);
+
+    // every circle and slider head pressed 30ms late, alternating keys, sliders not followed
+    auto frames = [&](double offset) {
+        cpposu::ReplayFrames frames;
+        uint32_t key = 1;
+        for (const auto& h : judge.hit_objects())
+        {
+            if (!cpposu::is_target_circle(h.type))
+                continue;
+            key ^= 3;
+            frames.time.push_back((int32_t) (h.time + offset));
+            frames.x.push_back(h.x);
+            frames.y.push_back(h.y);
+            frames.keys.push_back(key);
+        }
+        return frames;
+    };
+
+    cpposu::AnalyticsSettings settings;
+    settings.section_length = 20000;
+    cpposu::MapAnalytics analytics(settings);
+    analytics.add(judge, judge.judge(frames(30)));
+    analytics.add(judge, judge.judge(frames(-30)));
+
+    size_t circles = std::count_if(judge.hit_objects().begin(), judge.hit_objects().end(), [](auto& h) { return cpposu::is_target_circle(h.type); });
+    CHECK(analytics.replays == 2);
+    CHECK(analytics.hit_errors.count == 2 * circles);
+    CHECK(analytics.hit_errors.mean() == Approx(0).margin(1));
+    CHECK(analytics.hit_errors.unstable_rate() == Approx(300).margin(10));
+    CHECK(analytics.hit_error_histogram.counts[170] + analytics.hit_error_histogram.counts[230] == 2 * circles);
+    // each replay on its own hits consistently
+    CHECK(analytics.unstable_rate_histogram.counts[0] == 2);
+
+    uint64_t judged = 0;
+    for (const auto& s : analytics.sections)
+        judged += s.total();
+    CHECK(judged == 2 * judge.object_count());
+    CHECK(analytics.sections.size() == (size_t) (judge.hit_objects().back().time / settings.section_length) + 1);
+    // unfollowed sliders are never 300s
+    CHECK(std::any_of(analytics.sections.begin(), analytics.sections.end(), [](auto& s) { return s.accuracy() < 1; }));
+    CHECK(std::isnan(cpposu::SectionCounts{}.accuracy()));
+}
+
+TEST_CASE("analyzing a replay corpus", "[analytics]")
+{
+    std::vector<cpposu::MapReplays> maps = {
+        {tutorial, {synthetic_replay, synthetic_replay, "missing.osr", synthetic_replay}},
+        {"missing.osu", {synthetic_replay}},
+        {tutorial, {}},
+    };
+    cpposu::ThreadPool pool(3);
+    auto results = cpposu::analyze_replays(maps, pool);
+    REQUIRE(results.size() == 3);
+
+    // the same replays judged one after another
+    auto beatmap = cpposu::BeatmapParser(tutorial).parse();
+    auto replay = cpposu::ReplayParser(synthetic_replay).parse();
+    cpposu::ReplayJudge judge(beatmap, replay.mods & cpposu::ReplayJudge::judged_mods);
+    cpposu::MapAnalytics expected;
+    for (int i = 0; i < 3; ++i)
+        expected.add(judge, judge.judge(replay.frames));
+
+    CHECK(results[0].beatmap == tutorial);
+    CHECK(results[0].error.empty());
+    CHECK(results[0].replays == 3);
+    CHECK(results[0].failed_replays == 1);
+    CHECK(results[0].hit_errors.count == expected.hit_errors.count);
+    CHECK(results[0].hit_errors.sum == Approx(expected.hit_errors.sum));
+    CHECK(results[0].hit_error_histogram.counts == expected.hit_error_histogram.counts);
+    CHECK(results[0].unstable_rate_histogram.counts == expected.unstable_rate_histogram.counts);
+    REQUIRE(results[0].sections.size() == expected.sections.size());
+    for (size_t i = 0; i < expected.sections.size(); ++i)
+    {
+        CHECK(results[0].sections[i].great == expected.sections[i].great);
+        CHECK(results[0].sections[i].miss == expected.sections[i].miss);
+    }
+
+    CHECK(!results[1].error.empty());
+    CHECK(results[1].replays == 0);
+    CHECK(results[2].error.empty());
+    CHECK(results[2].replays == 0);
+}
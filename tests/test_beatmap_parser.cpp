@@ -7,7 +7,7 @@
 
 TEST_CASE("parse tutorial", "[beatmap_parser]")
 {
-    cpposu::BeatmapParser parser(CPPOSU_TEST_DIR "./Peter Lambert - osu! tutorial (peppy) [Gameplay basics].osu");
+    cpposu::BeatmapParser parser(CPPOSU_TEST_DIR "/Peter Lambert - osu! tutorial (peppy) [Gameplay basics].osu");
     auto beatmap = parser.parse();
 
     CHECK(beatmap.difficulty_attributes.HPDrainRate == Approx(0));
@@ -172,3 +172,149 @@ TEST_CASE("parse tutorial", "[beatmap_parser]")
     CHECK(beatmap.hit_objects[i++] == HitObject{.type=cpposu::spinner_end, .x=256, .y=192, .time=119587});
 
 }
+
+TEST_CASE("timing points random access", "[beatmap_parser]")
+{
+    cpposu::TimingPoints timing_points;
+    auto add = [&](double time, double beat_length, bool timing_change) {
+        timing_points.points.push_back({.time=time, .beatLength=beat_length, .timing_change=timing_change});
+    };
+    add(100, 500, true);
+    add(1000, -50, false);
+    add(2000, 250, true);
+    add(2000, -200, false);
+    add(3000, 400, true);
+    add(2500, -25, false); // listed out of order, so only applies once the point before it has
+    timing_points.applyDefaults();
+
+    auto check = [&](double time, double beat_length, double slider_velocity) {
+        timing_points.advanceTime(time);
+        CHECK(timing_points.currentBeatLength == Approx(beat_length));
+        CHECK(timing_points.currentSliderVelocityMultiplier == Approx(slider_velocity));
+    };
+
+    check(2999, 250, 0.5);
+    check(50, 500, 1);
+    check(1500, 500, 2);
+    check(3000, 400, 4);
+    check(2000, 250, 0.5);
+    check(100, 500, 1);
+    check(999, 500, 1);
+
+    CHECK(timing_points.stateAt(3500).beatLength == Approx(400));
+}
+
+static constexpr char out_of_order_map[]=
+R"(osu file format v14
+
+[Difficulty]
+SliderMultiplier:1
+SliderTickRate:1
+
+[TimingPoints]
+0,500,4,2,0,100,1,0
+5000,-50,4,2,0,100,0,0
+
+[HitObjects]
+100,100,6000,2,0,L|300:100,1,200
+50,50,8000,1,0
+60,60,1000,2,0,L|260:60,1,200
+70,70,1000,1,0
+)";
+
+TEST_CASE("parse out of order hit objects", "[beatmap_parser]")
+{
+    std::istringstream stream(out_of_order_map);
+    cpposu::BeatmapParser parser(stream);
+    auto beatmap = parser.parse();
+
+    std::vector<double> start_times;
+    for (const auto& h : beatmap.hit_objects)
+        if (cpposu::is_start_event(h.type))
+            start_times.push_back(h.time);
+
+    CHECK(start_times == std::vector<double>{1000, 1000, 6000, 8000});
+    CHECK(beatmap.hit_objects[0].type == cpposu::slider_head);
+    CHECK(beatmap.hit_objects[0].x == 60);
+
+    // slider velocity is looked up at each slider's own time
+    auto tail_time = [&](double start) {
+        auto head = std::find_if(beatmap.hit_objects.begin(), beatmap.hit_objects.end(),
+            [&](const auto& h) { return h.type == cpposu::slider_head && h.time == start; });
+        return std::find_if(head, beatmap.hit_objects.end(),
+            [](const auto& h) { return h.type == cpposu::slider_tail; })->time;
+    };
+    CHECK(tail_time(1000) == Approx(2000));
+    CHECK(tail_time(6000) == Approx(6500));
+}
+
+TEST_CASE("hit object columns", "[beatmap_parser]")
+{
+    cpposu::BeatmapParser parser(CPPOSU_TEST_DIR "/Peter Lambert - osu! tutorial (peppy) [Gameplay basics].osu");
+    auto beatmap = parser.parse();
+
+    auto columns = cpposu::to_columns(beatmap.hit_objects);
+    REQUIRE(columns.size() == beatmap.hit_objects.size());
+    for (size_t i = 0; i < columns.size(); ++i)
+    {
+        const auto& h = beatmap.hit_objects[i];
+        CHECK(columns.type[i] == h.type);
+        CHECK(columns.x[i] == h.x);
+        CHECK(columns.y[i] == h.y);
+        CHECK(columns.time[i] == h.time);
+    }
+}
+
+TEST_CASE("parse from memory", "[beatmap_parser]")
+{
+    std::string filename = CPPOSU_TEST_DIR "/Peter Lambert - osu! tutorial (peppy) [Gameplay basics].osu";
+    std::ifstream file(filename, std::ios::binary);
+    std::string contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    auto expected = cpposu::BeatmapParser(filename).parse();
+    auto beatmap = cpposu::BeatmapParser(contents.data(), contents.size()).parse();
+    CHECK(beatmap.version == expected.version);
+    CHECK(beatmap.info.Title == expected.info.Title);
+    CHECK(beatmap.hit_objects == expected.hit_objects);
+
+    // truncated input ends the map instead of reading past it
+    auto truncated = cpposu::BeatmapParser(contents.data(), contents.find("[HitObjects]")).parse();
+    CHECK(truncated.hit_objects.empty());
+}
+
+TEST_CASE("parse errors report code and location", "[beatmap_parser]")
+{
+    auto parse_failure = [](std::string_view contents) {
+        try {
+            cpposu::BeatmapParser(contents.data(), contents.size()).parse();
+        }
+        catch (cpposu::parse_error& e) {
+            return e;
+        }
+        FAIL("no parse error");
+        return cpposu::parse_error("");
+    };
+
+    auto e = parse_failure("osu file format v14\n\n[Difficulty]\nCircleSize: x4\n");
+    CHECK(e.code == cpposu::parse_error_code::invalid_number);
+    CHECK(e.line == 4);
+    CHECK(e.column == 13);
+
+    e = parse_failure("osu file format v14\n[HitObjects]\n64,64,100,2,0,Q|100:100,1,100\n");
+    CHECK(e.code == cpposu::parse_error_code::invalid_slider_type);
+    CHECK(e.line == 3);
+    CHECK(e.column == 15);
+
+    e = parse_failure("not a beatmap");
+    CHECK(e.code == cpposu::parse_error_code::invalid_header);
+    CHECK(e.line == 1);
+
+    try {
+        cpposu::BeatmapParser("missing.osu").parse();
+        FAIL("no parse error");
+    }
+    catch (cpposu::parse_error& e) {
+        CHECK(e.code == cpposu::parse_error_code::file_open);
+        CHECK(e.line == 0);
+    }
+}
@@ -0,0 +1,143 @@
+#include <external/catch2/catch.hpp>
+
+#include <cpposu/line_parser.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+// The C API as a client of cpposu_lib declares it.
+extern "C" {
+
+struct cpposu_error
+{
+    int32_t code;
+    uint64_t line;
+    uint64_t column;
+    const char* message;
+};
+
+int32_t cpposu_last_error(cpposu_error* out);
+void cpposu_set_error_output(int enabled);
+void* cpposu_parse_beatmap(const char* filename);
+void* cpposu_parse_beatmap_from_memory(const char* data, size_t size);
+size_t cpposu_parse_batch(const char** paths, size_t n, void** out, int32_t* error_codes);
+void* cpposu_parse_submit(const char* filename);
+int cpposu_parse_poll(void* request);
+void* cpposu_parse_wait(void* request);
+void cpposu_shutdown();
+void cpposu_free_beatmap(void* handle);
+uint64_t cpposu_hit_object_count(void* handle);
+
+}
+
+namespace {
+
+const char* tutorial = CPPOSU_TEST_DIR "/Peter Lambert - osu! tutorial (peppy) [Gameplay basics].osu";
+const char* missing = CPPOSU_TEST_DIR "/no such beatmap.osu";
+
+constexpr auto file_open = (int32_t) cpposu::parse_error_code::file_open;
+
+}
+
+TEST_CASE("C API batch parsing", "[c_api]")
+{
+    cpposu_set_error_output(0);
+    uint64_t objects = 0;
+    {
+        void* beatmap = cpposu_parse_beatmap(tutorial);
+        REQUIRE(beatmap);
+        objects = cpposu_hit_object_count(beatmap);
+        cpposu_free_beatmap(beatmap);
+    }
+    REQUIRE(objects > 0);
+
+    const char* paths[] = {tutorial, missing, tutorial};
+    void* out[3];
+    int32_t codes[3] = {-1, -1, -1};
+    CHECK(cpposu_parse_batch(paths, 3, out, codes) == 2);
+    CHECK(codes[0] == 0);
+    CHECK(codes[1] == file_open);
+    CHECK(codes[2] == 0);
+    CHECK(out[1] == nullptr);
+    for (void* beatmap : {out[0], out[2]})
+    {
+        REQUIRE(beatmap);
+        CHECK(cpposu_hit_object_count(beatmap) == objects);
+        cpposu_free_beatmap(beatmap);
+    }
+
+    cpposu_error error;
+    CHECK(cpposu_last_error(&error) == file_open);
+    CHECK(error.code == file_open);
+    CHECK(std::string(error.message).find("no such beatmap") != std::string::npos);
+
+    // without error codes
+    CHECK(cpposu_parse_batch(paths + 1, 1, out, nullptr) == 0);
+    CHECK(out[0] == nullptr);
+
+    // null paths fail like missing files
+    const char* nullPaths[] = {nullptr};
+    CHECK(cpposu_parse_batch(nullPaths, 1, out, codes) == 0);
+    CHECK(out[0] == nullptr);
+    CHECK(codes[0] == file_open);
+    CHECK(cpposu_parse_beatmap(nullptr) == nullptr);
+    CHECK(cpposu_last_error(nullptr) == file_open);
+}
+
+TEST_CASE("C API asynchronous parsing", "[c_api]")
+{
+    cpposu_set_error_output(0);
+    void* request = cpposu_parse_submit(tutorial);
+    REQUIRE(request);
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+    while (!cpposu_parse_poll(request) && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    CHECK(cpposu_parse_poll(request) == 1);
+    void* beatmap = cpposu_parse_wait(request);
+    REQUIRE(beatmap);
+    CHECK(cpposu_hit_object_count(beatmap) > 0);
+    cpposu_free_beatmap(beatmap);
+
+    // waiting without polling, on a failure
+    CHECK(cpposu_parse_wait(cpposu_parse_submit(missing)) == nullptr);
+    CHECK(cpposu_last_error(nullptr) == file_open);
+    CHECK(cpposu_parse_wait(cpposu_parse_submit(nullptr)) == nullptr);
+    CHECK(cpposu_last_error(nullptr) == file_open);
+
+    // shutting down finishes submitted requests, and the threads start again on the next one
+    request = cpposu_parse_submit(tutorial);
+    cpposu_shutdown();
+    CHECK(cpposu_parse_poll(request) == 1);
+    beatmap = cpposu_parse_wait(request);
+    REQUIRE(beatmap);
+    cpposu_free_beatmap(beatmap);
+    beatmap = cpposu_parse_wait(cpposu_parse_submit(tutorial));
+    CHECK(beatmap != nullptr);
+    cpposu_free_beatmap(beatmap);
+    cpposu_shutdown();
+}
+
+TEST_CASE("C API last error is per thread", "[c_api]")
+{
+    cpposu_set_error_output(0);
+    std::string bad = "osu file format v14\n\n[HitObjects]\n64,x,1000,1,0\n";
+    CHECK(cpposu_parse_beatmap_from_memory(bad.data(), bad.size()) == nullptr);
+    cpposu_error error;
+    int32_t code = cpposu_last_error(&error);
+    CHECK(code == (int32_t) cpposu::parse_error_code::invalid_number);
+    CHECK(error.line == 4);
+
+    // another thread has its own, which its failures don't share with this one
+    int32_t otherBefore = -1, otherAfter = -1;
+    std::thread([&] {
+        otherBefore = cpposu_last_error(nullptr);
+        cpposu_parse_beatmap(missing);
+        otherAfter = cpposu_last_error(nullptr);
+    }).join();
+    CHECK(otherBefore == 0);
+    CHECK(otherAfter == file_open);
+    CHECK(cpposu_last_error(&error) == code);
+    CHECK(error.line == 4);
+}
@@ -0,0 +1,254 @@
+#include <external/catch2/catch.hpp>
+
+#include <cpposu/beatmap_parser.hpp>
+#include <cpposu/difficulty.hpp>
+
+#include "synthetic_beatmap.hpp"
+
+using cpposu::Mods;
+
+namespace {
+
+const char* tutorial = CPPOSU_TEST_DIR "/Peter Lambert - osu! tutorial (peppy) [Gameplay basics].osu";
+
+// Circles alternating between two points spacing apart, at the given interval.
+cpposu::Beatmap jumps(float spacing, double interval, int count = 200)
+{
+    cpposu::Beatmap b;
+    b.version = 14;
+    b.difficulty_attributes.ApproachRate = 9;
+    b.difficulty_attributes.CircleSize = 4;
+    b.difficulty_attributes.OverallDifficulty = 8;
+    for (int i = 0; i < count; ++i)
+        b.hit_objects.push_back({cpposu::circle, 256 + (i % 2 ? spacing / 2 : -spacing / 2), 192 + (i % 3) * 20.0f, 1000 + i * interval});
+    return b;
+}
+
+cpposu::Beatmap dense()
+{
+    auto contents = cpposu::synthetic::generate_beatmap(cpposu::synthetic::dense_stream_200bpm_preset(7));
+    return cpposu::BeatmapParser(contents.data(), contents.size()).parse();
+}
+
+}
+
+TEST_CASE("difficulty of the tutorial", "[difficulty]")
+{
+    auto beatmap = cpposu::BeatmapParser(tutorial).parse();
+    auto attributes = cpposu::calculate_difficulty(beatmap);
+
+    CHECK(attributes.StarRating > 0);
+    CHECK(attributes.StarRating < 2);
+    CHECK(attributes.AimDifficulty > 0);
+    CHECK(attributes.SpeedDifficulty > 0);
+    CHECK(attributes.FlashlightDifficulty == 0);
+    CHECK(attributes.HitCircleCount + attributes.SliderCount + attributes.SpinnerCount
+          == std::count_if(beatmap.hit_objects.begin(), beatmap.hit_objects.end(), [](auto& h) { return cpposu::is_start_event(h.type); }));
+    CHECK(attributes.ApproachRate == Approx(beatmap.difficulty_attributes.ApproachRate));
+
+    auto doubleTime = cpposu::calculate_difficulty(beatmap, Mods::DoubleTime);
+    auto halfTime = cpposu::calculate_difficulty(beatmap, Mods::HalfTime);
+    CHECK(doubleTime.StarRating > attributes.StarRating);
+    CHECK(halfTime.StarRating < attributes.StarRating);
+    CHECK(doubleTime.MaxCombo == attributes.MaxCombo);
+
+    auto flashlight = cpposu::calculate_difficulty(beatmap, Mods::Flashlight);
+    CHECK(flashlight.FlashlightDifficulty > 0);
+    CHECK(flashlight.StarRating > attributes.StarRating);
+    CHECK(cpposu::calculate_difficulty(beatmap, Mods::Flashlight | Mods::Hidden).FlashlightDifficulty > flashlight.FlashlightDifficulty);
+
+    CHECK(cpposu::calculate_difficulty(beatmap, Mods::Relax).SpeedDifficulty == 0);
+    CHECK(cpposu::calculate_difficulty(beatmap, Mods::Autopilot).AimDifficulty == 0);
+}
+
+TEST_CASE("difficulty grows with spacing and speed", "[difficulty]")
+{
+    auto near = cpposu::calculate_difficulty(jumps(100, 300));
+    auto far = cpposu::calculate_difficulty(jumps(300, 300));
+    auto faster = cpposu::calculate_difficulty(jumps(300, 150));
+
+    CHECK(far.AimDifficulty > near.AimDifficulty);
+    CHECK(faster.AimDifficulty > far.AimDifficulty);
+    CHECK(faster.SpeedDifficulty > far.SpeedDifficulty);
+    CHECK(faster.StarRating > far.StarRating);
+    CHECK(far.StarRating > near.StarRating);
+    CHECK(far.SliderFactor == Approx(1));
+
+    // distances only depend on relative positions
+    auto moved = jumps(300, 300);
+    for (auto& h : moved.hit_objects)
+        h.x -= 30, h.y += 50;
+    CHECK(cpposu::calculate_difficulty(moved).StarRating == Approx(far.StarRating));
+}
+
+TEST_CASE("difficulty of tiny maps", "[difficulty]")
+{
+    CHECK(cpposu::calculate_difficulty(jumps(100, 300, 0)).StarRating == 0);
+
+    // only the rating's floor of performance per skill
+    auto single = cpposu::calculate_difficulty(jumps(100, 300, 1));
+    CHECK(single.StarRating < 0.2);
+    CHECK(single.AimDifficulty == 0);
+    CHECK(single.MaxCombo == 1);
+    CHECK(single.HitCircleCount == 1);
+
+    CHECK(std::isfinite(cpposu::calculate_difficulty(jumps(0, 10, 5)).StarRating));
+}
+
+TEST_CASE("difficulty of several mod combinations", "[difficulty]")
+{
+    auto beatmap = cpposu::BeatmapParser(tutorial).parse();
+    std::vector<Mods> combinations = {
+        Mods::None, Mods::Hidden, Mods::HardRock, Mods::DoubleTime, Mods::Hidden | Mods::HardRock,
+        Mods::Hidden | Mods::DoubleTime, Mods::DoubleTime | Mods::HardRock, Mods::Easy, Mods::HalfTime,
+        Mods::Flashlight, Mods::Flashlight | Mods::Hidden, Mods::DoubleTime | Mods::Nightcore, Mods::None,
+    };
+    auto batch = cpposu::calculate_difficulty(beatmap, combinations);
+    REQUIRE(batch.size() == combinations.size());
+
+    for (size_t i = 0; i < combinations.size(); ++i)
+    {
+        INFO("mods " << (uint32_t)combinations[i]);
+        // against the objects transformed with the rate applied
+        std::vector<cpposu::HitObject> hitObjects(beatmap.hit_objects.size());
+        auto difficulty = cpposu::apply_mods(beatmap, combinations[i], hitObjects);
+        auto expected = cpposu::calculate_difficulty(hitObjects, difficulty, combinations[i]);
+
+        CHECK(batch[i].StarRating == Approx(expected.StarRating));
+        CHECK(batch[i].AimDifficulty == Approx(expected.AimDifficulty));
+        CHECK(batch[i].SpeedDifficulty == Approx(expected.SpeedDifficulty));
+        CHECK(batch[i].FlashlightDifficulty == Approx(expected.FlashlightDifficulty));
+        CHECK(batch[i].SpeedNoteCount == Approx(expected.SpeedNoteCount));
+        CHECK(batch[i].ApproachRate == Approx(expected.ApproachRate));
+        CHECK(batch[i].MaxCombo == expected.MaxCombo);
+    }
+    CHECK(batch[0].StarRating == batch[1].StarRating);
+    CHECK(batch[0].StarRating == batch.back().StarRating);
+    CHECK(batch[3].StarRating == batch[11].StarRating);
+}
+
+TEST_CASE("difficulty timeline", "[difficulty]")
+{
+    auto beatmap = cpposu::BeatmapParser(tutorial).parse();
+    Mods mods = Mods::DoubleTime | Mods::HardRock | Mods::Flashlight | Mods::Hidden;
+    std::vector<cpposu::HitObject> hitObjects(beatmap.hit_objects.size());
+    auto difficulty = cpposu::apply_mods(beatmap, mods, hitObjects);
+
+    cpposu::DifficultyTimeline timeline(difficulty, mods);
+    CHECK(timeline.size() == 0);
+    timeline.push(hitObjects);
+    timeline.finish();
+
+    auto expected = cpposu::calculate_difficulty(hitObjects, difficulty, mods);
+    auto attributes = timeline.attributes();
+    CHECK(attributes.StarRating == Approx(expected.StarRating));
+    CHECK(attributes.AimDifficulty == Approx(expected.AimDifficulty));
+    CHECK(attributes.SpeedDifficulty == Approx(expected.SpeedDifficulty));
+    CHECK(attributes.FlashlightDifficulty == Approx(expected.FlashlightDifficulty));
+    CHECK(attributes.SliderFactor == Approx(expected.SliderFactor));
+    CHECK(attributes.SpeedNoteCount == Approx(expected.SpeedNoteCount));
+    CHECK(attributes.AimDifficultStrainCount == Approx(expected.AimDifficultStrainCount));
+    CHECK(attributes.SpeedDifficultStrainCount == Approx(expected.SpeedDifficultStrainCount));
+    CHECK(attributes.ApproachRate == Approx(expected.ApproachRate));
+    CHECK(attributes.MaxCombo == expected.MaxCombo);
+    CHECK(attributes.SliderCount == expected.SliderCount);
+    CHECK_THROWS_AS(timeline.push(hitObjects[0]), std::logic_error);
+
+    for (size_t n = 1; n < timeline.size(); ++n)
+        CHECK(timeline.attributes(n).MaxCombo <= timeline.attributes(n + 1).MaxCombo);
+    CHECK_THROWS_AS(timeline.attributes(timeline.size() + 1), std::out_of_range);
+}
+
+TEST_CASE("difficulty timeline prefixes", "[difficulty]")
+{
+    // with a constant rhythm, looking at the next object doesn't change the speed of the last one
+    auto beatmap = jumps(150, 120, 900);
+    cpposu::DifficultyTimeline timeline(beatmap.difficulty_attributes, Mods::None);
+    for (size_t i = 0; i < beatmap.hit_objects.size(); ++i)
+    {
+        timeline.push(beatmap.hit_objects[i]);
+        // the object pushed last isn't complete and the one before it has no next one yet, except the first
+        CHECK(timeline.size() == (i == 0 ? 0 : std::max<size_t>(i - 1, 1)));
+    }
+    timeline.finish();
+    REQUIRE(timeline.size() == beatmap.hit_objects.size());
+
+    for (size_t n : {1, 2, 3, 10, 50, 333, 900})
+    {
+        INFO("prefix " << n);
+        auto prefix = std::span(beatmap.hit_objects).first(n);
+        auto expected = cpposu::calculate_difficulty(prefix, beatmap.difficulty_attributes, Mods::None);
+        auto attributes = timeline.attributes(n);
+        CHECK(attributes.StarRating == Approx(expected.StarRating));
+        CHECK(attributes.AimDifficulty == Approx(expected.AimDifficulty));
+        CHECK(attributes.SpeedDifficulty == Approx(expected.SpeedDifficulty));
+        CHECK(attributes.SpeedNoteCount == Approx(expected.SpeedNoteCount));
+        CHECK(attributes.MaxCombo == expected.MaxCombo);
+    }
+}
+
+// cpposu's own attributes at the time of writing, pinned to catch unintended changes to the calculation. They are not
+// osu-tools or lazer values: replace them by those of osu-tools' difficulty command at the lazer revision the port
+// follows (see difficulty.hpp) when available, and treat a difference as a porting bug.
+TEST_CASE("pinned difficulty attributes", "[difficulty]")
+{
+    struct Pinned
+    {
+        const char* map;
+        Mods mods;
+        double stars, aim, speed, speedNotes, sliderFactor;
+        int maxCombo;
+    };
+    const Pinned pinned[] = {
+        {"tutorial", Mods::None, 0.7171167644, 0.3985358407, 0.2305119797, 3.564588974, 0.4813012126, 28},
+        {"tutorial", Mods::HardRock, 0.7681712539, 0.4305609185, 0.2305119797, 3.564588974, 0.4688174782, 28},
+        {"tutorial", Mods::DoubleTime, 0.8550357595, 0.4729715516, 0.2886032599, 3.304844374, 0.4965611241, 28},
+        {"dense", Mods::None, 7.725083787, 3.942555225, 3.381025622, 276.1314076, 0.9798843517, 1879},
+        {"dense", Mods::HardRock, 8.120649126, 4.228490355, 3.42570358, 273.0693765, 0.9750553156, 1879},
+        {"dense", Mods::DoubleTime, 10.9803971, 5.288864325, 5.190649006, 330.3561055, 0.9751288107, 1879},
+    };
+
+    auto tutorialMap = cpposu::BeatmapParser(tutorial).parse();
+    auto denseMap = dense();
+    for (const auto& p : pinned)
+    {
+        INFO(p.map << " with mods " << (int) p.mods);
+        auto a = cpposu::calculate_difficulty(std::string(p.map) == "tutorial" ? tutorialMap : denseMap, p.mods);
+        CHECK(a.StarRating == Approx(p.stars).epsilon(1e-8));
+        CHECK(a.AimDifficulty == Approx(p.aim).epsilon(1e-8));
+        CHECK(a.SpeedDifficulty == Approx(p.speed).epsilon(1e-8));
+        CHECK(a.SpeedNoteCount == Approx(p.speedNotes).epsilon(1e-8));
+        CHECK(a.SliderFactor == Approx(p.sliderFactor).epsilon(1e-8));
+        CHECK(a.MaxCombo == p.maxCombo);
+    }
+}
+
+TEST_CASE("column evaluators agree with the per object ones", "[difficulty]")
+{
+    namespace detail = cpposu::detail;
+
+    auto tutorialMap = cpposu::BeatmapParser(tutorial).parse();
+    auto denseMap = dense();
+    for (const auto* beatmap : {&tutorialMap, &denseMap})
+        for (Mods mods : {Mods::None, Mods::HardRock, Mods::DoubleTime})
+        {
+            INFO(beatmap->hit_objects.size() << " objects with mods " << (int) mods);
+            std::vector<cpposu::HitObject> hitObjects(beatmap->hit_objects.size());
+            auto difficulty = cpposu::apply_mods(*beatmap, mods, hitObjects);
+            auto d = detail::difficulty_geometry(hitObjects, difficulty);
+            detail::set_rate(d, difficulty, 1, cpposu::mod_rate(mods));
+
+            std::vector<double> withSliders(d.size()), withoutSliders(d.size()), speed(d.size());
+            detail::RhythmPairs pairs;
+            pairs.update(d);
+            detail::evaluate_aim(d, withSliders, withoutSliders);
+            detail::evaluate_speed(d, pairs.doubletapness, speed);
+            for (size_t k = 0; k < d.size(); ++k)
+            {
+                INFO("object " << k);
+                CHECK(withSliders[k] == detail::aim_at(d, k, true));
+                CHECK(withoutSliders[k] == detail::aim_at(d, k, false));
+                CHECK(speed[k] == detail::speed_at(d, k));
+            }
+        }
+}
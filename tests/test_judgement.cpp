@@ -0,0 +1,202 @@
+#include <external/catch2/catch.hpp>
+
+#include <cpposu/beatmap_parser.hpp>
+#include <cpposu/difficulty.hpp>
+#include <cpposu/judgement.hpp>
+
+#include <cmath>
+#include <map>
+
+using cpposu::HitResult;
+using cpposu::Mods;
+
+namespace {
+
+const char* tutorial = CPPOSU_TEST_DIR "/Peter Lambert - osu! tutorial (peppy) [Gameplay basics].osu";
+
+// Frames that press every circle and slider head at its time plus offset (alternating keys), follow sliders through
+// their events and spin spinners; in the map's time, i.e. the hit objects' time times rate.
+cpposu::ReplayFrames autoplay(std::span<const cpposu::HitObject> hitObjects, double rate, double offset = 0)
+{
+    constexpr uint32_t k1 = (uint32_t) cpposu::ReplayKeys::M1 | (uint32_t) cpposu::ReplayKeys::K1;
+    constexpr uint32_t k2 = (uint32_t) cpposu::ReplayKeys::M2 | (uint32_t) cpposu::ReplayKeys::K2;
+
+    std::multimap<double, std::tuple<float, float, uint32_t>> frames;
+    uint32_t key = k2;
+    for (size_t i = 0; i < hitObjects.size(); ++i)
+    {
+        const auto& h = hitObjects[i];
+        double time = h.time * rate;
+        switch (h.type)
+        {
+        case cpposu::circle:
+        case cpposu::slider_head:
+            key = key == k1 ? k2 : k1;
+            frames.emplace(time + offset, std::tuple(h.x, h.y, key));
+            if (h.type == cpposu::circle)
+                frames.emplace(time + offset + 10, std::tuple(h.x, h.y, 0));
+            break;
+        case cpposu::slider_tick:
+        case cpposu::slider_repeat:
+        case cpposu::slider_legacy_last_tick:
+            frames.emplace(time, std::tuple(h.x, h.y, key));
+            break;
+        case cpposu::slider_tail:
+            frames.emplace(time + 1, std::tuple(h.x, h.y, 0));
+            break;
+        case cpposu::spinner_start:
+            // 6 turns per second
+            for (double t = time; t <= hitObjects[i + 1].time * rate; t += 10)
+            {
+                double angle = (t - time) / 1000 * 6 * 2 * std::numbers::pi;
+                frames.emplace(t, std::tuple(h.x + 60 * std::cos(angle), h.y + 60 * std::sin(angle), k1));
+            }
+            frames.emplace(hitObjects[i + 1].time * rate + 1, std::tuple(h.x, h.y, 0));
+            break;
+        default:
+            break;
+        }
+    }
+
+    cpposu::ReplayFrames result;
+    int32_t last = 0;
+    for (auto& [time, frame] : frames)
+    {
+        int32_t t = (int32_t) std::round(time);
+        result.time_delta.push_back(t - last);
+        result.time.push_back(t);
+        result.x.push_back(std::get<0>(frame));
+        result.y.push_back(std::get<1>(frame));
+        result.keys.push_back(std::get<2>(frame));
+        last = t;
+    }
+    return result;
+}
+
+}
+
+TEST_CASE("judging a perfect replay", "[judgement]")
+{
+    auto beatmap = cpposu::BeatmapParser(tutorial).parse();
+    for (Mods mods : {Mods::None, Mods::HardRock, Mods::DoubleTime | Mods::HardRock, Mods::HalfTime})
+    {
+        INFO("mods " << (uint32_t) mods);
+        cpposu::ReplayJudge judge(beatmap, mods);
+        auto j = judge.judge(autoplay(judge.hit_objects(), judge.settings().rate));
+
+        auto attributes = cpposu::calculate_difficulty(beatmap, mods);
+        REQUIRE(j.size() == (size_t) (attributes.HitCircleCount + attributes.SliderCount + attributes.SpinnerCount));
+        CHECK(j.count(HitResult::Great) == (int) j.size());
+        CHECK(j.max_combo == attributes.MaxCombo);
+        CHECK(j.large_tick_misses == 0);
+        CHECK(j.slider_tail_hits == attributes.SliderCount);
+        for (float e : j.hit_error)
+            CHECK((std::isnan(e) || std::abs(e) <= 1));
+
+        auto pp = cpposu::calculate_performance(attributes, mods, j.statistics());
+        CHECK(pp.Total > 0);
+    }
+}
+
+TEST_CASE("judging hit timing and misses", "[judgement]")
+{
+    auto beatmap = cpposu::BeatmapParser(tutorial).parse();
+    cpposu::ReplayJudge judge(beatmap, Mods::None);
+    const auto& s = judge.settings();
+
+    auto judgedCircles = [&](const cpposu::Judgements& j, HitResult r) {
+        int n = 0;
+        for (size_t i = 0, o = 0; i < judge.hit_objects().size(); ++i)
+            if (cpposu::is_start_event(judge.hit_objects()[i].type))
+                n += judge.hit_objects()[i].type == cpposu::circle && j.result[o++] == r;
+        return n;
+    };
+    auto circles = (int) std::count_if(beatmap.hit_objects.begin(), beatmap.hit_objects.end(), [](auto& h) { return h.type == cpposu::circle; });
+    REQUIRE(circles > 0);
+
+    // late presses between the 300 and 100 windows
+    auto late = judge.judge(autoplay(judge.hit_objects(), 1, (s.window_great + s.window_ok) / 2));
+    CHECK(judgedCircles(late, HitResult::Ok) == circles);
+    for (size_t o = 0; o < late.size(); ++o)
+        if (!std::isnan(late.hit_error[o]))
+            CHECK(late.hit_error[o] == Approx((s.window_great + s.window_ok) / 2).margin(1));
+
+    // early presses before the 50 window but in the miss window
+    auto early = judge.judge(autoplay(judge.hit_objects(), 1, -(s.window_meh + s.window_miss) / 2));
+    CHECK(judgedCircles(early, HitResult::Miss) == circles);
+    CHECK(early.max_combo < late.max_combo);
+
+    // no presses at all: only spinners and slider parts can be hit
+    auto frames = autoplay(judge.hit_objects(), 1);
+    std::fill(frames.keys.begin(), frames.keys.end(), 0);
+    auto none = judge.judge(frames);
+    CHECK(none.count(HitResult::Miss) == (int) none.size());
+    CHECK(none.max_combo == 0);
+
+    // the cursor away from everything
+    frames = autoplay(judge.hit_objects(), 1);
+    std::fill(frames.x.begin(), frames.x.end(), -1000.0f);
+    CHECK(judge.judge(frames).count(HitResult::Miss) == (int) none.size());
+}
+
+TEST_CASE("judging hit timing with rate mods", "[judgement]")
+{
+    auto beatmap = cpposu::BeatmapParser(tutorial).parse();
+    auto nomod = cpposu::ReplayJudge(beatmap, Mods::None).settings();
+    for (Mods mods : {Mods::DoubleTime, Mods::HalfTime})
+    {
+        INFO("mods " << (uint32_t) mods);
+        cpposu::ReplayJudge judge(beatmap, mods);
+        const auto& s = judge.settings();
+        // the windows are those of the map's time in the rate's
+        CHECK(s.window_great * s.rate == Approx(nomod.window_great));
+        CHECK(s.window_meh * s.rate == Approx(nomod.window_meh));
+
+        auto circleResults = [&](const cpposu::Judgements& j, HitResult r) {
+            int n = 0, circles = 0;
+            for (size_t i = 0, o = 0; i < judge.hit_objects().size(); ++i)
+                if (cpposu::is_start_event(judge.hit_objects()[i].type))
+                {
+                    bool isCircle = judge.hit_objects()[i].type == cpposu::circle;
+                    circles += isCircle;
+                    n += isCircle && j.result[o++] == r;
+                }
+            return n == circles;
+        };
+
+        // offsets in the map's time (as the replay's), just inside and just outside the 300 window
+        auto inside = judge.judge(autoplay(judge.hit_objects(), s.rate, nomod.window_great - 3));
+        CHECK(circleResults(inside, HitResult::Great));
+        auto outside = judge.judge(autoplay(judge.hit_objects(), s.rate, nomod.window_great + 3));
+        CHECK(circleResults(outside, HitResult::Ok));
+        for (size_t o = 0; o < outside.size(); ++o)
+            if (!std::isnan(outside.hit_error[o]))
+                CHECK(outside.hit_error[o] == Approx((nomod.window_great + 3) / s.rate).margin(1));
+
+        // early between the 100 and 50 windows
+        auto early = judge.judge(autoplay(judge.hit_objects(), s.rate, -(nomod.window_ok + nomod.window_meh) / 2));
+        CHECK(circleResults(early, HitResult::Meh));
+    }
+}
+
+TEST_CASE("judging replays in a batch", "[judgement]")
+{
+    auto beatmap = cpposu::BeatmapParser(tutorial).parse();
+    std::vector<cpposu::Replay> replays(4);
+    Mods mods[] = {Mods::None, Mods::HardRock | Mods::Hidden, Mods::DoubleTime, Mods::Hidden};
+    for (size_t i = 0; i < replays.size(); ++i)
+    {
+        replays[i].mods = mods[i];
+        cpposu::ReplayJudge judge(beatmap, mods[i]);
+        replays[i].frames = autoplay(judge.hit_objects(), judge.settings().rate);
+    }
+    // played without HR, so the flipped objects are missed
+    replays[1].frames = replays[0].frames;
+
+    auto results = cpposu::judge_replays(beatmap, replays);
+    REQUIRE(results.size() == replays.size());
+    CHECK(results[0].count(HitResult::Great) == (int) results[0].size());
+    CHECK(results[1].count(HitResult::Great) < (int) results[1].size());
+    CHECK(results[2].count(HitResult::Great) == (int) results[2].size());
+    CHECK(results[3].max_combo == results[0].max_combo);
+}
@@ -0,0 +1,145 @@
+#include <external/catch2/catch.hpp>
+
+#include <cpposu/beatmap_parser.hpp>
+#include <cpposu/mods.hpp>
+
+#include <random>
+
+using cpposu::Mods;
+
+namespace {
+
+cpposu::Beatmap random_beatmap(unsigned seed, int version)
+{
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> coordinate(0, 4), gap(20, 300), kind(0, 3);
+
+    cpposu::Beatmap b;
+    b.version = version;
+    b.difficulty_attributes.ApproachRate = 8;
+    b.difficulty_attributes.CircleSize = 4;
+    double time = 0;
+    for (int i = 0; i < 300; ++i)
+    {
+        // coarse positions so that objects stack often
+        float x = coordinate(rng) * 128.3f, y = coordinate(rng) * 96.1f;
+        time += gap(rng);
+        if (kind(rng) == 0)
+        {
+            b.hit_objects.push_back({cpposu::slider_head, x, y, time});
+            time += gap(rng);
+            b.hit_objects.push_back({cpposu::slider_tail, y, x * 0.75f, time});
+        }
+        else
+        {
+            b.hit_objects.push_back({cpposu::circle, x, y, time});
+        }
+    }
+    return b;
+}
+
+// The mods applied one after another, as lazer does: difficulty, HR flip, stacking, then the clock rate.
+cpposu::Beatmap apply_mods_separately(cpposu::Beatmap b, Mods mods)
+{
+    b.difficulty_attributes = cpposu::adjust_difficulty(b.difficulty_attributes, mods);
+    if (cpposu::has_mod(mods, Mods::HardRock))
+        cpposu::flip_vertical(b.hit_objects);
+    cpposu::apply_stacking(b);
+    cpposu::apply_timescale(b.hit_objects, 1 / cpposu::mod_rate(mods));
+    return b;
+}
+
+}
+
+TEST_CASE("difficulty adjustment", "[mods]")
+{
+    cpposu::MapDifficultyAttributes difficulty;
+    difficulty.CircleSize = 4;
+    difficulty.ApproachRate = 9;
+    difficulty.OverallDifficulty = 8;
+    difficulty.HPDrainRate = 6;
+
+    auto hr = cpposu::adjust_difficulty(difficulty, Mods::HardRock);
+    CHECK(hr.CircleSize == Approx(5.2));
+    CHECK(hr.ApproachRate == 10);
+    CHECK(hr.OverallDifficulty == 10);
+    CHECK(hr.HPDrainRate == Approx(8.4));
+
+    auto ez = cpposu::adjust_difficulty(difficulty, Mods::Easy);
+    CHECK(ez.CircleSize == 2);
+    CHECK(ez.ApproachRate == 4.5);
+    CHECK(ez.OverallDifficulty == 4);
+    CHECK(ez.HPDrainRate == 3);
+
+    CHECK(cpposu::mod_rate(Mods::DoubleTime | Mods::Nightcore) == 1.5);
+    CHECK(cpposu::mod_rate(Mods::HalfTime | Mods::Hidden) == 0.75);
+    CHECK(cpposu::mod_rate(Mods::HardRock) == 1);
+}
+
+TEST_CASE("fused mods match applying them separately", "[mods]")
+{
+    std::vector<Mods> combinations{
+        Mods::None, Mods::HardRock, Mods::Easy, Mods::DoubleTime, Mods::HalfTime,
+        Mods::HardRock | Mods::DoubleTime, Mods::Easy | Mods::HalfTime | Mods::Hidden,
+    };
+    for (int version : {5, 14})
+    {
+        auto beatmap = random_beatmap(version, version);
+        for (Mods mods : combinations)
+        {
+            INFO("version " << version << " mods " << (uint32_t)mods);
+            auto expected = apply_mods_separately(beatmap, mods);
+
+            auto fused = beatmap;
+            cpposu::apply_mods(fused, mods);
+            CHECK(fused.hit_objects == expected.hit_objects);
+            CHECK(fused.difficulty_attributes.CircleSize == expected.difficulty_attributes.CircleSize);
+            CHECK(fused.difficulty_attributes.ApproachRate == expected.difficulty_attributes.ApproachRate);
+
+            std::vector<cpposu::HitObject> output(beatmap.hit_objects.size());
+            auto difficulty = cpposu::apply_mods(std::as_const(beatmap), mods, output);
+            CHECK(output == expected.hit_objects);
+            CHECK(difficulty.OverallDifficulty == expected.difficulty_attributes.OverallDifficulty);
+        }
+    }
+
+    cpposu::BeatmapParser parser(CPPOSU_TEST_DIR "/Peter Lambert - osu! tutorial (peppy) [Gameplay basics].osu");
+    auto tutorial = parser.parse();
+    auto fused = tutorial;
+    cpposu::apply_mods(fused, Mods::HardRock | Mods::DoubleTime);
+    CHECK(fused.hit_objects == apply_mods_separately(tutorial, Mods::HardRock | Mods::DoubleTime).hit_objects);
+}
+
+TEST_CASE("transformed views match applied mods", "[mods]")
+{
+    auto beatmap = random_beatmap(2, 14);
+    cpposu::TransformedView nomod(beatmap, Mods::None);
+
+    for (Mods mods : {Mods::None, Mods::DoubleTime, Mods::HalfTime | Mods::Hidden, Mods::HardRock, Mods::HardRock | Mods::DoubleTime, Mods::Easy})
+    {
+        INFO("mods " << (uint32_t)mods);
+        auto expected = beatmap;
+        cpposu::apply_mods(expected, mods);
+
+        auto view = nomod.with_mods(mods);
+        REQUIRE(view.size() == expected.hit_objects.size());
+        CHECK(view.difficulty_attributes().ApproachRate == expected.difficulty_attributes.ApproachRate);
+        for (size_t i = 0; i < view.size(); ++i)
+            CHECK(view[i] == expected.hit_objects[i]);
+
+        // in uneven chunks
+        std::vector<cpposu::HitObject> chunk(37);
+        for (size_t begin = 0; begin < view.size(); begin += chunk.size())
+        {
+            auto part = std::span(chunk).first(std::min(chunk.size(), view.size() - begin));
+            view.read(begin, part);
+            CHECK(std::equal(part.begin(), part.end(), expected.hit_objects.begin() + begin));
+        }
+
+        bool same_stacking = !cpposu::has_mod(mods, Mods::HardRock | Mods::Easy);
+        CHECK((view.stack_heights().data() == nomod.stack_heights().data()) == same_stacking);
+    }
+
+    std::vector<cpposu::HitObject> too_long(beatmap.hit_objects.size() + 1);
+    CHECK_THROWS_AS(nomod.read(0, too_long), std::out_of_range);
+}
@@ -0,0 +1,203 @@
+#include <external/catch2/catch.hpp>
+
+#include <cpposu/beatmap_parser.hpp>
+#include <cpposu/path.hpp>
+
+#include <sstream>
+
+using cpposu::Vector2;
+using cpposu::SliderControlPoint;
+
+TEST_CASE("bspline of full degree is a bezier", "[path]")
+{
+    std::vector<SliderControlPoint> control_points{
+        {cpposu::slider_type::Bezier, {0,0}},
+        {cpposu::slider_type::None, {100,200}},
+        {cpposu::slider_type::None, {250,-50}},
+        {cpposu::slider_type::None, {300,100}},
+    };
+    std::vector<Vector2> positions;
+    for (auto& p : control_points) positions.push_back(p.position);
+
+    std::vector<Vector2> bezier, bspline, bspline_default;
+    cpposu::ApproximateBezier(bezier, control_points);
+    cpposu::ApproximateBSpline(bspline, positions, 3);
+    cpposu::ApproximateBSpline(bspline_default, positions);
+
+    CHECK(bspline == bezier);
+    CHECK(bspline_default == bezier);
+}
+
+TEST_CASE("bspline of degree one passes through control points", "[path]")
+{
+    std::vector<Vector2> positions{{0,0}, {10,0}, {10,10}, {20,10}, {20,30}};
+
+    std::vector<Vector2> path;
+    cpposu::ApproximateBSpline(path, positions, 1);
+
+    REQUIRE(path.size() >= positions.size());
+    for (const auto& p : positions)
+        CHECK(std::find(path.begin(), path.end(), p) != path.end());
+    CHECK(path.front() == positions.front());
+    CHECK(path.back() == positions.back());
+}
+
+static constexpr char bspline_map[]=
+R"(osu file format v128
+
+[Difficulty]
+HPDrainRate:5
+CircleSize:4
+OverallDifficulty:5
+ApproachRate:5
+SliderMultiplier:1
+SliderTickRate:1
+
+[TimingPoints]
+0,500,4,2,0,100,1,0
+
+[HitObjects]
+100,100,1000,2,0,B3|200:100|300:100|400:100|500:100,1,400
+)";
+
+TEST_CASE("parse lazer bspline slider", "[path]")
+{
+    std::istringstream stream(bspline_map);
+    cpposu::BeatmapParser parser(stream);
+    auto beatmap = parser.parse();
+
+    REQUIRE(beatmap.hit_objects.size() >= 2);
+    CHECK(beatmap.hit_objects.front().type == cpposu::slider_head);
+
+    const auto& tail = beatmap.hit_objects.back();
+    CHECK(tail.type == cpposu::slider_tail);
+    CHECK(tail.x == Approx(500));
+    CHECK(tail.y == Approx(100));
+    CHECK(tail.time == Approx(3000));
+
+    int degree;
+    CHECK(cpposu::try_parse_slider_type("B3", degree) == cpposu::slider_type::BSpline);
+    CHECK(degree == 3);
+    CHECK(cpposu::try_parse_slider_type("B0", degree) == cpposu::slider_type::Bezier);
+    CHECK(!cpposu::try_parse_slider_type("X"));
+}
+
+static constexpr float exact_bezier_slack = 0.5f;
+
+static float distance_to_polyline(Vector2 p, const std::vector<Vector2>& path)
+{
+    float best = INFINITY;
+    for (size_t i = 1; i < path.size(); ++i)
+    {
+        Vector2 a = path[i-1], b = path[i];
+        Vector2 ab = b - a;
+        float len2 = ab.squared_length();
+        float t = len2 > 0 ? std::clamp((p - a).dot(ab) / len2, 0.0f, 1.0f) : 0.0f;
+        best = std::min(best, (p - lerp(a, b, t)).length());
+    }
+    return best;
+}
+
+TEST_CASE("adaptive catmull stays within tolerance", "[path]")
+{
+    std::vector<SliderControlPoint> control_points{
+        {cpposu::slider_type::CentripetalCatmullRom, {0,0}},
+        {cpposu::slider_type::None, {100,150}},
+        {cpposu::slider_type::None, {200,-100}},
+        {cpposu::slider_type::None, {210,-95}},
+        {cpposu::slider_type::None, {400,-95}},
+        {cpposu::slider_type::None, {500,-95}},
+    };
+
+    std::vector<Vector2> legacy, adaptive;
+    cpposu::ApproximateCatmull(legacy, control_points);
+
+    const float tolerance = 0.25f;
+    cpposu::ApproximateCatmullAdaptive(adaptive, control_points, tolerance);
+
+    CHECK(adaptive.size() < legacy.size() / 4);
+    CHECK(adaptive.front() == legacy.front());
+    CHECK(adaptive.back() == legacy.back());
+
+    // every point of the dense legacy tessellation lies on the curve
+    for (const auto& p : legacy)
+        CHECK(distance_to_polyline(p, adaptive) <= tolerance + 1e-3f);
+
+    cpposu::PathPrecision precision;
+    std::vector<Vector2> dispatched;
+    cpposu::calculate_segment_path(dispatched, control_points, precision);
+    CHECK(dispatched == legacy);
+
+    dispatched.clear();
+    precision.catmull = cpposu::catmull_tessellation::adaptive;
+    cpposu::calculate_segment_path(dispatched, control_points, precision);
+    CHECK(dispatched == adaptive);
+}
+
+TEST_CASE("path precision tiers", "[path]")
+{
+    std::vector<SliderControlPoint> control_points{
+        {cpposu::slider_type::Bezier, {0,0}},
+        {cpposu::slider_type::None, {50,200}},
+        {cpposu::slider_type::None, {150,-150}},
+        {cpposu::slider_type::None, {300,100}},
+        {cpposu::slider_type::None, {260,20}},
+    };
+
+    std::vector<Vector2> exact, parity, fast;
+    cpposu::calculate_segment_path(exact, control_points);
+    cpposu::calculate_segment_path(parity, control_points, cpposu::PathPrecision::exact_parity());
+    auto fast_precision = cpposu::PathPrecision::fast_preview();
+    cpposu::calculate_segment_path(fast, control_points, fast_precision);
+
+    CHECK(parity == exact);
+    CHECK(fast.size() < exact.size() / 2);
+    CHECK(fast.front() == exact.front());
+    CHECK(fast.back() == exact.back());
+    for (const auto& p : exact)
+        CHECK(distance_to_polyline(p, fast) <= fast_precision.bezier_tolerance + exact_bezier_slack);
+}
+
+TEST_CASE("adaptive catmull ends without turning back", "[path]")
+{
+    // the last segment needs more pieces than the legacy tessellation's 50
+    std::vector<SliderControlPoint> control_points{
+        {cpposu::slider_type::CentripetalCatmullRom, {0,0}},
+        {cpposu::slider_type::None, {2048,0}},
+        {cpposu::slider_type::None, {0,1536}},
+        {cpposu::slider_type::None, {2048,1536}},
+    };
+    // the curve's length, from a far finer tessellation; a polyline through points on the curve can't be longer
+    std::vector<Vector2> fine;
+    for (size_t i = 0; i + 1 < control_points.size(); ++i)
+    {
+        auto v1 = control_points[i > 0 ? i - 1 : i].position;
+        auto v2 = control_points[i].position;
+        auto v3 = control_points[i + 1].position;
+        auto v4 = i + 2 < control_points.size() ? control_points[i + 2].position : v3 + v3 - v2;
+        for (int c = 0; c <= 10000; ++c)
+            fine.push_back(cpposu::detail::catmullFindPoint(v1, v2, v3, v4, c / 10000.0f));
+    }
+
+    for (float tolerance : {0.1f, 2.0f, 50.0f})
+    {
+        INFO("tolerance " << tolerance);
+        std::vector<Vector2> legacy, adaptive;
+        cpposu::ApproximateCatmull(legacy, control_points);
+        cpposu::ApproximateCatmullAdaptive(adaptive, control_points, tolerance);
+        REQUIRE(adaptive.size() >= 3);
+        CHECK(adaptive.back() == legacy.back());
+
+        // the curve runs to the right at its end, so x keeps growing over the last pieces
+        for (size_t i = adaptive.size() - 3; i + 1 < adaptive.size(); ++i)
+            CHECK(adaptive[i + 1].X > adaptive[i].X);
+
+        auto length = [](const std::vector<Vector2>& path) {
+            double length = 0;
+            for (size_t i = 1; i < path.size(); ++i)
+                length += (path[i] - path[i - 1]).length();
+            return length;
+        };
+        CHECK(length(adaptive) <= length(fine) + 1e-3);
+    }
+}
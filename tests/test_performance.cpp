@@ -0,0 +1,178 @@
+#include <external/catch2/catch.hpp>
+
+#include <cpposu/beatmap_parser.hpp>
+#include <cpposu/performance.hpp>
+
+#include "synthetic_beatmap.hpp"
+
+using cpposu::Mods;
+
+namespace {
+
+cpposu::ScoreStatistics full_combo(const cpposu::DifficultyAttributes& attributes)
+{
+    return {
+        .MaxCombo = attributes.MaxCombo,
+        .CountGreat = attributes.HitCircleCount + attributes.SliderCount + attributes.SpinnerCount,
+    };
+}
+
+cpposu::Beatmap dense()
+{
+    auto contents = cpposu::synthetic::generate_beatmap(cpposu::synthetic::dense_stream_200bpm_preset(7));
+    return cpposu::BeatmapParser(contents.data(), contents.size()).parse();
+}
+
+}
+
+TEST_CASE("performance of scores", "[performance]")
+{
+    auto beatmap = cpposu::BeatmapParser(CPPOSU_TEST_DIR "/Peter Lambert - osu! tutorial (peppy) [Gameplay basics].osu").parse();
+    auto attributes = cpposu::calculate_difficulty(beatmap);
+
+    auto perfect = full_combo(attributes);
+    auto pp = cpposu::calculate_performance(attributes, Mods::None, perfect);
+    CHECK(pp.Total > 0);
+    CHECK(pp.Aim > 0);
+    CHECK(pp.Speed > 0);
+    CHECK(pp.Accuracy > 0);
+    CHECK(pp.Flashlight == 0);
+    CHECK(pp.EffectiveMissCount == 0);
+
+    auto missed = perfect;
+    missed.CountGreat -= 2;
+    missed.CountMiss = 2;
+    missed.MaxCombo = attributes.MaxCombo / 2;
+    auto missedPP = cpposu::calculate_performance(attributes, Mods::None, missed);
+    CHECK(missedPP.EffectiveMissCount >= 2);
+    CHECK(missedPP.Total < pp.Total);
+
+    auto inaccurate = perfect;
+    inaccurate.CountGreat -= 5;
+    inaccurate.CountOk = 5;
+    CHECK(cpposu::calculate_performance(attributes, Mods::None, inaccurate).Accuracy < pp.Accuracy);
+
+    auto hidden = cpposu::calculate_performance(attributes, Mods::Hidden, perfect);
+    CHECK(hidden.Total > pp.Total);
+
+    auto relax = cpposu::calculate_performance(attributes, Mods::Relax, perfect);
+    CHECK(relax.Speed == 0);
+    CHECK(relax.Accuracy == 0);
+    CHECK(cpposu::calculate_performance(attributes, Mods::Autopilot, perfect).Aim == 0);
+
+    auto flashlightAttributes = cpposu::calculate_difficulty(beatmap, Mods::Flashlight);
+    CHECK(cpposu::calculate_performance(flashlightAttributes, Mods::Flashlight, full_combo(flashlightAttributes)).Flashlight > 0);
+
+    auto doubleTime = cpposu::calculate_difficulty(beatmap, Mods::DoubleTime);
+    CHECK(cpposu::calculate_performance(doubleTime, Mods::DoubleTime, full_combo(doubleTime)).Total > pp.Total);
+
+    // lazer slider accuracy counts sliders towards accuracy
+    auto lazer = perfect;
+    lazer.CountLargeTickMiss = 0;
+    lazer.CountSliderTailHit = attributes.SliderCount;
+    CHECK(cpposu::calculate_performance(attributes, Mods::None, lazer).Accuracy > pp.Accuracy);
+}
+
+TEST_CASE("effective miss count with either slider accuracy", "[performance]")
+{
+    cpposu::DifficultyAttributes attributes;
+    attributes.MaxCombo = 1000;
+    attributes.HitCircleCount = 400;
+    attributes.SliderCount = 100;
+
+    cpposu::ScoreStatistics classic{.MaxCombo = 500, .CountGreat = 494, .CountOk = 5, .CountMiss = 1};
+    // the combo is short of the maximum less 10% of the sliders
+    CHECK(cpposu::detail::effective_miss_count(attributes, classic) == Approx(990.0 / 500));
+    classic.MaxCombo = 995;
+    CHECK(cpposu::detail::effective_miss_count(attributes, classic) == 1);
+
+    // with lazer slider accuracy the dropped slider ends are known, and only misses and tick misses break combo
+    auto lazer = classic;
+    lazer.MaxCombo = 500;
+    lazer.CountSliderTailHit = 90;
+    lazer.CountLargeTickMiss = 0;
+    CHECK(cpposu::detail::effective_miss_count(attributes, lazer) == 1);
+    lazer.CountLargeTickMiss = 3;
+    CHECK(cpposu::detail::effective_miss_count(attributes, lazer) == Approx(990.0 / 500));
+    lazer.MaxCombo = 992;
+    lazer.CountSliderTailHit = 100;
+    CHECK(cpposu::detail::effective_miss_count(attributes, lazer) == Approx(1000.0 / 992));
+    lazer.CountSliderTailHit = 90;
+    CHECK(cpposu::detail::effective_miss_count(attributes, lazer) == 1);
+}
+
+TEST_CASE("difficulty attributes round trip", "[performance]")
+{
+    auto beatmap = cpposu::BeatmapParser(CPPOSU_TEST_DIR "/Peter Lambert - osu! tutorial (peppy) [Gameplay basics].osu").parse();
+    auto attributes = cpposu::calculate_difficulty(beatmap, Mods::HardRock | Mods::DoubleTime);
+
+    std::istringstream stream(cpposu::to_string(attributes));
+    auto read = cpposu::read_attributes(stream);
+    CHECK(cpposu::to_string(read) == cpposu::to_string(attributes));
+    CHECK(read.StarRating == attributes.StarRating);
+    CHECK(read.MaxCombo == attributes.MaxCombo);
+
+    std::istringstream partial("StarRating: 5.5\nFutureAttribute: 1\n");
+    read = cpposu::read_attributes(partial);
+    CHECK(read.StarRating == 5.5);
+    CHECK(read.MaxCombo == 0);
+
+    std::istringstream broken("StarRating: fast\n");
+    CHECK_THROWS_AS(cpposu::read_attributes(broken), cpposu::parse_error);
+}
+
+// cpposu's own pp at the time of writing, on the maps and mods of the pinned difficulty attributes, for a full combo and
+// for a score with misses. Like those, they are not osu-tools or lazer values yet: replace them by the output of
+// osu-tools' simulate command at the lazer revision the port follows (see difficulty.hpp). The dense map for it is
+// written by 'generate_beatmap --preset dense_stream_200bpm --seed 7'.
+TEST_CASE("pinned performance", "[performance]")
+{
+    struct Pinned
+    {
+        const char* map;
+        Mods mods;
+        bool fullCombo;
+        double total, aim, speed, accuracy, effectiveMissCount;
+    };
+    const Pinned pinned[] = {
+        {"tutorial", Mods::None, true, 0.8367866704, 0.2140241963, 0.02020688131, 0.5400132711, 0},
+        {"tutorial", Mods::None, false, 0.06623704337, 0.05483627289, 0.00395948331, 1.301390069e-06, 1.538888889},
+        {"tutorial", Mods::HardRock, true, 0.904006207, 0.2794250833, 0.02020688131, 0.5400132711, 0},
+        {"tutorial", Mods::HardRock, false, 0.08262127527, 0.06914523036, 0.00395948331, 1.301390069e-06, 1.538888889},
+        {"tutorial", Mods::DoubleTime, true, 4.308688419, 0.3211202482, 0.04875904637, 3.488726556, 0},
+        {"tutorial", Mods::DoubleTime, false, 0.1060895637, 0.08597528554, 0.008707589646, 8.407560213e-06, 1.538888889},
+        {"dense", Mods::None, true, 556.1862229, 276.3672729, 178.2153747, 73.66778288, 0},
+        {"dense", Mods::None, false, 425.5028104, 216.0740817, 134.8790568, 52.63733276, 3},
+        {"dense", Mods::HardRock, true, 744.2691547, 346.8223626, 194.0916277, 170.5672799, 0},
+        {"dense", Mods::HardRock, false, 568.1484846, 270.4849103, 150.2757602, 121.874262, 3},
+        {"dense", Mods::DoubleTime, true, 1606.876822, 683.5384884, 683.3478878, 155.3755213, 0},
+        {"dense", Mods::DoubleTime, false, 1245.473663, 534.4201824, 533.1186405, 111.0193995, 3},
+    };
+
+    auto tutorialMap = cpposu::BeatmapParser(CPPOSU_TEST_DIR "/Peter Lambert - osu! tutorial (peppy) [Gameplay basics].osu").parse();
+    auto denseMap = dense();
+    for (const auto& p : pinned)
+    {
+        INFO(p.map << " with mods " << (int) p.mods << (p.fullCombo ? ", full combo" : ", with misses"));
+        bool tutorial = std::string(p.map) == "tutorial";
+        auto attributes = cpposu::calculate_difficulty(tutorial ? tutorialMap : denseMap, p.mods);
+        auto score = full_combo(attributes);
+        if (!p.fullCombo)
+        {
+            // the tutorial has only 8 objects
+            score.CountOk = tutorial ? 1 : 8;
+            score.CountMeh = tutorial ? 0 : 2;
+            score.CountMiss = tutorial ? 1 : 3;
+            score.CountGreat -= score.CountOk + score.CountMeh + score.CountMiss;
+            score.MaxCombo = attributes.MaxCombo * 2 / 3;
+        }
+
+        auto pp = cpposu::calculate_performance(attributes, p.mods, score);
+        CHECK(pp.Total == Approx(p.total).epsilon(1e-8));
+        CHECK(pp.Aim == Approx(p.aim).epsilon(1e-8));
+        CHECK(pp.Speed == Approx(p.speed).epsilon(1e-8));
+        CHECK(pp.Accuracy == Approx(p.accuracy).epsilon(1e-8));
+        CHECK(pp.Flashlight == 0);
+        CHECK(pp.EffectiveMissCount == Approx(p.effectiveMissCount).epsilon(1e-8));
+    }
+}
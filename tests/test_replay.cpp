@@ -0,0 +1,157 @@
+#include <external/catch2/catch.hpp>
+
+#include <cpposu/lzma.hpp>
+#include <cpposu/replay.hpp>
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+namespace {
+
+const char* synthetic_replay = CPPOSU_TEST_DIR "/synthetic.osr";
+
+// "abracadabra " * 8 + "0123456789" with its size in the header, and an end marker after it
+const unsigned char abracadabra[] = {
+    0x5d, 0x00, 0x00, 0x80, 0x00, 0x6a, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x30, 0x98,
+    0x8a, 0xaa, 0x9a, 0x59, 0xf5, 0x11, 0xd8, 0x3e, 0xb4, 0x3b, 0x3f, 0x47, 0xc7, 0x70, 0xfe, 0x99,
+    0xc0, 0xff, 0xd2, 0x00, 0x3f, 0x52, 0x2e, 0xa7, 0x4d, 0xff, 0xee, 0x6b, 0x00, 0x00,
+};
+
+std::string_view bytes(const unsigned char* data, size_t size) { return {reinterpret_cast<const char*>(data), size}; }
+
+cpposu::parse_error_code error_code(auto&& f)
+{
+    try
+    {
+        f();
+    }
+    catch (const cpposu::parse_error& e)
+    {
+        return e.code;
+    }
+    return cpposu::parse_error_code::none;
+}
+
+}
+
+TEST_CASE("lzma decoding", "[replay]")
+{
+    std::string expected;
+    for (int i = 0; i < 8; ++i)
+        expected += "abracadabra ";
+    expected += "0123456789";
+
+    CHECK(cpposu::lzma_decode(bytes(abracadabra, sizeof(abracadabra))) == expected);
+
+    auto truncated = bytes(abracadabra, sizeof(abracadabra) - 12);
+    CHECK(error_code([&] { cpposu::lzma_decode(truncated); }) == cpposu::parse_error_code::truncated_data);
+    CHECK(error_code([&] { cpposu::lzma_decode(bytes(abracadabra, 10)); }) == cpposu::parse_error_code::truncated_data);
+
+    // the range coder's first byte is always 0
+    std::string corrupted(bytes(abracadabra, sizeof(abracadabra)));
+    corrupted[13] = 1;
+    CHECK(error_code([&] { cpposu::lzma_decode(corrupted); }) == cpposu::parse_error_code::invalid_compressed_data);
+}
+
+TEST_CASE("lzma headers claiming huge sizes", "[replay]")
+{
+    // a 4GB dictionary and an uncompressed size of 2^63 - 2 for 46 bytes of data; neither may be allocated up front
+    std::string huge(bytes(abracadabra, sizeof(abracadabra)));
+    for (int i = 1; i < 5; ++i)
+        huge[i] = '\xff';
+    for (int i = 5; i < 13; ++i)
+        huge[i] = '\xff';
+    huge[5] = '\xfe';
+    huge[12] = '\x7f';
+
+    CHECK(cpposu::detail::LzmaDecoder(huge).reserve_size() < 1024);
+    // the end marker still ends the stream
+    std::string expected;
+    for (int i = 0; i < 8; ++i)
+        expected += "abracadabra ";
+    expected += "0123456789";
+    CHECK(cpposu::lzma_decode(huge) == expected);
+}
+
+TEST_CASE("replay parsing", "[replay]")
+{
+    auto replay = cpposu::ReplayParser(synthetic_replay).parse();
+
+    CHECK(replay.mode == 0);
+    CHECK(replay.version == 20151228);
+    CHECK(replay.beatmap_hash == "d41d8cd98f00b204e9800998ecf8427e");
+    CHECK(replay.player_name == "cpposu");
+    CHECK(replay.count_300 == 310);
+    CHECK(replay.count_100 == 12);
+    CHECK(replay.count_50 == 3);
+    CHECK(replay.count_miss == 2);
+    CHECK(replay.score == 1234567);
+    CHECK(replay.max_combo == 350);
+    CHECK(!replay.perfect);
+    CHECK(replay.mods == (cpposu::Mods::Hidden | cpposu::Mods::DoubleTime));
+    CHECK(replay.timestamp == 636000000000000000);
+    CHECK(replay.online_score_id == 2000000000123);
+    CHECK(replay.seed == 7777);
+
+    REQUIRE(replay.life_bar.size() == 3);
+    CHECK(replay.life_bar[1].time == 1500);
+    CHECK(replay.life_bar[1].life == Approx(0.95));
+
+    // the two frames stable starts replays with, then 600 frames 16ms apart; the decompressed text is larger than
+    // the 4KB dictionary, so it is parsed over several chunks
+    const auto& frames = replay.frames;
+    REQUIRE(frames.size() == 602);
+    CHECK(frames.y[0] == -500);
+    CHECK(frames.time_delta[1] == -1);
+    CHECK(frames.time[2] == 999);
+    CHECK(frames.time.back() == 999 + 599 * 16);
+    for (size_t i = 2; i < frames.size(); ++i)
+    {
+        INFO("frame " << i);
+        CHECK(frames.x[i] == Approx(100 + (i - 2) * 0.5).epsilon(1e-3));
+        CHECK(frames.y[i] == Approx(200 - ((i - 2) % 50) * 1.25).epsilon(1e-3));
+        CHECK(cpposu::has_key(frames.keys[i], cpposu::ReplayKeys::K1) == ((i - 2) / 10 % 2 == 0));
+    }
+
+    auto header = cpposu::ReplayParser(synthetic_replay).parse_header();
+    CHECK(header.player_name == replay.player_name);
+    CHECK(header.online_score_id == replay.online_score_id);
+    CHECK(header.frames.size() == 0);
+}
+
+TEST_CASE("replay parsing errors", "[replay]")
+{
+    std::ifstream file(synthetic_replay, std::ios::binary);
+    std::string data(std::istreambuf_iterator<char>(file), {});
+
+    CHECK(cpposu::ReplayParser(data.data(), data.size()).parse().frames.size() == 602);
+    CHECK(error_code([&] { cpposu::ReplayParser(data.data(), 40).parse(); }) == cpposu::parse_error_code::truncated_data);
+    CHECK(error_code([&] { cpposu::ReplayParser(data.data(), data.size() - 20).parse(); }) == cpposu::parse_error_code::truncated_data);
+    CHECK(error_code([] { cpposu::ReplayParser("no such replay.osr"); }) == cpposu::parse_error_code::file_open);
+}
+
+TEST_CASE("online score ids of older replay versions", "[replay]")
+{
+    std::ifstream file(synthetic_replay, std::ios::binary);
+    std::string data(std::istreambuf_iterator<char>(file), {});
+    // the version follows the mode byte, and the replay (without target practice) ends with its 64-bit score id
+    auto withVersion = [&](int32_t version, std::string_view scoreId) {
+        std::string old = data.substr(0, data.size() - 8);
+        std::memcpy(&old[1], &version, sizeof(version));
+        return old.append(scoreId);
+    };
+
+    int32_t id = 123456789;
+    auto shortId = withVersion(20130101, {reinterpret_cast<const char*>(&id), sizeof(id)});
+    auto replay = cpposu::ReplayParser(shortId.data(), shortId.size()).parse();
+    CHECK(replay.version == 20130101);
+    CHECK(replay.online_score_id == id);
+    CHECK(replay.frames.size() == 602);
+
+    auto noId = withVersion(20120101, {});
+    replay = cpposu::ReplayParser(noId.data(), noId.size()).parse();
+    CHECK(replay.version == 20120101);
+    CHECK(replay.online_score_id == 0);
+    CHECK(replay.frames.size() == 602);
+}
@@ -0,0 +1,290 @@
+#include <external/catch2/catch.hpp>
+
+#include <cpposu/beatmap_parser.hpp>
+#include <cpposu/stacking.hpp>
+
+#include "synthetic_beatmap.hpp"
+
+#include <random>
+
+using cpposu::HitObject;
+using cpposu::HitObjectType;
+
+namespace {
+
+// Stack-heavy object stream: objects land on a few spots (some off the playfield), jittered around the distance threshold,
+// or with probability scatter anywhere on the playfield.
+std::vector<HitObject> random_stacked_objects(unsigned seed, int count, float scatter = 0)
+{
+    std::mt19937 rng(seed);
+    std::vector<cpposu::Vector2> spots{{100,100}, {256,192}, {260,190}, {0,0}, {511,383}, {-40,420}, {600,-20}};
+    std::uniform_int_distribution<size_t> spot(0, spots.size()-1);
+    std::uniform_real_distribution<float> jitter(-3.5f, 3.5f);
+    std::uniform_int_distribution<int> kind(0, 9);
+    std::uniform_int_distribution<int> gap(1, 400);
+    std::uniform_real_distribution<float> unit(0, 1);
+
+    auto position = [&] {
+        if (unit(rng) < scatter)
+            return cpposu::Vector2{unit(rng) * 512, unit(rng) * 384};
+        auto p = spots[spot(rng)];
+        return cpposu::Vector2{p.X + jitter(rng), p.Y + jitter(rng)};
+    };
+
+    std::vector<HitObject> objects;
+    double time = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        time += gap(rng);
+        auto start = position();
+        int k = kind(rng);
+        if (k < 6)
+        {
+            objects.push_back({HitObjectType::circle, start.X, start.Y, time});
+        }
+        else if (k < 9)
+        {
+            objects.push_back({HitObjectType::slider_head, start.X, start.Y, time});
+            auto tick = position();
+            time += gap(rng);
+            objects.push_back({HitObjectType::slider_tick, tick.X, tick.Y, time});
+            auto end = position();
+            time += gap(rng);
+            objects.push_back({HitObjectType::slider_legacy_last_tick, end.X, end.Y, time - 36});
+            objects.push_back({HitObjectType::slider_tail, end.X, end.Y, time});
+        }
+        else
+        {
+            objects.push_back({HitObjectType::spinner_start, 256, 192, time});
+            time += gap(rng);
+            objects.push_back({HitObjectType::spinner_end, 256, 192, time});
+        }
+    }
+    return objects;
+}
+
+}
+
+TEST_CASE("indexed stack heights match the reference walk", "[stacking]")
+{
+    for (unsigned seed = 1; seed <= 40; ++seed)
+    {
+        auto objects = random_stacked_objects(seed, 400, seed % 2 ? 0.f : 0.98f);
+        for (double time_threshold : {50.0, 300.0, 1200.0, 100000.0})
+        {
+            for (float distance_threshold : {3.0f, 20.0f})
+            {
+                INFO("seed " << seed << " time " << time_threshold << " distance " << distance_threshold);
+                auto expected = cpposu::calculate_stack_heights(objects, time_threshold, distance_threshold);
+                CHECK(cpposu::calculate_indexed_stack_heights(objects, time_threshold, distance_threshold) == expected);
+            }
+        }
+    }
+}
+
+TEST_CASE("indexed stack heights on a parsed map", "[stacking]")
+{
+    cpposu::BeatmapParser parser(CPPOSU_TEST_DIR "/Peter Lambert - osu! tutorial (peppy) [Gameplay basics].osu");
+    auto beatmap = parser.parse();
+    auto expected = cpposu::calculate_stack_heights(beatmap.hit_objects, 900, 3);
+    CHECK(cpposu::calculate_indexed_stack_heights(beatmap.hit_objects, 900, 3) == expected);
+    CHECK(cpposu::calculate_indexed_stack_heights({}, 900, 3).empty());
+}
+
+TEST_CASE("the versioned stack heights pick the index only for dense maps", "[stacking]")
+{
+    cpposu::BeatmapParser parser(CPPOSU_TEST_DIR "/Peter Lambert - osu! tutorial (peppy) [Gameplay basics].osu");
+    auto beatmap = parser.parse();
+    auto params = cpposu::stacking_parameters(beatmap);
+    CHECK_FALSE(cpposu::prefer_stacking_index(beatmap.hit_objects, params.time_threshold));
+    CHECK_FALSE(cpposu::prefer_stacking_index({}, params.time_threshold));
+
+    // a stream of circles a millisecond apart, a few of them stacked
+    std::vector<HitObject> stream;
+    for (int i = 0; i < 5000; ++i)
+        stream.push_back({HitObjectType::circle, (float) (i % 7 ? (i * 37) % 512 : 100), (float) (i % 7 ? (i * 53) % 384 : 100), (double) i});
+    // the first few hundred have fewer before them
+    CHECK(cpposu::mean_stacking_window(stream, 500) == Approx(500).margin(30));
+    CHECK(cpposu::prefer_stacking_index(stream, 500));
+    CHECK_FALSE(cpposu::prefer_stacking_index(stream, 100));
+
+    auto expected = cpposu::calculate_stack_heights(stream, 500, 3);
+    CHECK(cpposu::calculate_stack_heights(stream, 14, 500, 3) == expected);
+}
+
+TEST_CASE("stacking state updates match a full recompute", "[stacking]")
+{
+    std::mt19937 rng(7);
+    for (auto [version, time_threshold] : {std::pair{5, 300.0}, {14, 300.0}, {14, 2000.0}})
+    {
+        cpposu::StackingParameters parameters{version, time_threshold, 3, -3.2f};
+        auto objects = random_stacked_objects(1, 400);
+        cpposu::StackingState state(objects, parameters);
+
+        for (int edit = 0; edit < 200; ++edit)
+        {
+            // object boundaries, so edits replace whole objects
+            std::vector<size_t> boundaries;
+            for (size_t i = 0; i < objects.size(); ++i)
+                if (cpposu::is_start_event(objects[i].type))
+                    boundaries.push_back(i);
+            boundaries.push_back(objects.size());
+
+            std::uniform_int_distribution<size_t> pick(0, boundaries.size()-1);
+            size_t begin = boundaries[pick(rng)], end = boundaries[pick(rng)];
+            if (begin > end)
+                std::swap(begin, end);
+            end = std::min(end, begin + 12);
+            while (end < objects.size() && !cpposu::is_start_event(objects[end].type))
+                ++end;
+
+            // same times as the replaced objects, new positions
+            auto replacement = random_stacked_objects(edit + 100, 3);
+            double shift = begin > 0 ? objects[begin-1].time - replacement.front().time + 1 : 0;
+            for (auto& h : replacement)
+                h.time += shift;
+
+            auto before = state.stacked();
+            auto changed = state.update(begin, end, replacement);
+            objects.erase(objects.begin() + begin, objects.begin() + end);
+            objects.insert(objects.begin() + begin, replacement.begin(), replacement.end());
+
+            INFO("version " << version << " edit " << edit);
+            auto expected = objects;
+            cpposu::apply_stacking(expected, version, parameters.time_threshold, parameters.distance_threshold, parameters.stack_offset);
+            auto stacked = state.stacked();
+            REQUIRE(stacked == expected);
+
+            // everything not reported as changed kept its stacked position
+            std::vector<bool> reported(objects.size());
+            for (size_t i : changed)
+                reported[i] = true;
+            std::ptrdiff_t growth = (std::ptrdiff_t)replacement.size() - (std::ptrdiff_t)(end - begin);
+            for (size_t i = 0; i < objects.size(); ++i)
+            {
+                if (reported[i])
+                    continue;
+                REQUIRE((i < begin || i >= begin + replacement.size()));
+                CHECK(stacked[i] == before[i < begin ? i : i - growth]);
+            }
+        }
+    }
+}
+
+TEST_CASE("stack heights for several variants at once", "[stacking]")
+{
+    // unordered, with a repeated threshold and two distance thresholds sharing walks
+    std::vector<cpposu::StackingVariant> variants{{300}, {50}, {1200, 3}, {100000, 20}, {300}, {5000, 20}};
+    for (unsigned seed = 1; seed <= 40; ++seed)
+    {
+        auto objects = random_stacked_objects(seed, 400, seed % 2 ? 0.f : 0.98f);
+        for (int version : {5, 14})
+        {
+            auto heights = cpposu::calculate_stack_heights(objects, version, variants);
+            REQUIRE(heights.size() == variants.size());
+            for (size_t v = 0; v < variants.size(); ++v)
+                CHECK(heights[v] == cpposu::calculate_stack_heights(objects, version, variants[v].time_threshold, variants[v].distance_threshold));
+        }
+
+        // the shared walks, which only dense maps get from the versioned entry point
+        auto shared = cpposu::StackingIndex(objects).stack_heights(variants);
+        REQUIRE(shared.size() == variants.size());
+        for (size_t v = 0; v < variants.size(); ++v)
+            CHECK(shared[v] == cpposu::calculate_stack_heights(objects, variants[v].time_threshold, variants[v].distance_threshold));
+    }
+}
+
+namespace {
+
+std::vector<HitObject> stream_stack(std::span<const HitObject> objects, const cpposu::StackingParameters& parameters, size_t max_buffered, bool& exact)
+{
+    cpposu::StreamingStacker stacker(parameters, max_buffered);
+    std::vector<HitObject> result;
+    bool pushesExact = true;
+    for (const auto& h : objects)
+    {
+        pushesExact &= stacker.push(h);
+        auto ready = stacker.take();
+        result.insert(result.end(), ready.begin(), ready.end());
+    }
+    stacker.finish();
+    auto ready = stacker.take();
+    result.insert(result.end(), ready.begin(), ready.end());
+    exact = stacker.exact();
+    CHECK(exact == pushesExact);
+    return result;
+}
+
+}
+
+TEST_CASE("streaming stacker matches stacking the whole map", "[stacking]")
+{
+    for (int version : {5, 14})
+    {
+        for (double time_threshold : {50.0, 300.0, 1200.0})
+        {
+            cpposu::StackingParameters parameters{version, time_threshold, 3, -3.2f};
+            auto objects = random_stacked_objects(3, 400);
+            auto expected = objects;
+            cpposu::apply_stacking(expected, version, time_threshold, parameters.distance_threshold, parameters.stack_offset);
+
+            INFO("version " << version << " time " << time_threshold);
+            bool exact;
+            CHECK(stream_stack(objects, parameters, objects.size(), exact) == expected);
+            CHECK(exact);
+
+            // capped buffer: always the same events, and identical as long as the cap was never hit
+            auto capped = stream_stack(objects, parameters, 40, exact);
+            REQUIRE(capped.size() == expected.size());
+            for (size_t i = 0; i < capped.size(); ++i)
+            {
+                CHECK(capped[i].type == expected[i].type);
+                CHECK(capped[i].time == expected[i].time);
+            }
+            if (exact)
+                CHECK(capped == expected);
+        }
+    }
+
+    // gaps every few objects never need the cap
+    cpposu::StackingParameters parameters{14, 50, 3, -3.2f};
+    auto objects = random_stacked_objects(4, 400);
+    auto expected = objects;
+    cpposu::apply_stacking(expected, 14, 50, 3, -3.2f);
+    bool exact;
+    CHECK(stream_stack(objects, parameters, 40, exact) == expected);
+    CHECK(exact);
+}
+
+TEST_CASE("streaming stacker deviation on a dense stream", "[stacking]")
+{
+    // circles 1ms apart, so that hundreds of events are within the time threshold (420ms here) of each other
+    auto settings = cpposu::synthetic::dense_stream_preset();
+    settings.objects = 20000;
+    auto contents = cpposu::synthetic::generate_beatmap(settings);
+    auto beatmap = cpposu::BeatmapParser(contents.data(), contents.size()).parse();
+    auto parameters = cpposu::stacking_parameters(beatmap);
+    auto expected = beatmap.hit_objects;
+    cpposu::apply_stacking(expected, parameters.version, parameters.time_threshold, parameters.distance_threshold, parameters.stack_offset);
+
+    auto max_deviation = [&](size_t max_buffered) {
+        bool exact;
+        auto streamed = stream_stack(beatmap.hit_objects, parameters, max_buffered, exact);
+        CHECK(!exact);
+        REQUIRE(streamed.size() == expected.size());
+        float deviation = 0;
+        for (size_t i = 0; i < streamed.size(); ++i)
+            deviation = std::max(deviation, (streamed[i].position() - expected[i].position()).length());
+        return deviation;
+    };
+
+    // a context of 128 events is well short of the time threshold, and stacks cut by it move by tens of pixels
+    float shortContext = max_deviation(256);
+    CHECK(shortContext > 0);
+    CHECK(shortContext < 64);
+    // a context of 2048 events covers it
+    CHECK(max_deviation(4096) == 0);
+
+    cpposu::StreamingStacker strict(parameters, 256, true);
+    CHECK_THROWS_AS([&] { for (const auto& h : beatmap.hit_objects) strict.push(h); }(), std::length_error);
+}
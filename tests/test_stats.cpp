@@ -0,0 +1,77 @@
+#include <external/catch2/catch.hpp>
+
+#include "synthetic_beatmap.hpp"
+
+#include <cpposu/beatmap_parser.hpp>
+#include <cpposu/stacking.hpp>
+
+// Built into cpposu_tests as is and into cpposu_stats_tests with CPPOSU_ENABLE_STATS.
+TEST_CASE("parse stats", "[stats]")
+{
+    cpposu::synthetic::GeneratorSettings settings;
+    settings.objects = 300;
+    settings.slider_mix.bspline = 1;
+    settings.bezier_points = 200;
+    auto contents = cpposu::synthetic::generate_beatmap(settings);
+
+    cpposu::BeatmapParser parser(contents.data(), contents.size());
+    auto beatmap = parser.parse();
+    const auto& s = parser.stats();
+
+    cpposu::ParseStats stacking;
+    {
+        cpposu::StatsScope scope(stacking);
+        auto params = cpposu::stacking_parameters(beatmap);
+        cpposu::calculate_stack_heights(beatmap.hit_objects, params.version, params.time_threshold, params.distance_threshold);
+    }
+
+    if constexpr (!cpposu::stats_enabled)
+    {
+        CHECK(s == cpposu::ParseStats{});
+        CHECK(stacking == cpposu::ParseStats{});
+        return;
+    }
+
+    CHECK(s.lines_read == (uint64_t) std::count(contents.begin(), contents.end(), '\n'));
+    CHECK(s.bytes_scanned == contents.size());
+
+    auto sliders = (uint64_t) std::count_if(beatmap.hit_objects.begin(), beatmap.hit_objects.end(), [](auto& h) { return h.type == cpposu::slider_head; });
+    CHECK(s.sliders_linear + s.sliders_perfect_circle + s.sliders_bezier + s.sliders_catmull + s.sliders_bspline == sliders);
+    CHECK(s.sliders_linear > 0);
+    CHECK(s.sliders_perfect_circle > 0);
+    CHECK(s.sliders_bezier > 0);
+    CHECK(s.sliders_catmull > 0);
+    CHECK(s.sliders_bspline > 0);
+
+    // every subdivision is followed by testing both halves
+    CHECK(s.bezier_subdivisions > 0);
+    CHECK(s.bezier_flatness_tests > s.bezier_subdivisions);
+    // 200-point Beziers don't fit the arena's stack buffer
+    CHECK(s.arena_grows > 0);
+    CHECK(s.slider_position_lookups > 0);
+    CHECK(s.slider_position_scan_length > 0);
+
+    CHECK(s.parse_ns > 0);
+    CHECK(s.slider_path_ns > 0);
+    CHECK(s.slider_path_ns < s.parse_ns);
+    CHECK(s.stacking_comparisons == 0);
+
+    CHECK(stacking.stacking_comparisons > 0);
+    CHECK(stacking.stacking_ns > 0);
+    CHECK(stacking.lines_read == 0);
+
+    // the innermost scope counts, and a new parse starts over
+    cpposu::ParseStats outer;
+    {
+        cpposu::StatsScope scope(outer);
+        auto first = s;
+        cpposu::BeatmapParser again(contents.data(), contents.size());
+        again.parse();
+        CHECK(again.stats().lines_read == first.lines_read);
+    }
+    CHECK(outer == cpposu::ParseStats{});
+
+    cpposu::ParseStats sum = stacking;
+    sum += stacking;
+    CHECK(sum.stacking_comparisons == 2 * stacking.stacking_comparisons);
+}
@@ -0,0 +1,93 @@
+#include <external/catch2/catch.hpp>
+
+#include "synthetic_beatmap.hpp"
+
+#include <cpposu/beatmap_parser.hpp>
+#include <cpposu/stacking.hpp>
+
+using namespace cpposu::synthetic;
+
+namespace {
+
+cpposu::Beatmap parse(const std::string& contents)
+{
+    return cpposu::BeatmapParser(contents.data(), contents.size()).parse();
+}
+
+size_t count(const cpposu::Beatmap& beatmap, cpposu::HitObjectType type)
+{
+    return std::count_if(beatmap.hit_objects.begin(), beatmap.hit_objects.end(), [&](auto& h) { return h.type == type; });
+}
+
+// slider lines by their path type letter(s)
+size_t count_paths(const std::string& contents, const std::string& prefix)
+{
+    size_t n = 0;
+    for (size_t pos = 0; (pos = contents.find(",0," + prefix, pos)) != std::string::npos; ++pos)
+        ++n;
+    return n;
+}
+
+}
+
+TEST_CASE("synthetic beatmaps are deterministic", "[synthetic]")
+{
+    GeneratorSettings settings;
+    settings.objects = 500;
+    auto contents = generate_beatmap(settings);
+    CHECK(contents == generate_beatmap(settings));
+    settings.seed = 2;
+    CHECK(contents != generate_beatmap(settings));
+
+    Random a1(42), a2(42);
+    for (int i = 0; i < 100; ++i)
+        CHECK(a1.next() == a2.next());
+}
+
+TEST_CASE("synthetic beatmaps parse", "[synthetic]")
+{
+    GeneratorSettings settings;
+    settings.objects = 2000;
+    settings.slider_mix.bspline = 1;
+    auto contents = generate_beatmap(settings);
+    auto beatmap = parse(contents);
+
+    CHECK(count(beatmap, cpposu::circle) + count(beatmap, cpposu::slider_head) + count(beatmap, cpposu::spinner_start) == settings.objects);
+    CHECK(count(beatmap, cpposu::slider_head) > settings.objects / 4);
+    CHECK(count(beatmap, cpposu::spinner_start) > 0);
+    CHECK(count(beatmap, cpposu::slider_tick) > 0);
+    CHECK(count(beatmap, cpposu::slider_repeat) > 0);
+    for (auto prefix : {"L|", "P|", "B|", "C|", "B3|"})
+        CHECK(count_paths(contents, prefix) > 0);
+    CHECK(beatmap.timing_points.points.size() == 1 + (settings.objects - 1) / settings.sv_change_interval);
+    std::vector<double> startTimes;
+    for (const auto& h : beatmap.hit_objects)
+        if (is_start_event(h.type))
+            startTimes.push_back(h.time);
+    CHECK(std::is_sorted(startTimes.begin(), startTimes.end()));
+    CHECK(beatmap.difficulty_attributes.CircleSize == settings.circle_size);
+}
+
+TEST_CASE("synthetic beatmap presets", "[synthetic]")
+{
+    // the pathological presets scaled down to test sizes
+    auto longBezier = long_bezier_preset();
+    longBezier.objects = 3;
+    longBezier.bezier_points = 500;
+    auto contents = generate_beatmap(longBezier);
+    CHECK(count_paths(contents, "B|") == 3);
+    auto beatmap = parse(contents);
+    CHECK(count(beatmap, cpposu::slider_head) == 3);
+
+    auto stacks = stack_heavy_preset();
+    stacks.objects = 1000;
+    beatmap = parse(generate_beatmap(stacks));
+    auto params = cpposu::stacking_parameters(beatmap);
+    auto heights = cpposu::calculate_stack_heights(beatmap.hit_objects, params.version, params.time_threshold, params.distance_threshold);
+    CHECK(*std::max_element(heights.begin(), heights.end()) >= 8);
+
+    auto million = million_objects_preset();
+    CHECK(million.objects == 1000000);
+    million.objects = 1000;
+    CHECK(count(parse(generate_beatmap(million)), cpposu::circle) > 0);
+}
@@ -0,0 +1,24 @@
+#include <external/catch2/catch.hpp>
+
+#include <cpposu/thread_pool.hpp>
+
+#include <atomic>
+#include <stdexcept>
+
+TEST_CASE("thread pool runs tasks", "[thread_pool]")
+{
+    std::atomic<int> count = 0;
+    std::vector<std::future<int>> results;
+    {
+        cpposu::ThreadPool pool(3);
+        REQUIRE(pool.size() == 3);
+        for (int i = 0; i < 100; ++i)
+            results.push_back(pool.submit([i, &count] { ++count; return i * i; }));
+
+        auto failed = pool.submit([] { throw std::runtime_error("task failed"); });
+        CHECK_THROWS_AS(failed.get(), std::runtime_error);
+    }
+    CHECK(count == 100);
+    for (int i = 0; i < 100; ++i)
+        CHECK(results[i].get() == i * i);
+}